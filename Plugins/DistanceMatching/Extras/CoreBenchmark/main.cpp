@@ -0,0 +1,293 @@
+// Copyright Roman Merkushin. All Rights Reserved.
+
+#include "Core/DistanceMatchingCoreCurve.h"
+#include "Core/DistanceMatchingCoreMovement.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace DistanceMatchingCoreBenchmark
+{
+	using namespace DistanceMatchingCore;
+
+	/** Keeps the results alive, so the optimizer doesn't drop the benchmarked calls. */
+	volatile double Sink = 0.0;
+
+	/** Infinite horizontal floor, stands in for the world collision. */
+	class FFloorQuery final : public ICollisionQuery
+	{
+	public:
+		explicit FFloorQuery(const double InFloorZ) : FloorZ(InFloorZ) {}
+
+		virtual bool Sweep(const FVec3& Start, const FVec3& End, FVec3& OutLocation, float& OutFraction) override
+		{
+			NumSweeps++;
+
+			if (Start.Z < FloorZ || End.Z >= FloorZ)
+			{
+				return false;
+			}
+
+			OutFraction = static_cast<float>((Start.Z - FloorZ) / (Start.Z - End.Z));
+			OutLocation = Lerp(Start, End, OutFraction);
+			return true;
+		}
+
+		double FloorZ;
+		int64_t NumSweeps = 0;
+	};
+
+	struct FMovementSample
+	{
+		FVec3 Location;
+		FVec3 Velocity;
+		FVec3 Acceleration;
+	};
+
+	/** Distance curve of a start animation with keys at 30 Hz, the distance to the start marker grows while the character accelerates. */
+	struct FCurveData
+	{
+		std::vector<float> Times;
+		std::vector<float> Values;
+		std::vector<float> InverseTable;
+		FCurveView View;
+	};
+
+	std::vector<FMovementSample> MakeMovementSamples(const int32_t NumSamples)
+	{
+		std::mt19937 Random(1);
+		std::uniform_real_distribution<double> Direction(-1.0, 1.0);
+		std::uniform_real_distribution<double> Speed(50.0, 600.0);
+
+		std::vector<FMovementSample> Samples(NumSamples);
+		for (FMovementSample& Sample : Samples)
+		{
+			Sample.Location = FVec3(Direction(Random) * 10000.0, Direction(Random) * 10000.0, 0.0);
+			Sample.Velocity = FVec3(Direction(Random), Direction(Random), 0.0).GetSafeNormal() * Speed(Random);
+			Sample.Velocity.Z = Speed(Random);
+			// Every other sample pivots
+			Sample.Acceleration = (&Sample - Samples.data()) % 2 == 0 ? FVec3() : Sample.Velocity.GetSafeNormal() * -2048.0;
+		}
+		return Samples;
+	}
+
+	FCurveData MakeCurve(const int32_t NumKeys, const bool bBuildInverseTable)
+	{
+		FCurveData Curve;
+		Curve.Times.resize(NumKeys);
+		Curve.Values.resize(NumKeys);
+
+		for (int32_t Key = 0; Key < NumKeys; Key++)
+		{
+			const float Time = Key / 30.0f;
+			Curve.Times[Key] = Time;
+			Curve.Values[Key] = -300.0f + Time * (150.0f + 30.0f * Time);
+		}
+
+		Curve.View.Times = Curve.Times.data();
+		Curve.View.Values = Curve.Values.data();
+		Curve.View.NumSamples = NumKeys;
+		Curve.View.bIsSorted = IsSorted(Curve.View.Values, NumKeys);
+
+		if (bBuildInverseTable)
+		{
+			BuildInverseTable(Curve.View, 0.001f, 4096, [&Curve](const int32_t Num)
+			{
+				Curve.InverseTable.resize(Num);
+				return Curve.InverseTable.data();
+			}, Curve.View.InverseTableNum, Curve.View.InverseTableMinDistance, Curve.View.InverseTableStepInv);
+			Curve.InverseTable.resize(Curve.View.InverseTableNum);
+			Curve.View.InverseTable = Curve.InverseTable.data();
+		}
+
+		return Curve;
+	}
+
+	/** Average distance between the swept landing and the exact landing of the samples on the floor. */
+	double MeasureLandingError(const std::vector<FMovementSample>& Samples, const float GravityZ, const float SimulationTime, const FJumpPathStepping& Stepping, FFloorQuery& FloorQuery)
+	{
+		FJumpPath Path;
+		double TotalError = 0.0;
+
+		for (const FMovementSample& Sample : Samples)
+		{
+			FVec3 ExactLocation;
+			float ExactTime;
+			SolveLandingLocation(Sample.Location, Sample.Velocity, GravityZ, FloorQuery.FloorZ, SimulationTime, ExactLocation, ExactTime);
+
+			BuildJumpPath(Sample.Location, Sample.Velocity, GravityZ, SimulationTime, Stepping, Path);
+			FVec3 Location = Path.Last();
+			float Time;
+			SweepJumpPath(Path, FloorQuery, Location, Time);
+			TotalError += (Location - ExactLocation).Size();
+		}
+
+		return TotalError / static_cast<double>(Samples.size());
+	}
+
+	/** Runs the body Iterations times and prints the average time of one call. */
+	template <typename BodyType>
+	void Run(const char* Name, const int64_t Iterations, BodyType&& Body)
+	{
+		const std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+		for (int64_t Iteration = 0; Iteration < Iterations; Iteration++)
+		{
+			Body(Iteration);
+		}
+		const std::chrono::steady_clock::time_point End = std::chrono::steady_clock::now();
+
+		const double Nanoseconds = std::chrono::duration<double, std::nano>(End - Start).count();
+		std::printf("%-32s %10.1f ns\n", Name, Nanoseconds / static_cast<double>(Iterations));
+	}
+}  // namespace DistanceMatchingCoreBenchmark
+
+int main(int ArgC, char** ArgV)
+{
+	namespace Core = DistanceMatchingCore;
+	namespace Bench = DistanceMatchingCoreBenchmark;
+
+	const int64_t Iterations = ArgC > 1 ? std::atoll(ArgV[1]) : 200000;
+	if (Iterations <= 0)
+	{
+		std::fprintf(stderr, "Usage: %s [Iterations]\n", ArgV[0]);
+		return 1;
+	}
+
+	constexpr int32_t NumSamples = 1024;
+	constexpr float MaxSimulationTime = 2.0f;
+	constexpr float GravityZ = -980.0f;
+	const Core::FBrakingParams Braking{ 8.0f, 2048.0f, 10.0f };
+	const std::vector<Bench::FMovementSample> Samples = Bench::MakeMovementSamples(NumSamples);
+
+	std::printf("%-32s %10s\n", "Benchmark", "Time/op");
+
+	Bench::Run("SolveStopLocation", Iterations, [&](const int64_t Iteration)
+	{
+		const Bench::FMovementSample& Sample = Samples[Iteration % NumSamples];
+		Core::FVec3 Location;
+		float Time;
+		Core::SolveStopLocation(Sample.Location, Sample.Velocity, Sample.Acceleration, Braking, MaxSimulationTime, Location, Time);
+		Bench::Sink = Bench::Sink + Location.X + Time;
+	});
+
+	Bench::Run("SimulateStopLocation (60 Hz)", Iterations, [&](const int64_t Iteration)
+	{
+		const Bench::FMovementSample& Sample = Samples[Iteration % NumSamples];
+		Core::FVec3 Location;
+		float Time;
+		Core::SimulateStopLocation(Sample.Location, Sample.Velocity, Sample.Acceleration, Braking, MaxSimulationTime, 1.0f / 60.0f, Location, Time);
+		Bench::Sink = Bench::Sink + Location.X + Time;
+	});
+
+	Bench::Run("SolveJumpApex", Iterations, [&](const int64_t Iteration)
+	{
+		const Bench::FMovementSample& Sample = Samples[Iteration % NumSamples];
+		Core::FVec3 Location;
+		float Time;
+		Core::SolveJumpApex(Sample.Location, Sample.Velocity, GravityZ, MaxSimulationTime, Location, Time);
+		Bench::Sink = Bench::Sink + Location.Z + Time;
+	});
+
+	Core::FJumpPath Path;
+	Core::FJumpPathStepping Stepping;
+	Stepping.SimulationFrequency = 15.0f;
+
+	// Within 10 units of the arc in open air, 1 unit at the hit
+	Core::FJumpPathStepping AdaptiveStepping;
+	AdaptiveStepping.Tolerance = 10.0f;
+	AdaptiveStepping.HitTolerance = 1.0f;
+
+	Bench::Run("BuildJumpPath (15 Hz)", Iterations, [&](const int64_t Iteration)
+	{
+		const Bench::FMovementSample& Sample = Samples[Iteration % NumSamples];
+		Core::BuildJumpPath(Sample.Location, Sample.Velocity, GravityZ, MaxSimulationTime, Stepping, Path);
+		Bench::Sink = Bench::Sink + Path.Last().Z;
+	});
+
+	Bench::FFloorQuery FloorQuery(-50.0);
+
+	Bench::Run("Build and SweepJumpPath", Iterations, [&](const int64_t Iteration)
+	{
+		const Bench::FMovementSample& Sample = Samples[Iteration % NumSamples];
+		Core::BuildJumpPath(Sample.Location, Sample.Velocity, GravityZ, MaxSimulationTime, Stepping, Path);
+		Core::FVec3 Location;
+		float Time = 0.0f;
+		Core::SweepJumpPath(Path, FloorQuery, Location, Time);
+		Bench::Sink = Bench::Sink + Time;
+	});
+	std::printf("%-32s %10.2f\n", "  sweeps per path", static_cast<double>(FloorQuery.NumSweeps) / static_cast<double>(Iterations));
+	std::printf("%-32s %10.2f\n", "  landing error", Bench::MeasureLandingError(Samples, GravityZ, MaxSimulationTime, Stepping, FloorQuery));
+
+	FloorQuery.NumSweeps = 0;
+
+	Bench::Run("Build and SweepJumpPath (adapt.)", Iterations, [&](const int64_t Iteration)
+	{
+		const Bench::FMovementSample& Sample = Samples[Iteration % NumSamples];
+		Core::BuildJumpPath(Sample.Location, Sample.Velocity, GravityZ, MaxSimulationTime, AdaptiveStepping, Path);
+		Core::FVec3 Location;
+		float Time = 0.0f;
+		Core::SweepJumpPath(Path, FloorQuery, Location, Time);
+		Bench::Sink = Bench::Sink + Time;
+	});
+	std::printf("%-32s %10.2f\n", "  sweeps per path", static_cast<double>(FloorQuery.NumSweeps) / static_cast<double>(Iterations));
+	std::printf("%-32s %10.2f\n", "  landing error", Bench::MeasureLandingError(Samples, GravityZ, MaxSimulationTime, AdaptiveStepping, FloorQuery));
+
+	Core::FJumpTrajectory Trajectory;
+	FloorQuery.NumSweeps = 0;
+
+	Bench::Run("BuildJumpTrajectory", Iterations, [&](const int64_t Iteration)
+	{
+		const Bench::FMovementSample& Sample = Samples[Iteration % NumSamples];
+		Core::BuildJumpTrajectory(Sample.Location, Sample.Velocity, GravityZ, MaxSimulationTime, Stepping, Stepping, FloorQuery, Trajectory);
+		Bench::Sink = Bench::Sink + Trajectory.LandingTime;
+	});
+	std::printf("%-32s %10.2f\n", "  sweeps per trajectory", static_cast<double>(FloorQuery.NumSweeps) / static_cast<double>(Iterations));
+
+	Core::FJumpPathSweep PathSweep;
+
+	Bench::Run("FJumpPathSweep (2 steps/update)", Iterations, [&](const int64_t Iteration)
+	{
+		const Bench::FMovementSample& Sample = Samples[Iteration % NumSamples];
+		PathSweep.Start(Sample.Location, Sample.Velocity, GravityZ, MaxSimulationTime, Stepping);
+		Core::FVec3 Location;
+		float Time = 0.0f;
+		while (!PathSweep.IsDone())
+		{
+			PathSweep.Advance(FloorQuery, 2, Location, Time);
+		}
+		Bench::Sink = Bench::Sink + Time;
+	});
+
+	// Distances of a start animation played back at a steady frame rate
+	const Bench::FCurveData SearchCurve = Bench::MakeCurve(300, false);
+	const Bench::FCurveData TableCurve = Bench::MakeCurve(300, true);
+	const float MinDistance = SearchCurve.Values.front();
+	const float DistanceStep = -MinDistance / NumSamples;
+	int32_t NumProbes = 0;
+
+	Bench::Run("GetTime (search)", Iterations, [&](const int64_t Iteration)
+	{
+		Bench::Sink = Bench::Sink + Core::GetTime(SearchCurve.View, MinDistance + (Iteration % NumSamples) * DistanceStep, NumProbes);
+	});
+	std::printf("%-32s %10.2f\n", "  probes per lookup", static_cast<double>(NumProbes) / static_cast<double>(Iterations));
+
+	Core::FCurveSearchHint Hint;
+	NumProbes = 0;
+
+	Bench::Run("GetTime (hinted search)", Iterations, [&](const int64_t Iteration)
+	{
+		Bench::Sink = Bench::Sink + Core::GetTime(SearchCurve.View, MinDistance + (Iteration % NumSamples) * DistanceStep, Hint, NumProbes);
+	});
+	std::printf("%-32s %10.2f\n", "  probes per lookup", static_cast<double>(NumProbes) / static_cast<double>(Iterations));
+
+	Bench::Run("GetTime (inverse table)", Iterations, [&](const int64_t Iteration)
+	{
+		Bench::Sink = Bench::Sink + Core::GetTime(TableCurve.View, MinDistance + (Iteration % NumSamples) * DistanceStep, NumProbes);
+	});
+	std::printf("%-32s %10d\n", "  inverse table entries", TableCurve.View.InverseTableNum);
+
+	return 0;
+}
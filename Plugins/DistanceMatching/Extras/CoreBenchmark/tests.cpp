@@ -0,0 +1,610 @@
+// Copyright Roman Merkushin. All Rights Reserved.
+
+#include "Core/DistanceMatchingCoreCurve.h"
+#include "Core/DistanceMatchingCoreMovement.h"
+
+#include <cstdio>
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace DistanceMatchingCoreTests
+{
+	using namespace DistanceMatchingCore;
+
+	int32_t NumFailures = 0;
+
+	/** Reports the failed check, tests keep running so one run lists all failures. */
+	void Check(const bool bCondition, const char* Test, const char* Message, const double Actual, const double Expected)
+	{
+		if (!bCondition)
+		{
+			std::printf("FAILED %s: %s (actual %.6f, expected %.6f)\n", Test, Message, Actual, Expected);
+			NumFailures++;
+		}
+	}
+
+	void CheckNear(const double Actual, const double Expected, const double Tolerance, const char* Test, const char* Message)
+	{
+		Check(std::abs(Actual - Expected) <= Tolerance, Test, Message, Actual, Expected);
+	}
+
+	/** Infinite horizontal floor. */
+	class FFloorQuery final : public ICollisionQuery
+	{
+	public:
+		explicit FFloorQuery(const double InFloorZ) : FloorZ(InFloorZ) {}
+
+		virtual bool Sweep(const FVec3& Start, const FVec3& End, FVec3& OutLocation, float& OutFraction) override
+		{
+			NumSweeps++;
+
+			if (Start.Z < FloorZ || End.Z >= FloorZ)
+			{
+				return false;
+			}
+
+			OutFraction = static_cast<float>((Start.Z - FloorZ) / (Start.Z - End.Z));
+			OutLocation = Lerp(Start, End, OutFraction);
+			return true;
+		}
+
+		double FloorZ;
+		int64_t NumSweeps = 0;
+	};
+
+	/** Axis aligned box, e.g. a thin ledge the arc can pass right above or below. */
+	class FBoxQuery final : public ICollisionQuery
+	{
+	public:
+		FBoxQuery(const FVec3& InMin, const FVec3& InMax) : Min(InMin), Max(InMax) {}
+
+		virtual bool Sweep(const FVec3& Start, const FVec3& End, FVec3& OutLocation, float& OutFraction) override
+		{
+			NumSweeps++;
+
+			// Clip the segment by the slabs of the three axes
+			const double Starts[3] = { Start.X, Start.Y, Start.Z };
+			const double Ends[3] = { End.X, End.Y, End.Z };
+			const double Mins[3] = { Min.X, Min.Y, Min.Z };
+			const double Maxs[3] = { Max.X, Max.Y, Max.Z };
+			double EnterFraction = 0.0;
+			double ExitFraction = 1.0;
+
+			for (int32_t Axis = 0; Axis < 3; Axis++)
+			{
+				const double Delta = Ends[Axis] - Starts[Axis];
+				if (std::abs(Delta) < SmallNumber)
+				{
+					if (Starts[Axis] < Mins[Axis] || Starts[Axis] > Maxs[Axis])
+					{
+						return false;
+					}
+					continue;
+				}
+
+				const double MinFraction = (Mins[Axis] - Starts[Axis]) / Delta;
+				const double MaxFraction = (Maxs[Axis] - Starts[Axis]) / Delta;
+				EnterFraction = DistanceMatchingCore::Max(EnterFraction, DistanceMatchingCore::Min(MinFraction, MaxFraction));
+				ExitFraction = DistanceMatchingCore::Min(ExitFraction, DistanceMatchingCore::Max(MinFraction, MaxFraction));
+				if (EnterFraction > ExitFraction)
+				{
+					return false;
+				}
+			}
+
+			OutFraction = static_cast<float>(EnterFraction);
+			OutLocation = Lerp(Start, End, OutFraction);
+			return true;
+		}
+
+		FVec3 Min;
+		FVec3 Max;
+		int64_t NumSweeps = 0;
+	};
+
+	/** Returns the smallest distance between the arc and the edges of the box along Y, sampled every millisecond up to the time. */
+	double GetDistanceToBoxEdges(const FBallisticPath& Path, const float EndTime, const FBoxQuery& Box)
+	{
+		double MinDistanceSquared = std::numeric_limits<double>::max();
+
+		for (float Time = 0.0f; Time <= EndTime; Time += 0.001f)
+		{
+			const FVec3 Location = Path.GetLocation(Time);
+			for (const double EdgeX : { Box.Min.X, Box.Max.X })
+			{
+				for (const double EdgeZ : { Box.Min.Z, Box.Max.Z })
+				{
+					MinDistanceSquared = Min(MinDistanceSquared, (Location.X - EdgeX) * (Location.X - EdgeX) + (Location.Z - EdgeZ) * (Location.Z - EdgeZ));
+				}
+			}
+		}
+
+		return std::sqrt(MinDistanceSquared);
+	}
+
+	/** Take-off of a jump or a fall. */
+	struct FJumpSample
+	{
+		FVec3 Location;
+		FVec3 Velocity;
+	};
+
+	/** Returns where the swept path is blocked, or its end without a hit. */
+	FVec3 SweepJumpSample(const FJumpSample& Sample, const float GravityZ, const float SimulationTime, const FJumpPathStepping& Stepping, ICollisionQuery& Query)
+	{
+		FJumpPath Path;
+		BuildJumpPath(Sample.Location, Sample.Velocity, GravityZ, SimulationTime, Stepping, Path);
+
+		FVec3 Location = Path.Last();
+		float Time;
+		SweepJumpPath(Path, Query, Location, Time);
+		return Location;
+	}
+
+	/** Distance curve keys at 30 Hz, optionally with the repeated values at both ends the curve search has to resolve. */
+	struct FCurveData
+	{
+		std::vector<float> Times;
+		std::vector<float> Values;
+		std::vector<float> InverseTable;
+		FCurveView View;
+	};
+
+	FCurveData MakeCurve(const int32_t NumKeys, const bool bFlatEnds, const float Tolerance)
+	{
+		FCurveData Curve;
+		Curve.Times.resize(NumKeys);
+		Curve.Values.resize(NumKeys);
+
+		for (int32_t Key = 0; Key < NumKeys; Key++)
+		{
+			const float Time = Key / 30.0f;
+			const int32_t RisingKey = bFlatEnds ? Clamp(Key, 3, NumKeys - 4) : Key;
+			const float RisingTime = RisingKey / 30.0f;
+			Curve.Times[Key] = Time;
+			Curve.Values[Key] = -300.0f + RisingTime * (150.0f + 30.0f * RisingTime);
+		}
+
+		Curve.View.Times = Curve.Times.data();
+		Curve.View.Values = Curve.Values.data();
+		Curve.View.NumSamples = NumKeys;
+		Curve.View.bIsSorted = IsSorted(Curve.View.Values, NumKeys);
+
+		if (Tolerance > 0.0f)
+		{
+			BuildInverseTable(Curve.View, Tolerance, 1 << 16, [&Curve](const int32_t Num)
+			{
+				Curve.InverseTable.resize(Num);
+				return Curve.InverseTable.data();
+			}, Curve.View.InverseTableNum, Curve.View.InverseTableMinDistance, Curve.View.InverseTableStepInv);
+			Curve.InverseTable.resize(Curve.View.InverseTableNum);
+			Curve.View.InverseTable = Curve.InverseTable.data();
+		}
+
+		return Curve;
+	}
+
+	/** The galloping search from a hint has to return exactly what the search over all keys returns. */
+	void TestHintedSearch()
+	{
+		std::mt19937 Random(1);
+
+		for (const bool bFlatEnds : { false, true })
+		{
+			const FCurveData Curve = MakeCurve(97, bFlatEnds, 0.0f);
+			const float MinDistance = Curve.Values.front() - 10.0f;
+			const float MaxDistance = Curve.Values.back() + 10.0f;
+			std::uniform_real_distribution<float> Jump(MinDistance, MaxDistance);
+			std::uniform_real_distribution<float> Drift(-8.0f, 8.0f);
+
+			FCurveSearchHint Hint;
+			float Distance = Jump(Random);
+
+			for (int32_t Iteration = 0; Iteration < 20000; Iteration++)
+			{
+				// Mostly small changes like between updates, sometimes a jump to anywhere on the curve
+				Distance = Iteration % 50 == 0 ? Jump(Random) : Clamp(Distance + Drift(Random), MinDistance, MaxDistance);
+
+				int32_t NumProbes = 0;
+				const float Expected = FindTimeBySearch(Curve.View, Distance, NumProbes);
+				const float Actual = FindTimeBySearch(Curve.View, Distance, Hint, NumProbes);
+				Check(Actual == Expected, "HintedSearch", "hinted search differs from the full search", Actual, Expected);
+			}
+
+			// Keys themselves are the edge cases of the lower bound
+			for (const float Value : Curve.Values)
+			{
+				int32_t NumProbes = 0;
+				const float Expected = FindTimeBySearch(Curve.View, Value, NumProbes);
+				const float Actual = FindTimeBySearch(Curve.View, Value, Hint, NumProbes);
+				Check(Actual == Expected, "HintedSearch", "hinted search differs from the full search at a key", Actual, Expected);
+			}
+		}
+	}
+
+	/** Times sampled from the inverse table have to stay within the build tolerance of the exact lookup. */
+	void TestInverseTable()
+	{
+		for (const float Tolerance : { 0.01f, 0.001f, 0.0001f })
+		{
+			const FCurveData Curve = MakeCurve(97, false, Tolerance);
+			Check(Curve.View.HasInverseTable(), "InverseTable", "table wasn't built", Curve.View.InverseTableNum, 0.0);
+
+			const float MinDistance = Curve.Values.front() - 10.0f;
+			const float MaxDistance = Curve.Values.back() + 10.0f;
+			constexpr int32_t NumSteps = 100000;
+
+			for (int32_t Step = 0; Step <= NumSteps; Step++)
+			{
+				const float Distance = Lerp(MinDistance, MaxDistance, static_cast<float>(Step) / NumSteps);
+
+				int32_t NumProbes = 0;
+				const float Expected = FindTimeBySearch(Curve.View, Distance, NumProbes);
+				const float Actual = GetTime(Curve.View, Distance, NumProbes);
+				// Float rounding of the table positions on top of the tolerance
+				CheckNear(Actual, Expected, Tolerance + 1.e-5, "InverseTable", "table lookup is out of tolerance");
+			}
+		}
+	}
+
+	/** The analytic stop and pivot solutions have to match the integration of the movement at a small time step. */
+	void TestSolveStopLocation()
+	{
+		constexpr float MaxSimulationTime = 5.0f;
+		constexpr float TimeStep = 1.0f / 10000.0f;
+
+		const FVec3 Location(100.0, -200.0, 50.0);
+		const FVec3 Velocities[] = { FVec3(600.0, 0.0, 0.0), FVec3(-150.0, 320.0, 0.0), FVec3(40.0, 30.0, 0.0) };
+
+		FBrakingParams BrakingParams[3];
+		// Walking defaults
+		BrakingParams[0].Friction = 8.0f;
+		BrakingParams[0].BrakingDeceleration = 2048.0f;
+		BrakingParams[0].BrakeToStopVelocity = 10.0f;
+		// No friction, constant deceleration only
+		BrakingParams[1].BrakingDeceleration = 1024.0f;
+		BrakingParams[1].BrakeToStopVelocity = 10.0f;
+		// Friction only
+		BrakingParams[2].Friction = 4.0f;
+
+		for (const FBrakingParams& Braking : BrakingParams)
+		{
+			for (const FVec3& Velocity : Velocities)
+			{
+				// Stop, then pivot against the velocity
+				for (const FVec3& Acceleration : { FVec3(), Velocity.GetSafeNormal() * -2048.0 })
+				{
+					const char* Test = Acceleration.IsZero() ? "SolveStopLocation (braking)" : "SolveStopLocation (pivot)";
+
+					FVec3 SolvedLocation;
+					float SolvedTime;
+					SolveStopLocation(Location, Velocity, Acceleration, Braking, MaxSimulationTime, SolvedLocation, SolvedTime);
+
+					FVec3 SimulatedLocation;
+					float SimulatedTime;
+					SimulateStopLocation(Location, Velocity, Acceleration, Braking, MaxSimulationTime, TimeStep, SimulatedLocation, SimulatedTime);
+
+					CheckNear((SolvedLocation - SimulatedLocation).Size(), 0.0, 0.1, Test, "location differs from the simulation");
+					CheckNear(SolvedTime, SimulatedTime, 0.01, Test, "time differs from the simulation");
+				}
+			}
+		}
+	}
+
+	/** Apex and landing have to match the closed forms of the ballistic path. */
+	void TestBallisticSolutions()
+	{
+		constexpr float GravityZ = -980.0f;
+		constexpr float MaxSimulationTime = 10.0f;
+		constexpr double GroundZ = -100.0;
+		const double Gravity = -GravityZ;
+
+		const FVec3 Location(10.0, 20.0, 30.0);
+		const FVec3 Velocities[] = { FVec3(300.0, 0.0, 420.0), FVec3(-120.0, 250.0, 800.0), FVec3(200.0, 100.0, -50.0) };
+
+		for (const FVec3& Velocity : Velocities)
+		{
+			FVec3 Apex;
+			float ApexTime;
+			SolveJumpApex(Location, Velocity, GravityZ, MaxSimulationTime, Apex, ApexTime);
+
+			// t = Vz / g, h = Vz^2 / 2g, nothing to rise when falling already
+			const double ExpectedApexTime = Max(0.0, Velocity.Z) / Gravity;
+			const double ExpectedApexHeight = Max(0.0, Velocity.Z) * Max(0.0, Velocity.Z) / (2.0 * Gravity);
+			CheckNear(ApexTime, ExpectedApexTime, 1.e-5, "SolveJumpApex", "time differs from the closed form");
+			CheckNear(Apex.Z - Location.Z, ExpectedApexHeight, 0.01, "SolveJumpApex", "height differs from the closed form");
+			CheckNear(Apex.X, Location.X + Velocity.X * ExpectedApexTime, 0.01, "SolveJumpApex", "X differs from the closed form");
+			CheckNear(Apex.Y, Location.Y + Velocity.Y * ExpectedApexTime, 0.01, "SolveJumpApex", "Y differs from the closed form");
+
+			FVec3 Landing;
+			float LandingTime;
+			SolveLandingLocation(Location, Velocity, GravityZ, GroundZ, MaxSimulationTime, Landing, LandingTime);
+
+			// Later root of Z0 + Vz * t - g * t^2 / 2 = GroundZ
+			const double Height = Location.Z - GroundZ;
+			const double ExpectedLandingTime = (Velocity.Z + std::sqrt(Velocity.Z * Velocity.Z + 2.0 * Gravity * Height)) / Gravity;
+			CheckNear(LandingTime, ExpectedLandingTime, 1.e-4, "SolveLandingLocation", "time differs from the closed form");
+			CheckNear(Landing.Z, GroundZ, 0.05, "SolveLandingLocation", "landing isn't on the ground");
+			CheckNear(Landing.X, Location.X + Velocity.X * ExpectedLandingTime, 0.05, "SolveLandingLocation", "X differs from the closed form");
+			CheckNear(Landing.Y, Location.Y + Velocity.Y * ExpectedLandingTime, 0.05, "SolveLandingLocation", "Y differs from the closed form");
+		}
+
+		// Path which never comes down to the ground runs for the whole simulation time
+		FVec3 Landing;
+		float LandingTime;
+		SolveLandingLocation(Location, FVec3(0.0, 0.0, 100.0), 0.0f, GroundZ, MaxSimulationTime, Landing, LandingTime);
+		CheckNear(LandingTime, MaxSimulationTime, 0.0, "SolveLandingLocation", "path without gravity doesn't run for the whole time");
+	}
+
+	/**
+	* Adaptive sub-steps within the tolerance, with the sub-step which hits refined, have to find the floor and a thin ledge
+	* at least as accurately as the fixed sub-steps, with fewer sweeps.
+	*/
+	void TestAdaptiveStepping()
+	{
+		constexpr float GravityZ = -980.0f;
+		constexpr float SimulationTime = 3.0f;
+		constexpr int32_t NumSamples = 2000;
+
+		FJumpPathStepping FixedStepping;
+		FixedStepping.SimulationFrequency = 15.0f;
+
+		// Hits refined below the 0.54 units the fixed sub-steps are off the arc
+		FJumpPathStepping AdaptiveStepping;
+		AdaptiveStepping.Tolerance = 10.0f;
+		AdaptiveStepping.HitTolerance = 0.5f;
+
+		// Dense sub-steps refined further stand in for the exact arc where there is no closed form, within the capacity of the path
+		FJumpPathStepping ReferenceStepping;
+		ReferenceStepping.SimulationFrequency = 80.0f;
+		ReferenceStepping.HitTolerance = 0.001f;
+
+		std::mt19937 Random(2);
+		std::uniform_real_distribution<double> Height(0.0, 100.0);
+		std::uniform_real_distribution<double> Speed(-600.0, 600.0);
+		std::uniform_real_distribution<double> JumpSpeed(-200.0, 700.0);
+
+		FFloorQuery FloorQuery(-50.0);
+		FFloorQuery FixedFloorQuery(-50.0);
+		FFloorQuery AdaptiveFloorQuery(-50.0);
+		double FixedFloorError = 0.0;
+		double AdaptiveFloorError = 0.0;
+
+		for (int32_t Index = 0; Index < NumSamples; Index++)
+		{
+			const FJumpSample Sample = { FVec3(0.0, 0.0, Height(Random)), FVec3(Speed(Random), Speed(Random), JumpSpeed(Random)) };
+
+			FVec3 ExactLocation;
+			float ExactTime;
+			SolveLandingLocation(Sample.Location, Sample.Velocity, GravityZ, FloorQuery.FloorZ, SimulationTime, ExactLocation, ExactTime);
+
+			FixedFloorError += (SweepJumpSample(Sample, GravityZ, SimulationTime, FixedStepping, FixedFloorQuery) - ExactLocation).Size();
+			AdaptiveFloorError += (SweepJumpSample(Sample, GravityZ, SimulationTime, AdaptiveStepping, AdaptiveFloorQuery) - ExactLocation).Size();
+		}
+
+		Check(AdaptiveFloorError <= FixedFloorError, "AdaptiveStepping (floor)", "adaptive landing is less accurate", AdaptiveFloorError / NumSamples, FixedFloorError / NumSamples);
+		Check(AdaptiveFloorQuery.NumSweeps < FixedFloorQuery.NumSweeps, "AdaptiveStepping (floor)", "adaptive landing needs more sweeps", AdaptiveFloorQuery.NumSweeps, FixedFloorQuery.NumSweeps);
+
+		// Ledge 5 units thick across the path, the arcs pass right above or below it, hit its side or land on its top.
+		// Arcs closer to its edges than the tolerance may be missed or clipped by design, they are left out.
+		FBoxQuery LedgeQuery(FVec3(200.0, -1000.0, -5.0), FVec3(260.0, 1000.0, 0.0));
+		FBoxQuery FixedLedgeQuery(LedgeQuery.Min, LedgeQuery.Max);
+		FBoxQuery AdaptiveLedgeQuery(LedgeQuery.Min, LedgeQuery.Max);
+		std::uniform_real_distribution<double> LedgeHeight(-20.0, 40.0);
+		std::uniform_real_distribution<double> LedgeSpeed(250.0, 450.0);
+		std::uniform_real_distribution<double> LedgeJumpSpeed(150.0, 450.0);
+		double FixedLedgeError = 0.0;
+		double AdaptiveLedgeError = 0.0;
+		int32_t NumLedgeHits = 0;
+		int32_t NumLedgeSamples = 0;
+
+		for (int32_t Index = 0; Index < NumSamples; Index++)
+		{
+			const FJumpSample Sample = { FVec3(0.0, 0.0, LedgeHeight(Random)), FVec3(LedgeSpeed(Random), 0.0, LedgeJumpSpeed(Random)) };
+
+			FJumpPath Path;
+			BuildJumpPath(Sample.Location, Sample.Velocity, GravityZ, SimulationTime, ReferenceStepping, Path);
+			FVec3 ReferenceLocation = Path.Last();
+			float ReferenceTime = SimulationTime;
+			const bool bHitsLedge = SweepJumpPath(Path, LedgeQuery, ReferenceLocation, ReferenceTime);
+
+			const FBallisticPath Arc = { Sample.Location, Sample.Velocity, GravityZ };
+			if (GetDistanceToBoxEdges(Arc, ReferenceTime, LedgeQuery) <= AdaptiveStepping.Tolerance)
+			{
+				continue;
+			}
+
+			NumLedgeHits += bHitsLedge ? 1 : 0;
+			NumLedgeSamples++;
+
+			FixedLedgeError += (SweepJumpSample(Sample, GravityZ, SimulationTime, FixedStepping, FixedLedgeQuery) - ReferenceLocation).Size();
+			AdaptiveLedgeError += (SweepJumpSample(Sample, GravityZ, SimulationTime, AdaptiveStepping, AdaptiveLedgeQuery) - ReferenceLocation).Size();
+		}
+
+		// Most arcs and both hits and misses of the ledge have to be covered
+		Check(NumLedgeSamples > NumSamples / 2, "AdaptiveStepping (ledge)", "most arcs are left out", NumLedgeSamples, NumSamples);
+		Check(NumLedgeHits > NumLedgeSamples / 10 && NumLedgeHits < NumLedgeSamples * 9 / 10, "AdaptiveStepping (ledge)", "samples don't cover hits and misses", NumLedgeHits, NumLedgeSamples / 2);
+		Check(AdaptiveLedgeError <= FixedLedgeError, "AdaptiveStepping (ledge)", "adaptive hit is less accurate", AdaptiveLedgeError / NumLedgeSamples, FixedLedgeError / NumLedgeSamples);
+		Check(AdaptiveLedgeQuery.NumSweeps < FixedLedgeQuery.NumSweeps, "AdaptiveStepping (ledge)", "adaptive hit needs more sweeps", AdaptiveLedgeQuery.NumSweeps, FixedLedgeQuery.NumSweeps);
+	}
+
+	/** The trajectory solved at the take-off has to match the closed forms over a floor, and stop at a ceiling during the rise. */
+	void TestBuildJumpTrajectory()
+	{
+		constexpr float GravityZ = -980.0f;
+		constexpr float MaxSimulationTime = 3.0f;
+
+		FJumpPathStepping Stepping;
+		Stepping.Tolerance = 10.0f;
+		Stepping.HitTolerance = 1.0f;
+
+		const FVec3 Location(10.0, 20.0, 30.0);
+		const FVec3 Velocity(300.0, -100.0, 500.0);
+
+		FVec3 ExpectedApex;
+		float ExpectedApexTime;
+		SolveJumpApex(Location, Velocity, GravityZ, MaxSimulationTime, ExpectedApex, ExpectedApexTime);
+
+		FFloorQuery FloorQuery(-50.0);
+		FJumpTrajectory Trajectory;
+		BuildJumpTrajectory(Location, Velocity, GravityZ, MaxSimulationTime, Stepping, Stepping, FloorQuery, Trajectory);
+
+		FVec3 ExpectedLanding;
+		float ExpectedLandingTime;
+		SolveLandingLocation(Location, Velocity, GravityZ, FloorQuery.FloorZ, MaxSimulationTime, ExpectedLanding, ExpectedLandingTime);
+
+		Check(!Trajectory.bIsApexBlocked, "BuildJumpTrajectory (floor)", "apex is blocked without a ceiling", 1.0, 0.0);
+		CheckNear(Trajectory.ApexTime, ExpectedApexTime, 1.e-5, "BuildJumpTrajectory (floor)", "apex time differs from the closed form");
+		CheckNear((Trajectory.ApexLocation - ExpectedApex).Size(), 0.0, 0.01, "BuildJumpTrajectory (floor)", "apex differs from the closed form");
+		CheckNear((Trajectory.LandingLocation - ExpectedLanding).Size(), 0.0, 2.0 * Stepping.HitTolerance, "BuildJumpTrajectory (floor)", "landing differs from the closed form");
+		CheckNear(Trajectory.LandingTime, ExpectedLandingTime, 0.01, "BuildJumpTrajectory (floor)", "landing time differs from the closed form");
+		CheckNear((Trajectory.GetLocation(Trajectory.LandingTime) - Trajectory.LandingLocation).Size(), 0.0, 2.0 * Stepping.HitTolerance, "BuildJumpTrajectory (floor)", "landing isn't on the path");
+
+		// Only the fall after the apex is swept besides the vertical ceiling check
+		FJumpPath FallPath;
+		BuildJumpPath(Location, Velocity, GravityZ, ExpectedApexTime + MaxSimulationTime, Stepping, FallPath);
+		const double StepTime = FallPath.Times[1];
+		Check(FloorQuery.NumSweeps < FallPath.NumPoints - 1, "BuildJumpTrajectory (floor)", "the rise is swept without a ceiling", FloorQuery.NumSweeps, (ExpectedLandingTime - ExpectedApexTime) / StepTime);
+
+		// Ceiling below the apex right above the take-off
+		const double CeilingZ = Location.Z + 0.5 * (ExpectedApex.Z - Location.Z);
+		FBoxQuery CeilingQuery(FVec3(-1000.0, -1000.0, CeilingZ), FVec3(1000.0, 1000.0, CeilingZ + 10.0));
+		BuildJumpTrajectory(Location, Velocity, GravityZ, MaxSimulationTime, Stepping, Stepping, CeilingQuery, Trajectory);
+
+		Check(Trajectory.bIsApexBlocked, "BuildJumpTrajectory (ceiling)", "apex isn't blocked by the ceiling", 0.0, 1.0);
+		Check(Trajectory.ApexTime < ExpectedApexTime, "BuildJumpTrajectory (ceiling)", "blocked apex isn't before the unobstructed one", Trajectory.ApexTime, ExpectedApexTime);
+		CheckNear(Trajectory.ApexLocation.Z, CeilingZ, 2.0 * Stepping.HitTolerance, "BuildJumpTrajectory (ceiling)", "blocked apex isn't at the ceiling");
+	}
+
+	/** Sweeping the path a few sub-steps at a time has to find the same hit as the whole path, and skipping, stopping and refining have to keep the steps consistent. */
+	void TestJumpPathSweep()
+	{
+		constexpr float GravityZ = -980.0f;
+		constexpr float SimulationTime = 3.0f;
+
+		FJumpPathStepping Stepping;
+		Stepping.Tolerance = 10.0f;
+		Stepping.HitTolerance = 1.0f;
+
+		const FVec3 Location(0.0, 0.0, 100.0);
+		const FVec3 Velocity(400.0, 0.0, 300.0);
+		FFloorQuery FloorQuery(-50.0);
+
+		FJumpPath Path;
+		BuildJumpPath(Location, Velocity, GravityZ, SimulationTime, Stepping, Path);
+		FVec3 ExpectedLocation;
+		float ExpectedTime = 0.0f;
+		SweepJumpPath(Path, FloorQuery, ExpectedLocation, ExpectedTime);
+
+		// Two sub-steps per call, like the async sweeps over several frames
+		FJumpPathSweep PathSweep;
+		PathSweep.Start(Location, Velocity, GravityZ, SimulationTime, Stepping);
+		FVec3 HitLocation;
+		float HitTime = 0.0f;
+		int32_t NumCalls = 0;
+		bool bHasHit = false;
+		while (!PathSweep.IsDone() && !bHasHit)
+		{
+			bHasHit = PathSweep.Advance(FloorQuery, 2, HitLocation, HitTime);
+			NumCalls++;
+		}
+
+		Check(bHasHit, "FJumpPathSweep::Advance", "path isn't blocked by the floor", 0.0, 1.0);
+		Check(NumCalls > 1, "FJumpPathSweep::Advance", "path is swept in one call", NumCalls, 2.0);
+		Check(PathSweep.IsDone(), "FJumpPathSweep::Advance", "sweep isn't done after the hit", PathSweep.NextTime, PathSweep.EndTime);
+		CheckNear(HitTime, ExpectedTime, 1.e-4, "FJumpPathSweep::Advance", "hit time differs from SweepJumpPath");
+		CheckNear((HitLocation - ExpectedLocation).Size(), 0.0, 0.01, "FJumpPathSweep::Advance", "hit differs from SweepJumpPath");
+
+		// Sub-steps tile the whole path without a sliver at the end
+		PathSweep.Start(Location, Velocity, GravityZ, SimulationTime, Stepping);
+		FVec3 StepStart;
+		FVec3 StepEnd;
+		float StepStartTime;
+		float StepEndTime;
+		float PrevEndTime = 0.0f;
+		while (PathSweep.NextStep(StepStart, StepEnd, StepStartTime, StepEndTime))
+		{
+			CheckNear(StepStartTime, PrevEndTime, 0.0, "FJumpPathSweep::NextStep", "sub-step doesn't start at the end of the previous one");
+			Check(StepEndTime - StepStartTime > 0.5f * PathSweep.StepTime, "FJumpPathSweep::NextStep", "sliver of a sub-step", StepEndTime - StepStartTime, PathSweep.StepTime);
+			PrevEndTime = StepEndTime;
+		}
+		CheckNear(PrevEndTime, SimulationTime, 0.0, "FJumpPathSweep::NextStep", "sub-steps don't end at the simulation time");
+
+		// Skipped sub-steps aren't swept, a skip never goes back or past the end
+		PathSweep.Start(Location, Velocity, GravityZ, SimulationTime, Stepping);
+		PathSweep.SkipTo(1.0f);
+		CheckNear(PathSweep.NextTime, 1.0, 0.0, "FJumpPathSweep::SkipTo", "sweep doesn't continue at the skipped time");
+		PathSweep.SkipTo(0.5f);
+		CheckNear(PathSweep.NextTime, 1.0, 0.0, "FJumpPathSweep::SkipTo", "skip goes back");
+		PathSweep.SkipTo(ExpectedTime + 0.1f);
+		Check(!PathSweep.Advance(FloorQuery, 100, HitLocation, HitTime), "FJumpPathSweep::SkipTo", "hit before the skipped time", HitTime, ExpectedTime);
+		PathSweep.Start(Location, Velocity, GravityZ, SimulationTime, Stepping);
+		PathSweep.SkipTo(2.0f * SimulationTime);
+		Check(PathSweep.IsDone(), "FJumpPathSweep::SkipTo", "skip past the end isn't done", PathSweep.NextTime, PathSweep.EndTime);
+
+		// Stopped before the hit, e.g. at an earlier hit against other collision
+		PathSweep.Start(Location, Velocity, GravityZ, SimulationTime, Stepping);
+		PathSweep.StopAt(ExpectedTime - 0.1f);
+		Check(!PathSweep.Advance(FloorQuery, 100, HitLocation, HitTime), "FJumpPathSweep::StopAt", "hit after the stop time", HitTime, ExpectedTime - 0.1f);
+		Check(PathSweep.IsDone(), "FJumpPathSweep::StopAt", "sweep isn't done at the stop time", PathSweep.NextTime, PathSweep.EndTime);
+		PathSweep.Start(Location, Velocity, GravityZ, SimulationTime, Stepping);
+		PathSweep.SkipTo(1.0f);
+		PathSweep.StopAt(0.5f);
+		CheckNear(PathSweep.EndTime, 1.0, 0.0, "FJumpPathSweep::StopAt", "stop goes before the swept part");
+		Check(PathSweep.IsDone(), "FJumpPathSweep::StopAt", "sweep stopped at the swept part isn't done", PathSweep.NextTime, PathSweep.EndTime);
+
+		// Sub-step which hit, continued in steps within the hit tolerance
+		PathSweep.Start(Location, Velocity, GravityZ, SimulationTime, Stepping);
+		bHasHit = false;
+		while (!bHasHit && PathSweep.NextStep(StepStart, StepEnd, StepStartTime, StepEndTime))
+		{
+			float HitFraction;
+			bHasHit = FloorQuery.Sweep(StepStart, StepEnd, HitLocation, HitFraction);
+		}
+		Check(bHasHit, "FJumpPathSweep::RefineStep", "path isn't blocked by the floor", 0.0, 1.0);
+		const float HitStepStartTime = StepStartTime;
+		const float HitStepEndTime = StepEndTime;
+		Check(PathSweep.RefineStep(HitStepStartTime, HitStepEndTime), "FJumpPathSweep::RefineStep", "sub-step out of the hit tolerance isn't refined", StepEndTime - StepStartTime, 0.0);
+
+		PrevEndTime = HitStepStartTime;
+		bHasHit = false;
+		while (!bHasHit && PathSweep.NextStep(StepStart, StepEnd, StepStartTime, StepEndTime))
+		{
+			CheckNear(StepStartTime, PrevEndTime, 0.0, "FJumpPathSweep::RefineStep", "refined step doesn't start at the end of the previous one");
+			CheckNear(GetChordError(GravityZ, StepEndTime - StepStartTime), 0.0, Stepping.HitTolerance + 1.e-4, "FJumpPathSweep::RefineStep", "refined step is out of the hit tolerance");
+			PrevEndTime = StepEndTime;
+
+			float HitFraction = 0.0f;
+			bHasHit = FloorQuery.Sweep(StepStart, StepEnd, HitLocation, HitFraction);
+			HitTime = Lerp(StepStartTime, StepEndTime, HitFraction);
+		}
+		Check(bHasHit, "FJumpPathSweep::RefineStep", "refined steps miss the floor", 0.0, 1.0);
+		Check(StepEndTime <= HitStepEndTime, "FJumpPathSweep::RefineStep", "refined steps go past the sub-step", StepEndTime, HitStepEndTime);
+		CheckNear(HitTime, ExpectedTime, 0.01, "FJumpPathSweep::RefineStep", "refined hit time differs from SweepJumpPath");
+		Check(!PathSweep.RefineStep(StepStartTime, StepEndTime), "FJumpPathSweep::RefineStep", "refined step is refined again", StepEndTime - StepStartTime, 0.0);
+		Check(PathSweep.IsDone(), "FJumpPathSweep::RefineStep", "sweep isn't done after the refinement", PathSweep.NextTime, PathSweep.EndTime);
+	}
+}  // namespace DistanceMatchingCoreTests
+
+int main()
+{
+	namespace Tests = DistanceMatchingCoreTests;
+
+	Tests::TestHintedSearch();
+	Tests::TestInverseTable();
+	Tests::TestSolveStopLocation();
+	Tests::TestBallisticSolutions();
+	Tests::TestAdaptiveStepping();
+	Tests::TestBuildJumpTrajectory();
+	Tests::TestJumpPathSweep();
+
+	if (Tests::NumFailures > 0)
+	{
+		std::printf("%d checks failed\n", Tests::NumFailures);
+		return 1;
+	}
+
+	std::printf("All checks passed\n");
+	return 0;
+}
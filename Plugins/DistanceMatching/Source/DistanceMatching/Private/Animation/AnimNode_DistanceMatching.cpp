@@ -2,30 +2,88 @@
 
 #include "Animation/AnimNode_DistanceMatching.h"
 #include "Log.h"
+#include "DistanceMatchingStats.h"
+#include "DistanceMatchingTimers.h"
+#include "GameFramework/DistanceMatchingComponent.h"
+#include "Animation/AnimInstance.h"
 #include "Animation/AnimInstanceProxy.h"
-#include "Animation/AnimCurveCompressionCodec_UniformIndexable.h"
+#include "Misc/ScopeLock.h"
+
+namespace DistanceMatchingDegradedNodes
+{
+	/** Degraded nodes by address. Only touched when a node switches the curve, so the lock is never taken per update. */
+	static FCriticalSection Lock;
+	static TMap<const void*, FDistanceMatchingDegradedNode> Nodes;
+
+	static void Add(const void* Node, const FDistanceMatchingDegradedNode& Info)
+	{
+		FScopeLock ScopeLock(&Lock);
+
+		// Nodes don't unregister when their anim instance is destroyed, drop them here
+		for (auto It = Nodes.CreateIterator(); It; ++It)
+		{
+			if (!It.Value().AnimInstance.IsValid())
+			{
+				It.RemoveCurrent();
+			}
+		}
+
+		Nodes.Add(Node, Info);
+	}
+
+	static void Remove(const void* Node)
+	{
+		FScopeLock ScopeLock(&Lock);
+		Nodes.Remove(Node);
+	}
+}  // namespace DistanceMatchingDegradedNodes
 
-#if ENABLE_ANIM_DEBUG
 namespace DistanceMatchingCVars
 {
+#if ENABLE_ANIM_DEBUG
 	static int32 AnimNodeEnable = 1;
 	FAutoConsoleVariableRef CVarAnimNodeEnable(
 		TEXT("a.AnimNode.DistanceMatching.Enable"),
 		AnimNodeEnable,
 		TEXT("Turn on debug for DistanceMatching AnimNode."),
 		ECVF_Default);
-}  // namespace DistanceMatchingCVars
 #endif
 
+	static FAutoConsoleCommand CmdListDegraded(
+		TEXT("a.AnimNode.DistanceMatching.ListDegraded"),
+		TEXT("Prints DistanceMatching nodes which play their sequences as normal, because the distance curve can't be accessed."),
+		FConsoleCommandDelegate::CreateLambda([]()
+		{
+			TArray<FDistanceMatchingDegradedNode> DegradedNodes;
+			FAnimNode_DistanceMatching::GetDegradedNodes(DegradedNodes);
+
+			UE_LOG(LogDistanceMatching, Display, TEXT("%d degraded DistanceMatching nodes."), DegradedNodes.Num());
+			for (const FDistanceMatchingDegradedNode& Node : DegradedNodes)
+			{
+				UE_LOG(LogDistanceMatching, Display, TEXT("  %s: %s, curve %s"), *GetPathNameSafe(Node.AnimInstance.Get()), *GetPathNameSafe(Node.Sequence.Get()), *Node.CurveName.ToString());
+			}
+		}));
+}  // namespace DistanceMatchingCVars
+
 FAnimNode_DistanceMatching::FAnimNode_DistanceMatching()
-	: CurveBufferNumSamples(0)
-	, PrevSequence(nullptr)
+	: PrevSequence(nullptr)
+	, PrevDistanceCurveName(NAME_None)
 	, bIsEnabled(true)
+	, bIsDegraded(false)
+	, CachedSequence(nullptr)
+	, CachedTime(0.0f)
+	, PrevEvaluatedTime(-1.0f)
+	, CachedBoneContainerSerial(0)
+	, bCachedRootMotion(false)
+	, bIsPoseCached(false)
 	, Sequence(nullptr)
 	, Distance(0.0f)
 	, DistanceCurveName(FName("Distance"))
+	, bUseComponentMarker(false)
+	, Marker(EDistanceMatchingMarker::Start)
 	, bEnableDistanceLimit(false)
 	, DistanceLimit(0.0f)
+	, bCachePose(false)
 {
 }
 
@@ -34,25 +92,56 @@ float FAnimNode_DistanceMatching::GetCurrentAssetLength()
 	return Sequence ? Sequence->GetPlayLength() : 0.0f;
 }
 
+void FAnimNode_DistanceMatching::OnInitializeAnimInstance(const FAnimInstanceProxy* InProxy, const UAnimInstance* InAnimInstance)
+{
+	// Look the component up once on the game thread, updates only read its snapshot
+	const AActor* OwningActor = InAnimInstance->GetOwningActor();
+	MarkerComponent = OwningActor ? OwningActor->FindComponentByClass<UDistanceMatchingComponent>() : nullptr;
+}
+
 void FAnimNode_DistanceMatching::Initialize_AnyThread(const FAnimationInitializeContext& Context)
 {
 	FAnimNode_AssetPlayerBase::Initialize_AnyThread(Context);
 	GetEvaluateGraphExposedInputs().Execute(Context);
 
-	// Update CurveBuffer if sequence is changed or is nullptr
-	if (!Sequence || Sequence && Sequence != PrevSequence)
-	{
-		PrevSequence = Sequence;
-		UpdateCurveBuffer();
-	}
+	// Always refresh on initialize, the curve data may have changed since the last time (a cache hit is cheap)
+	UpdateCurve(Context);
+	bIsPoseCached = false;
 }
 
 void FAnimNode_DistanceMatching::Evaluate_AnyThread(FPoseContext& Output)
 {
 	if (Sequence && Output.AnimInstanceProxy->IsSkeletonCompatible(Sequence->GetSkeleton()))
 	{
+		const bool bExtractRootMotion = Output.AnimInstanceProxy->ShouldExtractRootMotion();
+		if (bCachePose && IsPoseCacheValid(Output, bExtractRootMotion))
+		{
+			DISTANCE_MATCHING_INC_COUNTER(PoseCacheHits, 1);
+
+			Output.Pose.CopyBonesFrom(CachedPose);
+			Output.Curve.CopyFrom(CachedCurve);
+			Output.CustomAttributes.CopyFrom(CachedAttributes);
+			return;
+		}
+
 		FAnimationPoseData AnimationPoseData(Output);
-		Sequence->GetAnimationPose(AnimationPoseData, FAnimExtractContext(InternalTimeAccumulator, Output.AnimInstanceProxy->ShouldExtractRootMotion()));
+		Sequence->GetAnimationPose(AnimationPoseData, FAnimExtractContext(InternalTimeAccumulator, bExtractRootMotion));
+
+		// A moving time never hits the cache, copy the pose only when the time is likely to repeat
+		const bool bIsTimeHeld = InternalTimeAccumulator == PrevEvaluatedTime || InternalTimeAccumulator <= 0.0f || InternalTimeAccumulator >= Sequence->GetPlayLength();
+		PrevEvaluatedTime = InternalTimeAccumulator;
+
+		if (bCachePose && bIsTimeHeld)
+		{
+			CachedPose.CopyBonesFrom(Output.Pose);
+			CachedCurve.CopyFrom(Output.Curve);
+			CachedAttributes.CopyFrom(Output.CustomAttributes);
+			CachedSequence = Sequence;
+			CachedTime = InternalTimeAccumulator;
+			CachedBoneContainerSerial = Output.AnimInstanceProxy->GetRequiredBones().GetSerialNumber();
+			bCachedRootMotion = bExtractRootMotion;
+			bIsPoseCached = true;
+		}
 	}
 	else
 	{
@@ -70,22 +159,33 @@ void FAnimNode_DistanceMatching::OverrideAsset(UAnimationAsset* NewAsset)
 
 void FAnimNode_DistanceMatching::UpdateAssetPlayer(const FAnimationUpdateContext& Context)
 {
+	DISTANCE_MATCHING_SCOPE_CYCLE_COUNTER(UpdateAssetPlayer);
+	DISTANCE_MATCHING_SCOPED_TIMER(UpdateAssetPlayer);
+
 	GetEvaluateGraphExposedInputs().Execute(Context);
 
+	if (bUseComponentMarker)
+	{
+		if (const UDistanceMatchingComponent* Component = MarkerComponent.Get())
+		{
+			Distance = Component->GetSnapshotMarker(Marker).Distance;
+		}
+	}
+
 #if ENABLE_ANIM_DEBUG
 	bIsEnabled = DistanceMatchingCVars::AnimNodeEnable == 1;
 #endif
 
+	// Sequence or curve name may be switched at runtime by pin, take the shared curve from cache
+	if (Sequence != PrevSequence || DistanceCurveName != PrevDistanceCurveName)
+	{
+		UpdateCurve(Context);
+	}
+
 	if (Sequence && Context.AnimInstanceProxy->IsSkeletonCompatible(Sequence->GetSkeleton()))
 	{
-		if (bIsEnabled)
+		if (bIsEnabled && !bIsDegraded)
 		{
-			if (!CurveBuffer.IsValid())
-			{
-				UE_LOG(LogDistanceMatching, Error, TEXT("CurveBuffer is nullptr!"));
-				return;
-			}
-
 			if (bEnableDistanceLimit && Distance >= DistanceLimit)
 			{
 				PlaySequence(Context);
@@ -102,81 +202,59 @@ void FAnimNode_DistanceMatching::UpdateAssetPlayer(const FAnimationUpdateContext
 	}
 }
 
-void FAnimNode_DistanceMatching::UpdateCurveBuffer()
+bool FAnimNode_DistanceMatching::IsPoseCacheValid(const FPoseContext& Output, const bool bExtractRootMotion) const
 {
-	// Get curve SmartName
-	FSmartName CurveSmartName;
-	Sequence->GetSkeleton()->GetSmartNameByName(USkeleton::AnimCurveMappingName, DistanceCurveName, CurveSmartName);
-
-	if (!CurveSmartName.IsValid())
-	{
-		UE_LOG(LogDistanceMatching, Error, TEXT("Can't retrieve curve smart name for %s."), *DistanceCurveName.ToString());
-		return;
-	}
-
-	// Create a buffered access to times and values in curve
-	CurveBuffer = MakeShareable(new FAnimCurveBufferAccess(Sequence, CurveSmartName.UID));
-	if (!CurveBuffer->IsValid())
-	{
-		UE_LOG(LogDistanceMatching, Error, TEXT("Can't access to curve buffer by smart name: %s."), *CurveSmartName.DisplayName.ToString());
-		return;
-	}
-
-	CurveBufferNumSamples = CurveBuffer->GetNumSamples();
+	// Exact time match, the held frame is clamped to the same value every update
+	return bIsPoseCached
+		&& CachedTime == InternalTimeAccumulator
+		&& CachedSequence == Sequence
+		&& CachedBoneContainerSerial == Output.AnimInstanceProxy->GetRequiredBones().GetSerialNumber()
+		&& bCachedRootMotion == bExtractRootMotion;
 }
 
-float FAnimNode_DistanceMatching::GetCurveTime() const
+void FAnimNode_DistanceMatching::GetDegradedNodes(TArray<FDistanceMatchingDegradedNode>& OutNodes)
 {
-	if (CurveBufferNumSamples == 0)
-	{
-		// If no keys in curve, return 0
-		return 0.0f;
-	}
+	FScopeLock ScopeLock(&DistanceMatchingDegradedNodes::Lock);
 
-	if (CurveBufferNumSamples < 2)
+	OutNodes.Reset(DistanceMatchingDegradedNodes::Nodes.Num());
+	for (const TPair<const void*, FDistanceMatchingDegradedNode>& Pair : DistanceMatchingDegradedNodes::Nodes)
 	{
-		return CurveBuffer->GetTime(0);
-	}
-
-	if (Distance < CurveBuffer->GetValue(CurveBufferNumSamples - 1))
-	{
-		// Perform a lower bound to get the second of the interpolation nodes
-		int32 First = 1;
-		const int32 Last = CurveBufferNumSamples - 1;
-		int32 Count = Last - First;
-
-		while (Count > 0)
+		if (Pair.Value.AnimInstance.IsValid())
 		{
-			const int32 Step = Count / 2;
-			const int32 Middle = First + Step;
-
-			if (Distance >= CurveBuffer->GetValue(Middle))
-			{
-				First = Middle + 1;
-				Count -= Step + 1;
-			}
-			else
-			{
-				Count = Step;
-			}
+			OutNodes.Add(Pair.Value);
 		}
+	}
+}
 
-		const float Diff = CurveBuffer->GetValue(First) - CurveBuffer->GetValue(First - 1);
+void FAnimNode_DistanceMatching::UpdateCurve(const FAnimationBaseContext& Context)
+{
+	PrevSequence = Sequence;
+	PrevDistanceCurveName = DistanceCurveName;
+	SearchHint.Reset();
 
-		if (Diff > 0.0f)
-		{
-			const float Alpha = (Distance - CurveBuffer->GetValue(First - 1)) / Diff;
-			const float P0 = CurveBuffer->GetTime(First - 1);
-			const float P3 = CurveBuffer->GetTime(First);
+	// Sequences set at compile time are baked, only the ones switched by pin need the curve from the sequence itself
+	FDistanceCurveCache& CurveCache = FDistanceCurveCache::Get();
+	Curve = BakedCurve.IsBakedFor(Sequence, DistanceCurveName) ? CurveCache.FindOrAdd(BakedCurve) : CurveCache.FindOrAdd(Sequence, DistanceCurveName);
 
-			// Find time by two nearest known points on the curve
-			return FMath::Lerp(P0, P3, Alpha);
-		}
+	// The cache reports a broken curve once per asset, the node just plays the sequence until the curve is switched again
+	const bool bWasDegraded = bIsDegraded;
+	bIsDegraded = Sequence && !Curve.IsValid();
 
-		return CurveBuffer->GetTime(First - 1);
+	if (bIsDegraded)
+	{
+		DistanceMatchingDegradedNodes::Add(this, FDistanceMatchingDegradedNode{ Context.AnimInstanceProxy->GetAnimInstanceObject(), Sequence, DistanceCurveName });
 	}
+	else if (bWasDegraded)
+	{
+		DistanceMatchingDegradedNodes::Remove(this);
+	}
+}
+
+float FAnimNode_DistanceMatching::GetCurveTime()
+{
+	DISTANCE_MATCHING_SCOPE_CYCLE_COUNTER(GetCurveTime);
 
-	return CurveBuffer->GetTime(CurveBufferNumSamples - 1);
+	return Curve->GetTime(Distance, SearchHint);
 }
 
 void FAnimNode_DistanceMatching::PlaySequence(const FAnimationUpdateContext& Context)
@@ -0,0 +1,93 @@
+// Copyright Roman Merkushin. All Rights Reserved.
+
+#include "Animation/BakedDistanceCurve.h"
+#include "Animation/DistanceCurveCache.h"
+#include "Animation/AnimSequenceBase.h"
+
+namespace DistanceCurveQuantization
+{
+	constexpr float MaxQuantizedValue = static_cast<float>(MAX_uint16);
+
+	void Quantize(const TArray<float>& InValues, float& OutMin, float& OutRange, TArray<uint16>& OutQuantized)
+	{
+		float Max = InValues[0];
+		OutMin = InValues[0];
+		for (const float Value : InValues)
+		{
+			OutMin = FMath::Min(OutMin, Value);
+			Max = FMath::Max(Max, Value);
+		}
+		OutRange = Max - OutMin;
+
+		const float Scale = OutRange > 0.0f ? MaxQuantizedValue / OutRange : 0.0f;
+
+		OutQuantized.SetNumUninitialized(InValues.Num());
+		for (int32 Index = 0; Index < InValues.Num(); Index++)
+		{
+			OutQuantized[Index] = static_cast<uint16>(FMath::RoundToInt(FMath::Clamp((InValues[Index] - OutMin) * Scale, 0.0f, MaxQuantizedValue)));
+		}
+	}
+
+	float Dequantize(const uint16 Quantized, const float Min, const float Range)
+	{
+		return Min + Quantized * (Range / MaxQuantizedValue);
+	}
+}  // namespace DistanceCurveQuantization
+
+FBakedDistanceCurve::FBakedDistanceCurve()
+	: Sequence(nullptr)
+	, CurveName(NAME_None)
+	, MinTime(0.0f)
+	, TimeRange(0.0f)
+	, MinValue(0.0f)
+	, ValueRange(0.0f)
+{
+}
+
+bool FBakedDistanceCurve::IsBakedFor(const UAnimSequenceBase* InSequence, const FName InCurveName) const
+{
+	return InSequence && Sequence == InSequence && CurveName == InCurveName && QuantizedTimes.Num() > 0;
+}
+
+void FBakedDistanceCurve::Bake(UAnimSequenceBase* InSequence, const FName InCurveName, const TArray<float>& Times, const TArray<float>& Values)
+{
+	Reset();
+
+	if (!InSequence || Times.Num() == 0 || Times.Num() != Values.Num())
+	{
+		return;
+	}
+
+	Sequence = InSequence;
+	CurveName = InCurveName;
+
+	DistanceCurveQuantization::Quantize(Times, MinTime, TimeRange, QuantizedTimes);
+	DistanceCurveQuantization::Quantize(Values, MinValue, ValueRange, QuantizedValues);
+
+	// Keys closer than the quantization step would collapse into plateaus and lose the inverse table, keep them apart
+	for (int32 Index = 1; Index < Values.Num(); Index++)
+	{
+		if (Values[Index] > Values[Index - 1] && QuantizedValues[Index] <= QuantizedValues[Index - 1] && QuantizedValues[Index - 1] < MAX_uint16)
+		{
+			QuantizedValues[Index] = QuantizedValues[Index - 1] + 1;
+		}
+	}
+}
+
+void FBakedDistanceCurve::Decompress(FDistanceCurve& OutCurve) const
+{
+	const int32 NumSamples = QuantizedTimes.Num();
+	OutCurve.Times.SetNumUninitialized(NumSamples);
+	OutCurve.Values.SetNumUninitialized(NumSamples);
+
+	for (int32 Index = 0; Index < NumSamples; Index++)
+	{
+		OutCurve.Times[Index] = DistanceCurveQuantization::Dequantize(QuantizedTimes[Index], MinTime, TimeRange);
+		OutCurve.Values[Index] = DistanceCurveQuantization::Dequantize(QuantizedValues[Index], MinValue, ValueRange);
+	}
+}
+
+void FBakedDistanceCurve::Reset()
+{
+	*this = FBakedDistanceCurve();
+}
@@ -0,0 +1,300 @@
+// Copyright Roman Merkushin. All Rights Reserved.
+
+#include "Animation/DistanceCurveCache.h"
+#include "Animation/BakedDistanceCurve.h"
+#include "Log.h"
+#include "DistanceMatchingStats.h"
+#include "Misc/ScopeRWLock.h"
+#include "Animation/AnimSequenceBase.h"
+#include "Animation/AnimCurveCompressionCodec_UniformIndexable.h"
+
+namespace DistanceMatchingCVars
+{
+	static float InverseTableTolerance = 0.001f;
+	FAutoConsoleVariableRef CVarInverseTableTolerance(
+		TEXT("a.AnimNode.DistanceMatching.InverseTableTolerance"),
+		InverseTableTolerance,
+		TEXT("Maximum time error (in seconds) of the distance curve inverse lookup table. 0 disables the table. Applies to curves cached after the change."),
+		ECVF_Default);
+
+	static int32 InverseTableMaxSize = 4096;
+	FAutoConsoleVariableRef CVarInverseTableMaxSize(
+		TEXT("a.AnimNode.DistanceMatching.InverseTableMaxSize"),
+		InverseTableMaxSize,
+		TEXT("Maximum number of entries in the distance curve inverse lookup table. Curves which need more fall back to search."),
+		ECVF_Default);
+
+	static FAutoConsoleCommand CmdDumpCurveCache(
+		TEXT("a.AnimNode.DistanceMatching.DumpCurveCache"),
+		TEXT("Prints the number of cached distance curves and their memory usage."),
+		FConsoleCommandDelegate::CreateLambda([]()
+		{
+			const FDistanceCurveCache& Cache = FDistanceCurveCache::Get();
+			UE_LOG(LogDistanceMatching, Display, TEXT("Distance curve cache: %d curves, %d failed, %llu bytes."), Cache.Num(), Cache.NumFailed(), static_cast<uint64>(Cache.GetAllocatedSize()));
+		}));
+}  // namespace DistanceMatchingCVars
+
+void FDistanceCurve::BuildLookupData(const float Tolerance, const int32 MaxSize)
+{
+	bIsSorted = DistanceMatchingCore::IsSorted(Values.GetData(), GetNumSamples());
+
+	int32 InverseTableNum;
+	DistanceMatchingCore::BuildInverseTable(GetView(), Tolerance, MaxSize, [this](const int32 Num)
+	{
+		InverseTable.SetNumUninitialized(Num);
+		return InverseTable.GetData();
+	}, InverseTableNum, InverseTableMinDistance, InverseTableStepInv);
+
+	if (InverseTableNum > 0)
+	{
+		InverseTable.Shrink();
+	}
+	else
+	{
+		InverseTable.Empty();
+	}
+}
+
+float FDistanceCurve::GetTime(const float Distance) const
+{
+	int32 NumProbes = 0;
+	const float Time = DistanceMatchingCore::GetTime(GetView(), Distance, NumProbes);
+	DISTANCE_MATCHING_INC_COUNTER(CurveSearchProbes, NumProbes);
+
+	return Time;
+}
+
+float FDistanceCurve::GetTime(const float Distance, FDistanceCurveSearchHint& Hint) const
+{
+	int32 NumProbes = 0;
+	const float Time = DistanceMatchingCore::GetTime(GetView(), Distance, Hint, NumProbes);
+	DISTANCE_MATCHING_INC_COUNTER(CurveSearchProbes, NumProbes);
+
+	return Time;
+}
+
+float FDistanceCurve::FindTimeBySearch(const float Distance) const
+{
+	int32 NumProbes = 0;
+	const float Time = DistanceMatchingCore::FindTimeBySearch(GetView(), Distance, NumProbes);
+	DISTANCE_MATCHING_INC_COUNTER(CurveSearchProbes, NumProbes);
+
+	return Time;
+}
+
+float FDistanceCurve::FindTimeBySearch(const float Distance, FDistanceCurveSearchHint& Hint) const
+{
+	int32 NumProbes = 0;
+	const float Time = DistanceMatchingCore::FindTimeBySearch(GetView(), Distance, Hint, NumProbes);
+	DISTANCE_MATCHING_INC_COUNTER(CurveSearchProbes, NumProbes);
+
+	return Time;
+}
+
+SIZE_T FDistanceCurve::GetAllocatedSize() const
+{
+	return sizeof(FDistanceCurve) + Times.GetAllocatedSize() + Values.GetAllocatedSize() + InverseTable.GetAllocatedSize();
+}
+
+DistanceMatchingCore::FCurveView FDistanceCurve::GetView() const
+{
+	DistanceMatchingCore::FCurveView View;
+	View.Times = Times.GetData();
+	View.Values = Values.GetData();
+	View.NumSamples = Times.Num();
+	View.InverseTable = InverseTable.GetData();
+	View.InverseTableNum = InverseTable.Num();
+	View.InverseTableMinDistance = InverseTableMinDistance;
+	View.InverseTableStepInv = InverseTableStepInv;
+	View.bIsSorted = bIsSorted;
+
+	return View;
+}
+
+FDistanceCurveCache& FDistanceCurveCache::Get()
+{
+	static FDistanceCurveCache Instance;
+	return Instance;
+}
+
+FDistanceCurvePtr FDistanceCurveCache::FindOrAdd(const UAnimSequenceBase* Sequence, const FName CurveName)
+{
+	if (!Sequence)
+	{
+		return nullptr;
+	}
+
+	return FindOrAdd(FKey{ FObjectKey(Sequence), CurveName, false }, [Sequence, CurveName]() { return BuildCurve(Sequence, CurveName); });
+}
+
+FDistanceCurvePtr FDistanceCurveCache::FindOrAdd(const FBakedDistanceCurve& BakedCurve)
+{
+	if (!BakedCurve.Sequence)
+	{
+		return nullptr;
+	}
+
+	return FindOrAdd(FKey{ FObjectKey(BakedCurve.Sequence), BakedCurve.CurveName, true }, [&BakedCurve]() { return BuildCurve(BakedCurve); });
+}
+
+FDistanceCurvePtr FDistanceCurveCache::FindOrAdd(const FKey& Key, TFunctionRef<FDistanceCurvePtr()> Build)
+{
+	{
+		FReadScopeLock ReadLock(Lock);
+		if (const FDistanceCurvePtr* Curve = Curves.Find(Key))
+		{
+			return *Curve;
+		}
+
+		if (FailedCurves.Contains(Key))
+		{
+			return nullptr;
+		}
+	}
+
+	// Build outside of the lock, other threads can keep reading meanwhile
+	FDistanceCurvePtr NewCurve = Build();
+	if (!NewCurve.IsValid())
+	{
+		FWriteScopeLock WriteLock(Lock);
+		FailedCurves.Add(Key);
+		return nullptr;
+	}
+
+	FWriteScopeLock WriteLock(Lock);
+
+	// Another thread may have built the same curve, keep the first one so all nodes share it
+	if (const FDistanceCurvePtr* Curve = Curves.Find(Key))
+	{
+		return *Curve;
+	}
+
+	return Curves.Add(Key, MoveTemp(NewCurve));
+}
+
+void FDistanceCurveCache::Invalidate(const UAnimSequenceBase* Sequence)
+{
+	const FObjectKey SequenceKey(Sequence);
+
+	FWriteScopeLock WriteLock(Lock);
+	for (auto It = Curves.CreateIterator(); It; ++It)
+	{
+		if (It.Key().Sequence == SequenceKey)
+		{
+			It.RemoveCurrent();
+		}
+	}
+
+	for (auto It = FailedCurves.CreateIterator(); It; ++It)
+	{
+		if (It->Sequence == SequenceKey)
+		{
+			It.RemoveCurrent();
+		}
+	}
+}
+
+void FDistanceCurveCache::RemoveStaleEntries()
+{
+	FWriteScopeLock WriteLock(Lock);
+	for (auto It = Curves.CreateIterator(); It; ++It)
+	{
+		if (!It.Key().Sequence.ResolveObjectPtr())
+		{
+			It.RemoveCurrent();
+		}
+	}
+
+	for (auto It = FailedCurves.CreateIterator(); It; ++It)
+	{
+		if (!It->Sequence.ResolveObjectPtr())
+		{
+			It.RemoveCurrent();
+		}
+	}
+}
+
+void FDistanceCurveCache::Empty()
+{
+	FWriteScopeLock WriteLock(Lock);
+	Curves.Empty();
+	FailedCurves.Empty();
+}
+
+int32 FDistanceCurveCache::Num() const
+{
+	FReadScopeLock ReadLock(Lock);
+	return Curves.Num();
+}
+
+int32 FDistanceCurveCache::NumFailed() const
+{
+	FReadScopeLock ReadLock(Lock);
+	return FailedCurves.Num();
+}
+
+SIZE_T FDistanceCurveCache::GetAllocatedSize() const
+{
+	FReadScopeLock ReadLock(Lock);
+
+	SIZE_T Size = Curves.GetAllocatedSize() + FailedCurves.GetAllocatedSize();
+	for (const TPair<FKey, FDistanceCurvePtr>& Pair : Curves)
+	{
+		Size += Pair.Value->GetAllocatedSize();
+	}
+
+	return Size;
+}
+
+FDistanceCurvePtr FDistanceCurveCache::BuildCurve(const UAnimSequenceBase* Sequence, const FName CurveName)
+{
+	const USkeleton* Skeleton = Sequence->GetSkeleton();
+	if (!Skeleton)
+	{
+		UE_LOG(LogDistanceMatching, Warning, TEXT("Can't access skeleton of %s, distance matching falls back to playback."), *Sequence->GetName());
+		return nullptr;
+	}
+
+	// Get curve SmartName
+	FSmartName CurveSmartName;
+	Skeleton->GetSmartNameByName(USkeleton::AnimCurveMappingName, CurveName, CurveSmartName);
+
+	if (!CurveSmartName.IsValid())
+	{
+		UE_LOG(LogDistanceMatching, Warning, TEXT("Can't retrieve curve smart name for %s in %s, distance matching falls back to playback."), *CurveName.ToString(), *Sequence->GetName());
+		return nullptr;
+	}
+
+	// Create a buffered access to times and values in curve
+	const FAnimCurveBufferAccess CurveBuffer(Sequence, CurveSmartName.UID);
+	if (!CurveBuffer.IsValid())
+	{
+		UE_LOG(LogDistanceMatching, Warning, TEXT("Can't access to curve buffer by smart name: %s in %s, distance matching falls back to playback."), *CurveSmartName.DisplayName.ToString(), *Sequence->GetName());
+		return nullptr;
+	}
+
+	// Copy the keys once, so lookups don't go through the curve codec
+	TSharedRef<FDistanceCurve, ESPMode::ThreadSafe> Curve = MakeShared<FDistanceCurve, ESPMode::ThreadSafe>();
+	const int32 NumSamples = CurveBuffer.GetNumSamples();
+	Curve->Times.SetNumUninitialized(NumSamples);
+	Curve->Values.SetNumUninitialized(NumSamples);
+
+	for (int32 Index = 0; Index < NumSamples; Index++)
+	{
+		Curve->Times[Index] = CurveBuffer.GetTime(Index);
+		Curve->Values[Index] = CurveBuffer.GetValue(Index);
+	}
+
+	Curve->BuildLookupData(DistanceMatchingCVars::InverseTableTolerance, DistanceMatchingCVars::InverseTableMaxSize);
+
+	return Curve;
+}
+
+FDistanceCurvePtr FDistanceCurveCache::BuildCurve(const FBakedDistanceCurve& BakedCurve)
+{
+	TSharedRef<FDistanceCurve, ESPMode::ThreadSafe> Curve = MakeShared<FDistanceCurve, ESPMode::ThreadSafe>();
+	BakedCurve.Decompress(*Curve);
+	Curve->BuildLookupData(DistanceMatchingCVars::InverseTableTolerance, DistanceMatchingCVars::InverseTableMaxSize);
+
+	return Curve;
+}
@@ -0,0 +1,14 @@
+// Copyright Roman Merkushin. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Core/DistanceMatchingCoreMath.h"
+
+/** Conversions between the engine types and the engine independent core types. */
+namespace DistanceMatchingCore
+{
+	inline FVec3 ToCore(const FVector& Vector) { return FVec3(Vector.X, Vector.Y, Vector.Z); }
+
+	inline FVector ToVector(const FVec3& Vector) { return FVector(Vector.X, Vector.Y, Vector.Z); }
+}  // namespace DistanceMatchingCore
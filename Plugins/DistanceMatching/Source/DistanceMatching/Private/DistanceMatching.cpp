@@ -1,18 +1,25 @@
 // Copyright Roman Merkushin. All Rights Reserved.
 
 #include "DistanceMatching.h"
+#include "Animation/DistanceCurveCache.h"
 
 #define LOCTEXT_NAMESPACE "FDistanceMatchingModule"
 
 void FDistanceMatchingModule::StartupModule()
 {
 	// This code will execute after your module is loaded into memory; the exact timing is specified in the .uplugin file per-module
+	PostGarbageCollectHandle = FCoreUObjectDelegates::GetPostGarbageCollect().AddLambda([]()
+	{
+		FDistanceCurveCache::Get().RemoveStaleEntries();
+	});
 }
 
 void FDistanceMatchingModule::ShutdownModule()
 {
 	// This function may be called during shutdown to clean up your module.  For modules that support dynamic reloading,
 	// we call this function before unloading the module.
+	FCoreUObjectDelegates::GetPostGarbageCollect().Remove(PostGarbageCollectHandle);
+	FDistanceCurveCache::Get().Empty();
 }
 
 #undef LOCTEXT_NAMESPACE
@@ -0,0 +1,31 @@
+// Copyright Roman Merkushin. All Rights Reserved.
+
+#include "DistanceMatchingStats.h"
+
+DEFINE_STAT(STAT_DistanceMatching_TickComponent);
+DEFINE_STAT(STAT_DistanceMatching_BatchTick);
+DEFINE_STAT(STAT_DistanceMatching_ResolvePendingPredictions);
+DEFINE_STAT(STAT_DistanceMatching_PredictStopLocation);
+DEFINE_STAT(STAT_DistanceMatching_PredictJumpApex);
+DEFINE_STAT(STAT_DistanceMatching_PredictLandingLocation);
+DEFINE_STAT(STAT_DistanceMatching_PredictJumpTrajectory);
+DEFINE_STAT(STAT_DistanceMatching_RefineMarkers);
+DEFINE_STAT(STAT_DistanceMatching_RunScheduledPredictions);
+DEFINE_STAT(STAT_DistanceMatching_UpdateAssetPlayer);
+DEFINE_STAT(STAT_DistanceMatching_GetCurveTime);
+
+DEFINE_STAT(STAT_DistanceMatching_Predictions);
+DEFINE_STAT(STAT_DistanceMatching_MarkerRefinements);
+DEFINE_STAT(STAT_DistanceMatching_DeferredPredictions);
+DEFINE_STAT(STAT_DistanceMatching_Sweeps);
+DEFINE_STAT(STAT_DistanceMatching_CurveSearchProbes);
+DEFINE_STAT(STAT_DistanceMatching_PoseCacheHits);
+DEFINE_STAT(STAT_DistanceMatching_ComponentsNone);
+DEFINE_STAT(STAT_DistanceMatching_ComponentsStart);
+DEFINE_STAT(STAT_DistanceMatching_ComponentsStop);
+DEFINE_STAT(STAT_DistanceMatching_ComponentsPivot);
+DEFINE_STAT(STAT_DistanceMatching_ComponentsJump);
+DEFINE_STAT(STAT_DistanceMatching_ComponentsFall);
+DEFINE_STAT(STAT_DistanceMatching_ComponentsSleeping);
+
+CSV_DEFINE_CATEGORY_MODULE(DISTANCEMATCHING_API, DistanceMatching, true);
@@ -0,0 +1,43 @@
+// Copyright Roman Merkushin. All Rights Reserved.
+
+#include "DistanceMatchingTimers.h"
+
+bool FDistanceMatchingTimers::bEnabled = false;
+std::atomic<uint64> FDistanceMatchingTimers::Cycles[static_cast<uint8>(EDistanceMatchingTimer::Num)] = {};
+
+void FDistanceMatchingTimers::Add(const EDistanceMatchingTimer Timer, const uint64 InCycles)
+{
+	Cycles[static_cast<uint8>(Timer)].fetch_add(InCycles, std::memory_order_relaxed);
+}
+
+double FDistanceMatchingTimers::GetMilliseconds(const EDistanceMatchingTimer Timer)
+{
+	return FPlatformTime::ToMilliseconds64(Cycles[static_cast<uint8>(Timer)].load(std::memory_order_relaxed));
+}
+
+void FDistanceMatchingTimers::Reset()
+{
+	for (std::atomic<uint64>& TimerCycles : Cycles)
+	{
+		TimerCycles.store(0, std::memory_order_relaxed);
+	}
+}
+
+const TCHAR* FDistanceMatchingTimers::GetName(const EDistanceMatchingTimer Timer)
+{
+	switch (Timer)
+	{
+		case EDistanceMatchingTimer::TickComponent:
+			return TEXT("TickComponent");
+		case EDistanceMatchingTimer::BatchTick:
+			return TEXT("BatchTick");
+		case EDistanceMatchingTimer::Prediction:
+			return TEXT("Prediction");
+		case EDistanceMatchingTimer::UpdateAssetPlayer:
+			return TEXT("UpdateAssetPlayer");
+		case EDistanceMatchingTimer::Num:
+			break;
+	}
+
+	return TEXT("Unknown");
+}
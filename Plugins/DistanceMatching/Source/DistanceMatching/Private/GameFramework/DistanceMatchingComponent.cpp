@@ -1,12 +1,20 @@
 // Copyright Roman Merkushin. All Rights Reserved.
 
 #include "GameFramework/DistanceMatchingComponent.h"
+#include "GameFramework/DistanceMatchingSubsystem.h"
 #include "Log.h"
+#include "DistanceMatchingStats.h"
+#include "DistanceMatchingTimers.h"
 #include "DrawDebugHelpers.h"
 #include "GameFramework/Character.h"
+#include "GameFramework/PlayerController.h"
+#include "Camera/PlayerCameraManager.h"
 #include "Kismet/KismetSystemLibrary.h"
 #include "Components/CapsuleComponent.h"
+#include "Components/SkeletalMeshComponent.h"
 #include "GameFramework/CharacterMovementComponent.h"
+#include "Net/UnrealNetwork.h"
+#include "Core/DistanceMatchingCoreConversion.h"
 
 #if ENABLE_DRAW_DEBUG
 namespace DistanceMatchingCVars
@@ -24,9 +32,40 @@ namespace DistanceMatchingCVars
 		DrawDebugTrace,
 		TEXT("Turn on draw debug trace for DistanceMatching component."),
 		ECVF_Default);
+
+	static int32 ValidateBroadphaseLanding = 0;
+	FAutoConsoleVariableRef CVarValidateBroadphaseLanding(
+		TEXT("c.DistanceMatching.Debug.ValidateBroadphaseLanding"),
+		ValidateBroadphaseLanding,
+		TEXT("Sweep the world along the arc after each broadphase landing prediction and log when the landings differ."),
+		ECVF_Default);
+
+	static float ValidateBroadphaseLandingTolerance = 5.0f;
+	FAutoConsoleVariableRef CVarValidateBroadphaseLandingTolerance(
+		TEXT("c.DistanceMatching.Debug.ValidateBroadphaseLandingTolerance"),
+		ValidateBroadphaseLandingTolerance,
+		TEXT("Distance between the broadphase and the world sweep landings logged as a difference."),
+		ECVF_Default);
 }  // namespace DistanceMatchingCVars
 #endif
 
+namespace DistanceMatchingCVars
+{
+	static int32 AsyncPathSweeps = 4;
+	FAutoConsoleVariableRef CVarAsyncPathSweeps(
+		TEXT("c.DistanceMatching.AsyncPathSweeps"),
+		AsyncPathSweeps,
+		TEXT("Number of jump path sub-steps swept per frame by async DistanceMatching predictions, the next ones are requested only if none of them hits."),
+		ECVF_Default);
+
+	static float MarkerRefinementSendInterval = 0.1f;
+	FAutoConsoleVariableRef CVarMarkerRefinementSendInterval(
+		TEXT("c.DistanceMatching.MarkerRefinementSendInterval"),
+		MarkerRefinementSendInterval,
+		TEXT("Minimum time in seconds between sends of refined DistanceMatching markers within a state, transitions are sent right away."),
+		ECVF_Default);
+}  // namespace DistanceMatchingCVars
+
 UDistanceMatchingComponent::UDistanceMatchingComponent()
 	: ActorLocation(ForceInitToZero)
 	, PreviousActorLocation(ForceInitToZero)
@@ -39,23 +78,64 @@ UDistanceMatchingComponent::UDistanceMatchingComponent()
 	, CapsuleHalfHeight(0.0f)
 	, DistanceToFloor(0.0f)
 	, GravityZ(0.0f)
+	, GroundZ(0.0f)
 	, bShowDebug(false)
 	, bDrawDebugTrace(false)
 	, bIsMoving(false)
 	, bIsAccelerating(false)
 	, bIsFalling(false)
+	, bStartMarkerUpdated(false)
+	, bIsSleeping(false)
+	, bHasJumpTrajectory(false)
+	, bHasLandingPath(false)
+	, bFidelityRaised(false)
+	, BatchIndex(INDEX_NONE)
+	, WakeUpFrame(0)
+	, JumpTrajectoryTime(0.0f)
+	, LandingPathTime(0.0f)
+	, StopRefinementLocation(FVector::ZeroVector)
+	, ScheduledPrediction(EDistanceMatchingPrediction::None)
+	, ScheduledDeltaTime(0.0f)
+	, SweepCount(0)
+	, SnapshotSequence(0)
+	, LastMarkerSendTime(0.0)
 	, DistanceMatchingType(EDistanceMatchingType::None)
+	, Fidelity(EDistanceMatchingFidelity::Full)
 	, MaxSimulationTime(2.0f)
 	, ApexSimulationFrequency(5.0f)
 	, LandingSimulationFrequency(5.0f)
+	, bUseAdaptiveJumpPath(false)
+	, JumpPathTolerance(10.0f)
+	, JumpPathHitTolerance(2.0f)
+	, StopPredictionMethod(EDistanceMatchingStopPredictionMethod::Analytic)
 	, MinPivotAngle(150.0f)
 	, TraceChannel(TraceTypeQuery1)
+	, TraceMode(EDistanceMatchingTraceMode::Sync)
 	, StopLocationTraceHalfHeight(150.0f)
+	, bUseBroadphaseLanding(false)
+	, MaxBroadphaseCandidates(8)
+	, bUseJumpTrajectory(false)
+	, JumpTrajectoryTolerance(10.0f)
+	, bRefineMarkers(false)
+	, MarkerRefinementTolerance(10.0f)
+	, MaxRefinementSweeps(2)
+	, bUseBatchTick(false)
+	, bSleepWhenIdle(false)
+	, bUseTraceBudget(false)
+	, bReplicateMarkers(false)
+	, FidelityMode(EDistanceMatchingFidelityMode::Manual)
+	, ReducedFidelityDistance(3000.0f)
+	, MinimalFidelityDistance(8000.0f)
+	, ReducedFidelitySignificance(0.5f)
+	, MinimalFidelitySignificance(0.1f)
+	, FidelityHysteresis(0.1f)
+	, bReduceFidelityWhenNotRendered(true)
 	, DebugSphereRadius(16.0f)
 	, DebugDrawTime(1.5f)
 	, TraceDrawTime(2.0f)
 {
 	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.TickGroup = TG_PrePhysics;
 	bWantsInitializeComponent = true;
 }
 
@@ -86,298 +166,1517 @@ void UDistanceMatchingComponent::InitializeComponent()
 
 	ActorLocation = Character->GetActorLocation();
 	PreviousActorLocation = ActorLocation;
+
+	if (bReplicateMarkers)
+	{
+		SetIsReplicated(true);
+	}
 }
 
-void UDistanceMatchingComponent::TickComponent(const float DeltaTime, const ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+void UDistanceMatchingComponent::BeginPlay()
 {
-	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+	Super::BeginPlay();
 
-	// Update character essential values
-	PreviousActorLocation = ActorLocation;
-	ActorLocation = Character->GetActorLocation();
-	Velocity = Character->GetVelocity();
-	VelocitySize = Velocity.Size();
-	PreviousAccelerationSize = AccelerationSize;
-	Acceleration = MovementComponent->GetCurrentAcceleration();
-	AccelerationSize = Acceleration.Size();
-	CapsuleRadius = CapsuleComponent->GetScaledCapsuleRadius();
-	CapsuleHalfHeight = CapsuleComponent->GetScaledCapsuleHalfHeight();
-	DistanceToFloor = MovementComponent->CurrentFloor.FloorDist;
-	GravityZ = MovementComponent->GetGravityZ();
+	if (!Character || !MovementComponent || !CapsuleComponent)
+	{
+		return;
+	}
 
-	// Update character movement states
-	bIsMoving = VelocitySize > MOVEMENT_THRESHOLD;
-	bIsAccelerating = AccelerationSize > MOVEMENT_THRESHOLD;
-	bIsFalling = MovementComponent->IsFalling();
+	AddTickDependencies();
 
-#if ENABLE_DRAW_DEBUG
-	bShowDebug = DistanceMatchingCVars::Debug == 1;
-	bDrawDebugTrace = DistanceMatchingCVars::DrawDebugTrace == 1;
+	// Characters spawned in the air land at the spawn height until they touch a floor
+	GroundZ = Character->GetActorLocation().Z;
 
-	if (bShowDebug)
+	if (bUseBatchTick)
 	{
-		DrawDebugSphere(World, ActorLocation, DebugSphereRadius, 16.0f, FColor::Green, false, -1.0f, 0, 0.3f);
+		if (UDistanceMatchingSubsystem* Subsystem = World->GetSubsystem<UDistanceMatchingSubsystem>())
+		{
+			SetComponentTickEnabled(false);
+			Subsystem->RegisterComponent(this);
+		}
 	}
-#endif
 
-	if (DistanceMatchingType != EDistanceMatchingType::Jump && bIsFalling && Velocity.Z > 0.0f)
+	if (bSleepWhenIdle)
 	{
-		DistanceMatchingType = EDistanceMatchingType::Jump;
-		PredictJumpApex(ApexMarker);
-		TakeOffMarker.Location = PreviousActorLocation;
-		TakeOffMarker.Time = 0.0f;
+		Character->MovementModeChangedDelegate.AddDynamic(this, &UDistanceMatchingComponent::OnMovementModeChanged);
+		Character->OnCharacterMovementUpdated.AddDynamic(this, &UDistanceMatchingComponent::OnCharacterMovementUpdated);
+	}
+}
 
-#if ENABLE_DRAW_DEBUG
-		if (bShowDebug)
+void UDistanceMatchingComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (BatchIndex != INDEX_NONE)
+	{
+		if (UDistanceMatchingSubsystem* Subsystem = World->GetSubsystem<UDistanceMatchingSubsystem>())
 		{
-			DrawDebugSphere(World, TakeOffMarker.Location, DebugSphereRadius, 16.0f, FColor::Green, false, DebugDrawTime, 0, 0.3f);
-			DrawDebugSphere(World, ApexMarker.Location, DebugSphereRadius, 16.0f, FColor::Purple, false, DebugDrawTime, 0, 0.3f);
+			Subsystem->UnregisterComponent(this);
 		}
-#endif
 	}
-	else if (DistanceMatchingType != EDistanceMatchingType::Fall && bIsFalling && Velocity.Z < 0.0f)
+
+	if (bIsSleeping)
 	{
-		DistanceMatchingType = EDistanceMatchingType::Fall;
-		PredictLandingLocation(LandingMarker);
+		bIsSleeping = false;
+		DEC_DWORD_STAT(STAT_DistanceMatching_ComponentsSleeping);
 	}
-	else if (!bIsFalling)
+
+	// The subsystem skips the queued entry
+	ScheduledPrediction = EDistanceMatchingPrediction::None;
+
+	if (Character && MovementComponent)
 	{
-		if (bIsAccelerating)
-		{
-			if (DistanceMatchingType != EDistanceMatchingType::Start && (Velocity | Acceleration) > 0.0f && bIsMoving)
-			{
-				DistanceMatchingType = EDistanceMatchingType::Start;
-				if (PreviousAccelerationSize < MOVEMENT_THRESHOLD)
-				{
-					StartMarker.Location = PreviousActorLocation;
-					StartMarker.Time = 0.0f;
-					StartMarker.Distance = 0.0f;
+		RemoveTickDependencies();
+		Character->MovementModeChangedDelegate.RemoveDynamic(this, &UDistanceMatchingComponent::OnMovementModeChanged);
+		Character->OnCharacterMovementUpdated.RemoveDynamic(this, &UDistanceMatchingComponent::OnCharacterMovementUpdated);
+	}
 
-#if ENABLE_DRAW_DEBUG
-					if (bShowDebug)
-					{
-						DrawDebugSphere(World, StartMarker.Location, DebugSphereRadius, 16.0f, FColor::Orange, false, DebugDrawTime, 0, 0.3f);
-					}
-#endif
-				}
-			}
-			else if (DistanceMatchingType != EDistanceMatchingType::Pivot && (Velocity.GetSafeNormal() | Acceleration.GetSafeNormal()) <= -(MinPivotAngle / 180.0f))
-			{
-				DistanceMatchingType = EDistanceMatchingType::Pivot;
-				PredictStopLocation(PivotMarker, DeltaTime);
+	Super::EndPlay(EndPlayReason);
+}
+
+void UDistanceMatchingComponent::TickComponent(const float DeltaTime, const ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	DISTANCE_MATCHING_SCOPE_CYCLE_COUNTER_CSV(TickComponent);
+	DISTANCE_MATCHING_SCOPED_TIMER(TickComponent);
+
+	// Already updated on wake up in this frame
+	if (WakeUpFrame == GFrameCounter)
+	{
+		return;
+	}
+
+	Update(DeltaTime);
+
+	if (ShouldSleep())
+	{
+		Sleep();
+	}
+}
+
+void UDistanceMatchingComponent::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	// The owner predicts the markers itself
+	DOREPLIFETIME_CONDITION(UDistanceMatchingComponent, ReplicatedMarkers, COND_SkipOwner);
+}
+
+void UDistanceMatchingComponent::Update(const float DeltaTime)
+{
+	UpdateMovementState();
+
+	// State and markers come from the server, only the distances to them are updated
+	if (UsesReplicatedMarkers())
+	{
+		UpdateMarkers(DeltaTime);
+		return;
+	}
+
+	UpdateFidelityFromView();
+
+	const EDistanceMatchingPrediction Prediction = UpdateDistanceMatchingType();
+	ResolvePendingPredictions();
+	UpdateJumpTrajectory(Prediction, DeltaTime);
+	RunPrediction(Prediction, DeltaTime);
+	RefineMarkers(Prediction, DeltaTime);
+	SendReplicatedMarkers(Prediction);
 
 #if ENABLE_DRAW_DEBUG
-				if (bShowDebug)
-				{
-					DrawDebugSphere(World, PivotMarker.Location, DebugSphereRadius, 16.0f, FColor::Purple, false, DebugDrawTime, 0, 0.3f);
-				}
+	DrawDebug(Prediction);
 #endif
-			}
-		}
-		else if (DistanceMatchingType != EDistanceMatchingType::Stop && bIsMoving && !bIsAccelerating)
-		{
-			DistanceMatchingType = EDistanceMatchingType::Stop;
-			PredictStopLocation(StopMarker, DeltaTime);
-		}
-		else if (!bIsMoving && !bIsAccelerating)
-		{
-			DistanceMatchingType = EDistanceMatchingType::None;
-		}
+
+	UpdateMarkers(DeltaTime);
+}
+
+void UDistanceMatchingComponent::SendReplicatedMarkers(const EDistanceMatchingPrediction Prediction)
+{
+	if (!bReplicateMarkers || UsesReplicatedMarkers())
+	{
+		return;
 	}
 
-#if ENABLE_DRAW_DEBUG
-	if (bShowDebug)
+	// Player controlled characters send from the owning client, the server forwards them
+	const bool bIsAuthority = GetOwnerRole() == ROLE_Authority;
+	if (bIsAuthority && Character->IsPlayerControlled() && !Character->IsLocallyControlled())
 	{
-		if (DistanceMatchingType == EDistanceMatchingType::Stop)
-		{
-			DrawDebugSphere(World, StopMarker.Location, DebugSphereRadius, 16.0f, FColor::Red, false, -1.0f, 0, 0.3f);
-		}
-		else if (DistanceMatchingType == EDistanceMatchingType::Fall)
+		return;
+	}
+
+	FDistanceMatchingReplicatedMarkers NewReplicatedMarkers = MakeReplicatedMarkers();
+	const bool bIsTransition = Prediction != EDistanceMatchingPrediction::None || bStartMarkerUpdated || NewReplicatedMarkers.DistanceMatchingType != ReplicatedMarkers.DistanceMatchingType;
+	const double CurrentTime = World->GetTimeSeconds();
+
+	if (!bIsTransition)
+	{
+		// Times change every frame, refined locations are sent only, and at most once per interval
+		if (NewReplicatedMarkers.FirstLocation == ReplicatedMarkers.FirstLocation && NewReplicatedMarkers.SecondLocation == ReplicatedMarkers.SecondLocation)
 		{
-			DrawDebugSphere(World, LandingMarker.Location, DebugSphereRadius, 16.0f, FColor::Red, false, -1.0f, 0, 0.3f);
+			return;
 		}
-		if (bIsMoving)
+
+		if (CurrentTime - LastMarkerSendTime < DistanceMatchingCVars::MarkerRefinementSendInterval)
 		{
-			DrawDebugLine(World, PreviousActorLocation, ActorLocation, FColor::Cyan, false, DebugDrawTime, 0, 0.75f);
+			return;
 		}
 	}
-#endif
 
-	// Update distance and time to marker
+	NewReplicatedMarkers.TransitionCount = ReplicatedMarkers.TransitionCount + (bIsTransition ? 1 : 0);
+	ReplicatedMarkers = NewReplicatedMarkers;
+	LastMarkerSendTime = CurrentTime;
+
+	if (bIsAuthority)
+	{
+		return;
+	}
+
+	// A lost refinement is replaced by the next one, transitions must arrive
+	if (bIsTransition)
+	{
+		ServerSetReplicatedMarkers(ReplicatedMarkers);
+	}
+	else
+	{
+		ServerRefineReplicatedMarkers(ReplicatedMarkers);
+	}
+}
+
+void UDistanceMatchingComponent::GetReplicatedMarkers(FPredictResult*& OutFirstMarker, FPredictResult*& OutSecondMarker)
+{
+	OutFirstMarker = nullptr;
+	OutSecondMarker = nullptr;
+
 	switch (DistanceMatchingType)
 	{
 		case EDistanceMatchingType::Start:
-			StartMarker.Distance = FMath::Clamp(FVector::Distance(ActorLocation, StartMarker.Location), -MAX_MATCH_VALUE, MAX_MATCH_VALUE);
-			StartMarker.Time = FMath::Clamp(StartMarker.Time + DeltaTime, 0.0f, MAX_MATCH_VALUE);
+			OutFirstMarker = &StartMarker;
 			break;
 		case EDistanceMatchingType::Stop:
-			StopMarker.Distance = FMath::Clamp(FVector::Distance(ActorLocation, StopMarker.Location), -MAX_MATCH_VALUE, MAX_MATCH_VALUE) * -1.0f;
-			StopMarker.Time = FMath::Clamp(StopMarker.Time - DeltaTime, 0.0f, MAX_MATCH_VALUE);
+			OutFirstMarker = &StopMarker;
 			break;
 		case EDistanceMatchingType::Pivot:
-			PivotMarker.Distance = FMath::Clamp(FVector::Distance(ActorLocation, PivotMarker.Location), -MAX_MATCH_VALUE, MAX_MATCH_VALUE) * -1.0f;
-			PivotMarker.Time = FMath::Clamp(PivotMarker.Time - DeltaTime, 0.0f, MAX_MATCH_VALUE);
+			OutFirstMarker = &PivotMarker;
 			break;
 		case EDistanceMatchingType::Jump:
-			TakeOffMarker.Distance = FMath::Clamp(ActorLocation.Z - TakeOffMarker.Location.Z, 0.0f, ApexMarker.Location.Z - TakeOffMarker.Location.Z);
-			ApexMarker.Distance = FMath::Clamp(ApexMarker.Location.Z - ActorLocation.Z, 0.0f, ApexMarker.Location.Z - TakeOffMarker.Location.Z) * -1.0f;
-			TakeOffMarker.Time = FMath::Clamp(TakeOffMarker.Time + DeltaTime, 0.0f, MAX_MATCH_VALUE);
-			ApexMarker.Time = FMath::Clamp(ApexMarker.Time - DeltaTime, 0.0f, MAX_MATCH_VALUE);
+			OutFirstMarker = &TakeOffMarker;
+			OutSecondMarker = &ApexMarker;
 			break;
 		case EDistanceMatchingType::Fall:
-			ApexMarker.Distance = FMath::Clamp(ApexMarker.Location.Z - ActorLocation.Z, 0.0f, ApexMarker.Location.Z - LandingMarker.Location.Z);
-			LandingMarker.Distance = FMath::Clamp((ActorLocation.Z - LandingMarker.Location.Z) * -1.0f, -ApexMarker.Location.Z, 0.0f);
-			ApexMarker.Time = FMath::Clamp(ApexMarker.Time + DeltaTime, 0.0f, MAX_MATCH_VALUE);
-			LandingMarker.Time = FMath::Clamp(LandingMarker.Time - DeltaTime, 0.0f, MAX_MATCH_VALUE);
+			OutFirstMarker = &ApexMarker;
+			OutSecondMarker = &LandingMarker;
 			break;
 		case EDistanceMatchingType::None:
-			StartMarker.Distance = 0.0f;
-			StopMarker.Distance = 0.0f;
-			PivotMarker.Distance = 0.0f;
-			TakeOffMarker.Distance = 0.0f;
-			ApexMarker.Distance = 0.0f;
-			LandingMarker.Distance = 0.0f;
-			StartMarker.Time = 0.0f;
-			StopMarker.Time = 0.0f;
-			PivotMarker.Time = 0.0f;
-			TakeOffMarker.Time = 0.0f;
-			ApexMarker.Time = 0.0f;
-			LandingMarker.Time = 0.0f;
 			break;
 	}
 }
 
-void UDistanceMatchingComponent::PredictStopLocation(FPredictResult& PredictResult, const float DeltaTime) const
+FDistanceMatchingReplicatedMarkers UDistanceMatchingComponent::MakeReplicatedMarkers()
 {
-	const float FrictionFactor = FMath::Max(0.0f, MovementComponent->BrakingFrictionFactor);
-	const float Friction = FMath::Max(0.0f, MovementComponent->GroundFriction * FrictionFactor);
-	const float BrakingDeceleration = FMath::Max(0.0f, MovementComponent->GetMaxBrakingDeceleration());
-	const bool bZeroFriction = Friction == 0.0f;
-	const bool bZeroBraking = BrakingDeceleration == 0.0f;
-	const float BrakeToStopVelocity = MovementComponent->BRAKE_TO_STOP_VELOCITY;
-	const bool bZeroAcceleration = Acceleration.IsZero();
+	FDistanceMatchingReplicatedMarkers Markers;
+	Markers.DistanceMatchingType = DistanceMatchingType;
 
-	FVector PredictedVelocity = bZeroAcceleration ? Velocity : Velocity.ProjectOnToNormal(Acceleration.GetSafeNormal());
-	FVector PredictedLocation = ActorLocation;
-	float PredictionTime = 0.0f;
+	FPredictResult* FirstMarker;
+	FPredictResult* SecondMarker;
+	GetReplicatedMarkers(FirstMarker, SecondMarker);
 
-	while (MaxSimulationTime > PredictionTime)
+	if (FirstMarker)
 	{
-		const FVector PreviousVelocity = PredictedVelocity;
-		const float SimulationTimeStep = FMath::Min(MaxSimulationTime - DeltaTime, DeltaTime);
+		Markers.FirstLocation = FirstMarker->Location;
+		Markers.FirstTime = FirstMarker->Time;
+	}
 
-		// Apply velocity braking
-		if (bZeroAcceleration)
-		{
-			if (PredictedVelocity.IsZero() || bZeroFriction && bZeroBraking)
-			{
-				break;
-			}
+	if (SecondMarker)
+	{
+		Markers.SecondLocation = SecondMarker->Location;
+		Markers.SecondTime = SecondMarker->Time;
+	}
+
+	return Markers;
+}
 
-			// Decelerate to brake to a stop
-			const FVector ReverseAcceleration = bZeroBraking ? FVector::ZeroVector : -BrakingDeceleration * PredictedVelocity.GetSafeNormal();
+void UDistanceMatchingComponent::ServerSetReplicatedMarkers_Implementation(const FDistanceMatchingReplicatedMarkers& InReplicatedMarkers)
+{
+	ReplicatedMarkers = InReplicatedMarkers;
+}
 
-			// Apply friction and braking
-			PredictedVelocity = PredictedVelocity + (-Friction * PredictedVelocity + ReverseAcceleration) * SimulationTimeStep;
+void UDistanceMatchingComponent::ServerRefineReplicatedMarkers_Implementation(const FDistanceMatchingReplicatedMarkers& InReplicatedMarkers)
+{
+	// Unreliable refinements may arrive around a newer transition, only the ones of the current transition apply
+	if (InReplicatedMarkers.TransitionCount == ReplicatedMarkers.TransitionCount && InReplicatedMarkers.DistanceMatchingType == ReplicatedMarkers.DistanceMatchingType)
+	{
+		ReplicatedMarkers = InReplicatedMarkers;
+	}
+}
 
-			// Clamp to zero if nearly zero, or if below min threshold and braking
-			const float VelocitySizeSquared = PredictedVelocity.SizeSquared();
-			if (VelocitySizeSquared <= KINDA_SMALL_NUMBER || !bZeroBraking && VelocitySizeSquared <= FMath::Square(BrakeToStopVelocity))
-			{
-				break;
-			}
-		}
-		else
-		{
-			// Friction affects our ability to change direction. This is only done for input acceleration, not path following.
-			const FVector AccelerationDirection = Acceleration.GetSafeNormal();
-			const float Speed = PredictedVelocity.Size();
-			PredictedVelocity = PredictedVelocity - (PredictedVelocity - AccelerationDirection * Speed) * FMath::Min(SimulationTimeStep * Friction, 1.0f);
+void UDistanceMatchingComponent::OnRep_ReplicatedMarkers()
+{
+	if (!UsesReplicatedMarkers())
+	{
+		return;
+	}
 
-			// Apply additional requested acceleration
-			PredictedVelocity += Acceleration * SimulationTimeStep;
-		}
+	DistanceMatchingType = ReplicatedMarkers.DistanceMatchingType;
 
-		// Don't reverse direction
-		if ((PredictedVelocity | PreviousVelocity) <= 0.0f)
-		{
-			break;
-		}
+	FPredictResult* FirstMarker;
+	FPredictResult* SecondMarker;
+	GetReplicatedMarkers(FirstMarker, SecondMarker);
 
-		PredictedLocation += PredictedVelocity * SimulationTimeStep;
-		PredictionTime += SimulationTimeStep;
+	if (FirstMarker)
+	{
+		FirstMarker->Location = ReplicatedMarkers.FirstLocation;
+		FirstMarker->Time = ReplicatedMarkers.FirstTime;
+		FirstMarker->bIsPending = false;
 	}
 
-	FHitResult HitResult;
-	const FVector TraceStart = FVector(PredictedLocation.X, PredictedLocation.Y, PredictedLocation.Z + StopLocationTraceHalfHeight);
-	const FVector TraceEnd = FVector(PredictedLocation.X, PredictedLocation.Y, PredictedLocation.Z - StopLocationTraceHalfHeight);
-	const EDrawDebugTrace::Type DrawDebugTrace = bDrawDebugTrace ? EDrawDebugTrace::ForDuration : EDrawDebugTrace::None;
+	if (SecondMarker)
+	{
+		SecondMarker->Location = ReplicatedMarkers.SecondLocation;
+		SecondMarker->Time = ReplicatedMarkers.SecondTime;
+		SecondMarker->bIsPending = false;
+	}
 
-	const bool bHit = UKismetSystemLibrary::CapsuleTraceSingle(World, TraceStart, TraceEnd, CapsuleRadius, CapsuleHalfHeight, TraceChannel, false, ActorsToIgnore, DrawDebugTrace, HitResult, true, FLinearColor::Red, FLinearColor::Green, TraceDrawTime);
+	if (bIsSleeping)
+	{
+		WakeUp(World->GetDeltaSeconds());
+	}
+}
+
+void UDistanceMatchingComponent::AddTickDependencies()
+{
+	PrimaryComponentTick.AddPrerequisite(MovementComponent, MovementComponent->PrimaryComponentTick);
 
-	if (bHit)
+	if (USkeletalMeshComponent* Mesh = Character->GetMesh())
 	{
-		PredictResult.Location = FVector(HitResult.Location.X, HitResult.Location.Y, HitResult.Location.Z + DistanceToFloor);
-		PredictResult.Time = PredictionTime;
+		Mesh->PrimaryComponentTick.AddPrerequisite(this, PrimaryComponentTick);
+	}
+}
 
-		return;
+void UDistanceMatchingComponent::RemoveTickDependencies()
+{
+	PrimaryComponentTick.RemovePrerequisite(MovementComponent, MovementComponent->PrimaryComponentTick);
+
+	if (USkeletalMeshComponent* Mesh = Character->GetMesh())
+	{
+		Mesh->PrimaryComponentTick.RemovePrerequisite(this, PrimaryComponentTick);
 	}
+}
 
-	PredictResult.Location = PredictedLocation;
-	PredictResult.Time = PredictionTime;
+bool UDistanceMatchingComponent::ShouldSleep() const
+{
+	return bSleepWhenIdle && DistanceMatchingType == EDistanceMatchingType::None && !bIsMoving && !bIsAccelerating && !bIsFalling && PendingPredictions.Num() == 0 && ScheduledPrediction == EDistanceMatchingPrediction::None;
 }
 
-void UDistanceMatchingComponent::PredictJumpPath(FPredictResult& PredictResult, const float SimulationTime, const float SimulationFrequency) const
+void UDistanceMatchingComponent::Sleep()
 {
-	const float SubstepDeltaTime = 1.0f / SimulationFrequency;
+	bIsSleeping = true;
+	INC_DWORD_STAT(STAT_DistanceMatching_ComponentsSleeping);
+
+	if (BatchIndex != INDEX_NONE)
+	{
+		World->GetSubsystem<UDistanceMatchingSubsystem>()->UnregisterComponent(this);
+	}
+	else
+	{
+		SetComponentTickEnabled(false);
+	}
+}
 
-	FVector CurrentVelocity = Velocity;
-	FVector TraceStart = ActorLocation;
-	FVector TraceEnd = TraceStart;
-	float CurrentTime = 0.0f;
+void UDistanceMatchingComponent::WakeUp(const float DeltaTime)
+{
+	bIsSleeping = false;
+	WakeUpFrame = GFrameCounter;
+	DEC_DWORD_STAT(STAT_DistanceMatching_ComponentsSleeping);
 
-	while (CurrentTime < SimulationTime)
+	UDistanceMatchingSubsystem* Subsystem = bUseBatchTick ? World->GetSubsystem<UDistanceMatchingSubsystem>() : nullptr;
+	if (Subsystem)
+	{
+		Subsystem->RegisterComponentNextFrame(this);
+	}
+	else
 	{
-		// Limit step to not go further than total time.
-		const float PreviousTime = CurrentTime;
-		const float ActualStepDeltaTime = FMath::Min(SimulationTime - CurrentTime, SubstepDeltaTime);
-		CurrentTime += ActualStepDeltaTime;
+		SetComponentTickEnabled(true);
+	}
 
-		// Integrate (Velocity Verlet method)
-		TraceStart = TraceEnd;
-		FVector PreviousVelocity = CurrentVelocity;
-		CurrentVelocity = PreviousVelocity + FVector(0.f, 0.f, GravityZ * ActualStepDeltaTime);
-		TraceEnd = TraceStart + (PreviousVelocity + CurrentVelocity) * (0.5f * ActualStepDeltaTime);
+	// The tick may have run already in this frame, catch up with the movement right away
+	Update(DeltaTime);
+}
 
-		FHitResult HitResult;
-		const EDrawDebugTrace::Type DrawDebugTrace = bDrawDebugTrace ? EDrawDebugTrace::ForDuration : EDrawDebugTrace::None;
+void UDistanceMatchingComponent::OnMovementModeChanged(ACharacter* InCharacter, EMovementMode PrevMovementMode, uint8 PreviousCustomMode)
+{
+	if (bIsSleeping)
+	{
+		WakeUp(World->GetDeltaSeconds());
+	}
+}
 
-		const bool bHit = UKismetSystemLibrary::CapsuleTraceSingle(World, TraceStart, TraceEnd, CapsuleRadius, CapsuleHalfHeight, TraceChannel, false, ActorsToIgnore, DrawDebugTrace, HitResult, true, FLinearColor::Red, FLinearColor::Green, TraceDrawTime);
+void UDistanceMatchingComponent::OnCharacterMovementUpdated(float DeltaSeconds, FVector OldLocation, FVector OldVelocity)
+{
+	if (bIsSleeping && (!Character->GetVelocity().IsNearlyZero(MOVEMENT_THRESHOLD) || !MovementComponent->GetCurrentAcceleration().IsNearlyZero(MOVEMENT_THRESHOLD)))
+	{
+		WakeUp(DeltaSeconds);
+	}
+}
 
-		if (bHit)
-		{
-			PredictResult.Location = HitResult.Location;
-			PredictResult.Time = PreviousTime + ActualStepDeltaTime * HitResult.Time;
+void UDistanceMatchingComponent::UpdateMovementState()
+{
+	ApplyMovementState(
+		Character->GetActorLocation(),
+		Character->GetVelocity(),
+		MovementComponent->GetCurrentAcceleration(),
+		CapsuleComponent->GetScaledCapsuleRadius(),
+		CapsuleComponent->GetScaledCapsuleHalfHeight(),
+		MovementComponent->CurrentFloor.FloorDist,
+		MovementComponent->GetGravityZ(),
+		MovementComponent->IsFalling());
+}
 
-			return;
-		}
+void UDistanceMatchingComponent::ApplyMovementState(const FVector& InActorLocation, const FVector& InVelocity, const FVector& InAcceleration, const float InCapsuleRadius, const float InCapsuleHalfHeight, const float InDistanceToFloor, const float InGravityZ, const bool bInIsFalling)
+{
+	// Update character essential values
+	PreviousActorLocation = ActorLocation;
+	ActorLocation = InActorLocation;
+	Velocity = InVelocity;
+	VelocitySize = Velocity.Size();
+	PreviousAccelerationSize = AccelerationSize;
+	Acceleration = InAcceleration;
+	AccelerationSize = Acceleration.Size();
+	CapsuleRadius = InCapsuleRadius;
+	CapsuleHalfHeight = InCapsuleHalfHeight;
+	DistanceToFloor = InDistanceToFloor;
+	GravityZ = InGravityZ;
+
+	// Update character movement states
+	bIsMoving = VelocitySize > MOVEMENT_THRESHOLD;
+	bIsAccelerating = AccelerationSize > MOVEMENT_THRESHOLD;
+	bIsFalling = bInIsFalling;
+
+	// Kept through the fall, so a ledge fall doesn't solve against a stale take-off marker
+	DistanceMatchingStateMachine::UpdateGroundZ(GetMovement(), DistanceToFloor, GroundZ);
+
+#if ENABLE_DRAW_DEBUG
+	bShowDebug = DistanceMatchingCVars::Debug == 1;
+	bDrawDebugTrace = DistanceMatchingCVars::DrawDebugTrace == 1;
+#endif
+}
+
+FDistanceMatchingMovement UDistanceMatchingComponent::GetMovement() const
+{
+	return FDistanceMatchingMovement{ ActorLocation, PreviousActorLocation, Velocity, Acceleration, PreviousAccelerationSize, bIsMoving, bIsAccelerating, bIsFalling };
+}
+
+FDistanceMatchingMarkersRef UDistanceMatchingComponent::GetMarkersRef()
+{
+	return FDistanceMatchingMarkersRef(DistanceMatchingType, StartMarker, StopMarker, PivotMarker, TakeOffMarker, ApexMarker, LandingMarker);
+}
+
+EDistanceMatchingPrediction UDistanceMatchingComponent::UpdateDistanceMatchingType()
+{
+	bool bStartMarkerWasUpdated;
+	EDistanceMatchingPrediction Prediction = DistanceMatchingStateMachine::UpdateType(GetMovement(), MinPivotAngle, GetMarkersRef(), bStartMarkerWasUpdated);
+	bStartMarkerUpdated = bStartMarkerWasUpdated;
+
+	if (Prediction == EDistanceMatchingPrediction::None && bFidelityRaised)
+	{
+		// Markers of the current state were predicted with fewer traces, predict them again at the new fidelity
+		Prediction = GetTypePrediction();
 	}
+	bFidelityRaised = false;
 
-	PredictResult.Location = TraceEnd;
-	PredictResult.Time = SimulationTime;
+	return Prediction;
 }
 
-void UDistanceMatchingComponent::PredictJumpApex(FPredictResult& PredictResult) const
+void UDistanceMatchingComponent::RunPrediction(const EDistanceMatchingPrediction Prediction, const float DeltaTime)
 {
-	// Velocity * Sin jump angle / Gravity
-	const float MaxTimeToApex = VelocitySize * Velocity.GetSafeNormal().Z / FMath::Abs(GravityZ);
+	DISTANCE_MATCHING_SCOPED_TIMER(Prediction);
+
+	if (Prediction == EDistanceMatchingPrediction::None)
+	{
+		return;
+	}
+
+	DISTANCE_MATCHING_INC_COUNTER(Predictions, 1);
 
-	PredictJumpPath(PredictResult, MaxTimeToApex, ApexSimulationFrequency);
+	if (Fidelity == EDistanceMatchingFidelity::Minimal)
+	{
+		// No traces at this fidelity, the trace-free estimate is the final marker
+		PublishEstimate(Prediction, DeltaTime);
+		GetPredictionMarker(Prediction)->bIsPending = false;
+		return;
+	}
+
+	if (bUseTraceBudget && Fidelity == EDistanceMatchingFidelity::Full && SchedulePrediction(Prediction, DeltaTime))
+	{
+		return;
+	}
+
+	PredictMarker(Prediction, DeltaTime);
+}
+
+void UDistanceMatchingComponent::PredictMarker(const EDistanceMatchingPrediction Prediction, const float DeltaTime)
+{
+	switch (Prediction)
+	{
+		case EDistanceMatchingPrediction::Stop:
+			PredictStopLocation(StopMarker, DeltaTime);
+			break;
+		case EDistanceMatchingPrediction::Pivot:
+			PredictStopLocation(PivotMarker, DeltaTime);
+			break;
+		case EDistanceMatchingPrediction::JumpApex:
+			PredictJumpApex(ApexMarker);
+			break;
+		case EDistanceMatchingPrediction::Landing:
+			PredictLandingLocation(LandingMarker);
+			break;
+		case EDistanceMatchingPrediction::None:
+			break;
+	}
 }
 
-void UDistanceMatchingComponent::PredictLandingLocation(FPredictResult& PredictResult) const
+bool UDistanceMatchingComponent::SchedulePrediction(const EDistanceMatchingPrediction Prediction, const float DeltaTime)
 {
-	PredictJumpPath(PredictResult, MaxSimulationTime, LandingSimulationFrequency);
+	// Landing from the jump trajectory doesn't trace
+	if (Prediction == EDistanceMatchingPrediction::Landing && bHasJumpTrajectory)
+	{
+		return false;
+	}
+
+	UDistanceMatchingSubsystem* Subsystem = World->GetSubsystem<UDistanceMatchingSubsystem>();
+	if (!Subsystem)
+	{
+		return false;
+	}
+
+	// A newer transition takes the place of the prediction waiting in the queue
+	if (ScheduledPrediction != EDistanceMatchingPrediction::None)
+	{
+		GetPredictionMarker(ScheduledPrediction)->bIsPending = false;
+	}
+	else
+	{
+		Subsystem->SchedulePrediction(this);
+	}
+
+	ScheduledPrediction = Prediction;
+	ScheduledDeltaTime = DeltaTime;
+
+	PublishEstimate(Prediction, DeltaTime);
+
+	return true;
+}
+
+void UDistanceMatchingComponent::RunScheduledPrediction()
+{
+	const EDistanceMatchingPrediction Prediction = ScheduledPrediction;
+	if (Prediction == EDistanceMatchingPrediction::None)
+	{
+		return;
+	}
+
+	ScheduledPrediction = EDistanceMatchingPrediction::None;
+
+	FPredictResult* Marker = GetPredictionMarker(Prediction);
+
+	// The state moved on or the fidelity dropped while waiting, the estimate stays
+	bool bIsStale = Fidelity != EDistanceMatchingFidelity::Full;
+	switch (Prediction)
+	{
+		case EDistanceMatchingPrediction::Stop:
+			bIsStale |= DistanceMatchingType != EDistanceMatchingType::Stop;
+			break;
+		case EDistanceMatchingPrediction::Pivot:
+			bIsStale |= DistanceMatchingType != EDistanceMatchingType::Pivot;
+			break;
+		case EDistanceMatchingPrediction::JumpApex:
+			bIsStale |= DistanceMatchingType != EDistanceMatchingType::Jump;
+			break;
+		case EDistanceMatchingPrediction::Landing:
+			bIsStale |= DistanceMatchingType != EDistanceMatchingType::Fall;
+			break;
+		case EDistanceMatchingPrediction::None:
+			break;
+	}
+
+	if (bIsStale)
+	{
+		Marker->bIsPending = false;
+		return;
+	}
+
+	PredictMarker(Prediction, ScheduledDeltaTime);
+}
+
+void UDistanceMatchingComponent::ChargeTraceBudget(const uint32 PrevSweepCount) const
+{
+	if (!bUseTraceBudget || SweepCount == PrevSweepCount)
+	{
+		return;
+	}
+
+	if (UDistanceMatchingSubsystem* Subsystem = World->GetSubsystem<UDistanceMatchingSubsystem>())
+	{
+		Subsystem->ChargeSweeps(SweepCount - PrevSweepCount);
+	}
+}
+
+void UDistanceMatchingComponent::PublishEstimate(const EDistanceMatchingPrediction Prediction, const float DeltaTime)
+{
+	FVector EstimatedLocation = ActorLocation;
+	float EstimatedTime = 0.0f;
+
+	switch (Prediction)
+	{
+		case EDistanceMatchingPrediction::Stop:
+		case EDistanceMatchingPrediction::Pivot:
+			if (StopPredictionMethod == EDistanceMatchingStopPredictionMethod::Analytic)
+			{
+				SolveStopLocation(EstimatedLocation, EstimatedTime);
+			}
+			else
+			{
+				SimulateStopLocation(DeltaTime, EstimatedLocation, EstimatedTime);
+			}
+			break;
+		case EDistanceMatchingPrediction::JumpApex:
+			DistanceMatchingStateMachine::SolveJumpApex(ActorLocation, Velocity, GravityZ, MaxSimulationTime, EstimatedLocation, EstimatedTime);
+			break;
+		case EDistanceMatchingPrediction::Landing:
+			SolveLandingEstimate(EstimatedLocation, EstimatedTime);
+			break;
+		case EDistanceMatchingPrediction::None:
+			return;
+	}
+
+	FPredictResult* Marker = GetPredictionMarker(Prediction);
+	ResolvePrediction(*Marker, EstimatedLocation, EstimatedTime);
+	Marker->bIsPending = true;
+}
+
+FPredictResult* UDistanceMatchingComponent::GetPredictionMarker(const EDistanceMatchingPrediction Prediction)
+{
+	switch (Prediction)
+	{
+		case EDistanceMatchingPrediction::Stop:
+			return &StopMarker;
+		case EDistanceMatchingPrediction::Pivot:
+			return &PivotMarker;
+		case EDistanceMatchingPrediction::JumpApex:
+			return &ApexMarker;
+		case EDistanceMatchingPrediction::Landing:
+			return &LandingMarker;
+		case EDistanceMatchingPrediction::None:
+			break;
+	}
+
+	return nullptr;
+}
+
+EDistanceMatchingPrediction UDistanceMatchingComponent::GetTypePrediction() const
+{
+	switch (DistanceMatchingType)
+	{
+		case EDistanceMatchingType::Stop:
+			return EDistanceMatchingPrediction::Stop;
+		case EDistanceMatchingType::Pivot:
+			return EDistanceMatchingPrediction::Pivot;
+		case EDistanceMatchingType::Jump:
+			return EDistanceMatchingPrediction::JumpApex;
+		case EDistanceMatchingType::Fall:
+			return EDistanceMatchingPrediction::Landing;
+		case EDistanceMatchingType::Start:
+		case EDistanceMatchingType::None:
+			break;
+	}
+
+	return EDistanceMatchingPrediction::None;
+}
+
+void UDistanceMatchingComponent::ResolvePendingPredictions()
+{
+	DISTANCE_MATCHING_SCOPE_CYCLE_COUNTER(ResolvePendingPredictions);
+
+	// Follow-up sweeps of async paths
+	const uint32 PrevSweepCount = SweepCount;
+
+	for (int32 PendingIndex = PendingPredictions.Num() - 1; PendingIndex >= 0; PendingIndex--)
+	{
+		FPendingPrediction& Pending = PendingPredictions[PendingIndex];
+		bool bIsReady = true;
+		bool bHasHit = false;
+
+		// The first blocking sweep along the path wins
+		for (int32 StepIndex = 0; StepIndex < Pending.TraceHandles.Num(); StepIndex++)
+		{
+			FTraceDatum TraceDatum;
+			if (!World->QueryTraceData(Pending.TraceHandles[StepIndex], TraceDatum))
+			{
+				// Results of expired handles are lost, treat them as no hit
+				bIsReady = !World->IsTraceHandleValid(Pending.TraceHandles[StepIndex], false);
+				if (bIsReady)
+				{
+					continue;
+				}
+				break;
+			}
+
+			const FHitResult* HitResult = TraceDatum.OutHits.FindByPredicate([](const FHitResult& Hit) { return Hit.bBlockingHit; });
+			if (!HitResult)
+			{
+				continue;
+			}
+
+			FPredictResult& Marker = *Pending.Marker;
+			bHasHit = true;
+
+			if (Pending.SweepType == EPendingSweepType::Ceiling)
+			{
+				// Something is above the take-off location, the arc sweeps follow to find where the jump is blocked
+				break;
+			}
+
+			Marker.Location = FVector(HitResult->Location.X, HitResult->Location.Y, HitResult->Location.Z + Pending.LocationOffsetZ);
+
+			if (Pending.SweepType == EPendingSweepType::Path)
+			{
+				// Marker time has been counting down since it was published, shift it by the difference only
+				const float StepStartTime = Pending.StepStartTimes[StepIndex];
+				const float HitTime = StepStartTime + Pending.StepDurations[StepIndex] * HitResult->Time;
+				Marker.Time = FMath::Max(0.0f, Marker.Time + HitTime - Pending.PredictedTime);
+				Pending.PredictedTime = HitTime;
+
+				// Sweep the sub-step which hit again in shorter steps, their first hit replaces this one
+				Pending.PathSweep.RefineStep(StepStartTime, StepStartTime + Pending.StepDurations[StepIndex]);
+			}
+
+#if ENABLE_DRAW_DEBUG
+			if (bDrawDebugTrace)
+			{
+				DrawDebugSphere(World, Marker.Location, CapsuleRadius, 12, FColor::Green, false, TraceDrawTime);
+			}
+#endif
+			break;
+		}
+
+		if (bIsReady && Pending.SweepType == EPendingSweepType::Ceiling && bHasHit)
+		{
+			// The arc up to the apex is swept in the next stage, the marker stays pending meanwhile
+			Pending.SweepType = EPendingSweepType::Path;
+			bIsReady = !RequestPathSweeps(Pending);
+		}
+		else if (bIsReady && Pending.SweepType == EPendingSweepType::Path)
+		{
+			// Without a hit the next chunk of the path follows, after a hit the refinement of the sub-step which hit
+			bIsReady = !RequestPathSweeps(Pending);
+		}
+
+		if (bIsReady)
+		{
+			Pending.Marker->bIsPending = false;
+			PendingPredictions.RemoveAtSwap(PendingIndex, 1, false);
+		}
+	}
+
+	ChargeTraceBudget(PrevSweepCount);
+}
+
+UDistanceMatchingComponent::FPendingPrediction& UDistanceMatchingComponent::AddPendingPrediction(FPredictResult& Marker)
+{
+	PendingPredictions.RemoveAllSwap([&Marker](const FPendingPrediction& Pending) { return Pending.Marker == &Marker; }, false);
+
+	FPendingPrediction& Pending = PendingPredictions.AddDefaulted_GetRef();
+	Pending.Marker = &Marker;
+	Marker.bIsPending = true;
+
+	return Pending;
+}
+
+FTraceHandle UDistanceMatchingComponent::RequestAsyncSweep(const FVector& Start, const FVector& End) const
+{
+	FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(DistanceMatchingAsyncSweep), false);
+	for (AActor* ActorToIgnore : ActorsToIgnore)
+	{
+		QueryParams.AddIgnoredActor(ActorToIgnore);
+	}
+
+	const FCollisionShape CapsuleShape = FCollisionShape::MakeCapsule(CapsuleRadius, CapsuleHalfHeight);
+
+	DISTANCE_MATCHING_INC_COUNTER(Sweeps, 1);
+	SweepCount++;
+
+	return World->AsyncSweepByChannel(EAsyncTraceType::Single, Start, End, FQuat::Identity, UEngineTypes::ConvertToCollisionChannel(TraceChannel), CapsuleShape, QueryParams);
+}
+
+bool UDistanceMatchingComponent::RequestPathSweeps(FPendingPrediction& Pending) const
+{
+	Pending.TraceHandles.Reset();
+	Pending.StepStartTimes.Reset();
+	Pending.StepDurations.Reset();
+
+	DistanceMatchingCore::FVec3 StepStart;
+	DistanceMatchingCore::FVec3 StepEnd;
+	float StepStartTime;
+	float StepEndTime;
+
+	const int32 MaxSweeps = FMath::Max(1, DistanceMatchingCVars::AsyncPathSweeps);
+	while (Pending.TraceHandles.Num() < MaxSweeps && Pending.PathSweep.NextStep(StepStart, StepEnd, StepStartTime, StepEndTime))
+	{
+		Pending.TraceHandles.Add(RequestAsyncSweep(DistanceMatchingCore::ToVector(StepStart), DistanceMatchingCore::ToVector(StepEnd)));
+		Pending.StepStartTimes.Add(StepStartTime);
+		Pending.StepDurations.Add(StepEndTime - StepStartTime);
+	}
+
+	return Pending.TraceHandles.Num() > 0;
+}
+
+void UDistanceMatchingComponent::UpdateMarkers(const float DeltaTime)
+{
+	if (!bHasJumpTrajectory)
+	{
+		DistanceMatchingStateMachine::UpdateMarkers(ActorLocation, DeltaTime, GetMarkersRef());
+		PublishSnapshot();
+		return;
+	}
+
+	// The character is within JumpTrajectoryTolerance of the trajectory, so distances and times are both taken from it at the elapsed time.
+	// They stay consistent with each other instead of mixing the traced location with accumulated frame times.
+	const FVector TrajectoryLocation = DistanceMatchingCore::ToVector(JumpTrajectory.GetLocation(JumpTrajectoryTime));
+	DistanceMatchingStateMachine::UpdateMarkers(TrajectoryLocation, DeltaTime, GetMarkersRef());
+
+	// Elapsed times since the take-off and the apex stay accumulated, a trajectory solved again mid-air starts where it drifted off
+	if (DistanceMatchingType == EDistanceMatchingType::Jump)
+	{
+		ApexMarker.Time = FMath::Clamp(JumpTrajectory.ApexTime - JumpTrajectoryTime, 0.0f, MAX_MATCH_VALUE);
+	}
+	else if (DistanceMatchingType == EDistanceMatchingType::Fall)
+	{
+		LandingMarker.Time = FMath::Clamp(JumpTrajectory.LandingTime - JumpTrajectoryTime, 0.0f, MAX_MATCH_VALUE);
+	}
+
+	PublishSnapshot();
+}
+
+void UDistanceMatchingComponent::PublishSnapshot()
+{
+	const uint32 Sequence = SnapshotSequence.load(std::memory_order_relaxed);
+
+	// Odd sequence tells readers of the other buffer that it's about to be reused
+	SnapshotSequence.store(Sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	FDistanceMatchingSnapshot& Snapshot = Snapshots[((Sequence >> 1) + 1) & 1];
+	Snapshot.DistanceMatchingType = DistanceMatchingType;
+	Snapshot.StartMarker = StartMarker;
+	Snapshot.StopMarker = StopMarker;
+	Snapshot.PivotMarker = PivotMarker;
+	Snapshot.TakeOffMarker = TakeOffMarker;
+	Snapshot.ApexMarker = ApexMarker;
+	Snapshot.LandingMarker = LandingMarker;
+
+	SnapshotSequence.store(Sequence + 2, std::memory_order_release);
+}
+
+FDistanceMatchingSnapshot UDistanceMatchingComponent::GetSnapshot() const
+{
+	FDistanceMatchingSnapshot Snapshot;
+	while (true)
+	{
+		const uint32 SequenceBefore = SnapshotSequence.load(std::memory_order_acquire);
+		Snapshot = Snapshots[(SequenceBefore >> 1) & 1];
+		std::atomic_thread_fence(std::memory_order_acquire);
+		const uint32 SequenceAfter = SnapshotSequence.load(std::memory_order_relaxed);
+
+		// The buffer is reused by the write which starts two sequences after the last published one
+		if (SequenceAfter - (SequenceBefore & ~1u) <= 2)
+		{
+			return Snapshot;
+		}
+	}
+}
+
+#if ENABLE_DRAW_DEBUG
+void UDistanceMatchingComponent::DrawDebug(const EDistanceMatchingPrediction Prediction) const
+{
+	if (!bShowDebug)
+	{
+		return;
+	}
+
+	DrawDebugSphere(World, ActorLocation, DebugSphereRadius, 16.0f, FColor::Green, false, -1.0f, 0, 0.3f);
+
+	if (Prediction == EDistanceMatchingPrediction::JumpApex)
+	{
+		DrawDebugSphere(World, TakeOffMarker.Location, DebugSphereRadius, 16.0f, FColor::Green, false, DebugDrawTime, 0, 0.3f);
+		DrawDebugSphere(World, ApexMarker.Location, DebugSphereRadius, 16.0f, FColor::Purple, false, DebugDrawTime, 0, 0.3f);
+	}
+	else if (Prediction == EDistanceMatchingPrediction::Pivot)
+	{
+		DrawDebugSphere(World, PivotMarker.Location, DebugSphereRadius, 16.0f, FColor::Purple, false, DebugDrawTime, 0, 0.3f);
+	}
+
+	if (bStartMarkerUpdated)
+	{
+		DrawDebugSphere(World, StartMarker.Location, DebugSphereRadius, 16.0f, FColor::Orange, false, DebugDrawTime, 0, 0.3f);
+	}
+
+	if (DistanceMatchingType == EDistanceMatchingType::Stop)
+	{
+		DrawDebugSphere(World, StopMarker.Location, DebugSphereRadius, 16.0f, FColor::Red, false, -1.0f, 0, 0.3f);
+	}
+	else if (DistanceMatchingType == EDistanceMatchingType::Fall)
+	{
+		DrawDebugSphere(World, LandingMarker.Location, DebugSphereRadius, 16.0f, FColor::Red, false, -1.0f, 0, 0.3f);
+	}
+
+	if (bIsMoving)
+	{
+		DrawDebugLine(World, PreviousActorLocation, ActorLocation, FColor::Cyan, false, DebugDrawTime, 0, 0.75f);
+	}
+}
+#endif
+
+void UDistanceMatchingComponent::PredictStopLocation(FPredictResult& PredictResult, const float DeltaTime)
+{
+	DISTANCE_MATCHING_SCOPE_CYCLE_COUNTER_CSV(PredictStopLocation);
+
+	FVector PredictedLocation;
+	float PredictionTime;
+
+	if (StopPredictionMethod == EDistanceMatchingStopPredictionMethod::Analytic)
+	{
+		SolveStopLocation(PredictedLocation, PredictionTime);
+		StopRefinementLocation = PredictedLocation;
+	}
+	else
+	{
+		SimulateStopLocation(DeltaTime, PredictedLocation, PredictionTime);
+
+		if (bRefineMarkers)
+		{
+			float RefinementTime;
+			SolveStopLocation(StopRefinementLocation, RefinementTime);
+		}
+	}
+
+	if (Fidelity == EDistanceMatchingFidelity::Reduced)
+	{
+		ResolvePrediction(PredictResult, PredictedLocation, PredictionTime);
+		return;
+	}
+
+	if (TraceMode == EDistanceMatchingTraceMode::Async)
+	{
+		// Publish the simulated location, the floor trace will correct it in the next frame
+		PredictResult.Location = PredictedLocation;
+		PredictResult.Time = PredictionTime;
+
+		const FVector TraceStart = FVector(PredictedLocation.X, PredictedLocation.Y, PredictedLocation.Z + StopLocationTraceHalfHeight);
+		const FVector TraceEnd = FVector(PredictedLocation.X, PredictedLocation.Y, PredictedLocation.Z - StopLocationTraceHalfHeight);
+
+		FPendingPrediction& Pending = AddPendingPrediction(PredictResult);
+		Pending.TraceHandles.Add(RequestAsyncSweep(TraceStart, TraceEnd));
+		Pending.PredictedTime = PredictionTime;
+		Pending.LocationOffsetZ = DistanceToFloor;
+
+		return;
+	}
+
+	FCapsuleQuery Query(*this);
+	DistanceMatchingCore::FVec3 FloorLocation;
+	DistanceMatchingCore::ProjectToFloor(DistanceMatchingCore::ToCore(PredictedLocation), StopLocationTraceHalfHeight, Query, DistanceToFloor, FloorLocation);
+
+	PredictResult.bIsPending = false;
+	PredictResult.Location = DistanceMatchingCore::ToVector(FloorLocation);
+	PredictResult.Time = PredictionTime;
+}
+
+DistanceMatchingCore::FBrakingParams UDistanceMatchingComponent::GetBrakingParams() const
+{
+	const float FrictionFactor = FMath::Max(0.0f, MovementComponent->BrakingFrictionFactor);
+
+	DistanceMatchingCore::FBrakingParams Braking;
+	Braking.Friction = FMath::Max(0.0f, MovementComponent->GroundFriction * FrictionFactor);
+	Braking.BrakingDeceleration = FMath::Max(0.0f, MovementComponent->GetMaxBrakingDeceleration());
+	Braking.BrakeToStopVelocity = MovementComponent->BRAKE_TO_STOP_VELOCITY;
+
+	return Braking;
+}
+
+void UDistanceMatchingComponent::SolveStopLocation(FVector& OutLocation, float& OutTime) const
+{
+	DistanceMatchingCore::FVec3 StopLocation;
+	DistanceMatchingCore::SolveStopLocation(DistanceMatchingCore::ToCore(ActorLocation), DistanceMatchingCore::ToCore(Velocity), DistanceMatchingCore::ToCore(Acceleration), GetBrakingParams(), MaxSimulationTime, StopLocation, OutTime);
+	OutLocation = DistanceMatchingCore::ToVector(StopLocation);
+}
+
+void UDistanceMatchingComponent::SimulateStopLocation(const float DeltaTime, FVector& OutLocation, float& OutTime) const
+{
+	DistanceMatchingCore::FVec3 StopLocation;
+	DistanceMatchingCore::SimulateStopLocation(DistanceMatchingCore::ToCore(ActorLocation), DistanceMatchingCore::ToCore(Velocity), DistanceMatchingCore::ToCore(Acceleration), GetBrakingParams(), MaxSimulationTime, DeltaTime, StopLocation, OutTime);
+	OutLocation = DistanceMatchingCore::ToVector(StopLocation);
+}
+
+void UDistanceMatchingComponent::PredictJumpPath(FPredictResult& PredictResult, const float SimulationTime, const float SimulationFrequency, const float LocationOffsetZ)
+{
+	PredictResult.Time = SimulationTime;
+
+	if (TraceMode == EDistanceMatchingTraceMode::Async)
+	{
+		// Sub-steps are swept a chunk per frame, the first hit along the path is taken when the results arrive
+		FPendingPrediction& Pending = AddPendingPrediction(PredictResult);
+		Pending.PathSweep.Start(DistanceMatchingCore::ToCore(ActorLocation), DistanceMatchingCore::ToCore(Velocity), GravityZ, SimulationTime, GetJumpPathStepping(SimulationFrequency));
+		Pending.PredictedTime = SimulationTime;
+		Pending.LocationOffsetZ = LocationOffsetZ;
+		Pending.SweepType = EPendingSweepType::Path;
+		RequestPathSweeps(Pending);
+
+		PredictResult.Location = DistanceMatchingCore::ToVector(Pending.PathSweep.GetLocation(SimulationTime)) + FVector(0.0f, 0.0f, LocationOffsetZ);
+		return;
+	}
+
+	FJumpPath Path;
+	BuildJumpPath(ActorLocation, Velocity, SimulationTime, GetJumpPathStepping(SimulationFrequency), Path);
+
+	PredictResult.Location = DistanceMatchingCore::ToVector(Path.Last()) + FVector(0.0f, 0.0f, LocationOffsetZ);
+	PredictResult.bIsPending = false;
+
+	FVector HitLocation;
+	float HitTime;
+	if (SweepJumpPath(Path, HitLocation, HitTime))
+	{
+		PredictResult.Location = HitLocation + FVector(0.0f, 0.0f, LocationOffsetZ);
+		PredictResult.Time = HitTime;
+	}
+}
+
+void UDistanceMatchingComponent::BuildJumpPath(const FVector& StartLocation, const FVector& StartVelocity, const float SimulationTime, const DistanceMatchingCore::FJumpPathStepping& Stepping, FJumpPath& OutPath) const
+{
+	DistanceMatchingCore::BuildJumpPath(DistanceMatchingCore::ToCore(StartLocation), DistanceMatchingCore::ToCore(StartVelocity), GravityZ, SimulationTime, Stepping, OutPath);
+}
+
+bool UDistanceMatchingComponent::SweepJumpPath(const FJumpPath& Path, FVector& OutLocation, float& OutTime) const
+{
+	FCapsuleQuery Query(*this);
+	DistanceMatchingCore::FVec3 HitLocation;
+
+	if (DistanceMatchingCore::SweepJumpPath(Path, Query, HitLocation, OutTime))
+	{
+		OutLocation = DistanceMatchingCore::ToVector(HitLocation);
+		return true;
+	}
+
+	return false;
+}
+
+UDistanceMatchingComponent::FPrimitiveQuery::FPrimitiveQuery(const UDistanceMatchingComponent& InComponent, UPrimitiveComponent& InPrimitive)
+	: Component(InComponent)
+	, Primitive(InPrimitive)
+	, Bounds(InPrimitive.Bounds.GetBox().ExpandBy(FVector(InComponent.CapsuleRadius, InComponent.CapsuleRadius, InComponent.CapsuleHalfHeight)))
+{
+}
+
+bool UDistanceMatchingComponent::FPrimitiveQuery::Sweep(const DistanceMatchingCore::FVec3& Start, const DistanceMatchingCore::FVec3& End, DistanceMatchingCore::FVec3& OutLocation, float& OutFraction)
+{
+	const FVector StepStart = DistanceMatchingCore::ToVector(Start);
+	const FVector StepEnd = DistanceMatchingCore::ToVector(End);
+
+	// The capsule can't touch the primitive on this sub-step
+	if (!Bounds.Intersect(FBox(StepStart.ComponentMin(StepEnd), StepStart.ComponentMax(StepEnd))))
+	{
+		return false;
+	}
+
+	DISTANCE_MATCHING_INC_COUNTER(Sweeps, 1);
+	Component.SweepCount++;
+
+	FHitResult HitResult;
+	if (Primitive.SweepComponent(HitResult, StepStart, StepEnd, FQuat::Identity, FCollisionShape::MakeCapsule(Component.CapsuleRadius, Component.CapsuleHalfHeight)))
+	{
+		OutLocation = DistanceMatchingCore::ToCore(HitResult.Location);
+		OutFraction = HitResult.Time;
+		return true;
+	}
+
+	return false;
+}
+
+bool UDistanceMatchingComponent::FCapsuleQuery::Sweep(const DistanceMatchingCore::FVec3& Start, const DistanceMatchingCore::FVec3& End, DistanceMatchingCore::FVec3& OutLocation, float& OutFraction)
+{
+	const EDrawDebugTrace::Type DrawDebugTrace = Component.bDrawDebugTrace ? EDrawDebugTrace::ForDuration : EDrawDebugTrace::None;
+
+	DISTANCE_MATCHING_INC_COUNTER(Sweeps, 1);
+	Component.SweepCount++;
+
+	FHitResult HitResult;
+	if (UKismetSystemLibrary::CapsuleTraceSingle(Component.World, DistanceMatchingCore::ToVector(Start), DistanceMatchingCore::ToVector(End), Component.CapsuleRadius, Component.CapsuleHalfHeight, Component.TraceChannel, false, Component.ActorsToIgnore, DrawDebugTrace, HitResult, true, FLinearColor::Red, FLinearColor::Green, Component.TraceDrawTime))
+	{
+		OutLocation = DistanceMatchingCore::ToCore(HitResult.Location);
+		OutFraction = HitResult.Time;
+		return true;
+	}
+
+	return false;
+}
+
+void UDistanceMatchingComponent::PredictJumpApex(FPredictResult& PredictResult)
+{
+	DISTANCE_MATCHING_SCOPE_CYCLE_COUNTER_CSV(PredictJumpApex);
+
+	if (bUseJumpTrajectory && Fidelity == EDistanceMatchingFidelity::Full && TraceMode == EDistanceMatchingTraceMode::Sync)
+	{
+		PredictJumpTrajectory();
+		return;
+	}
+
+	FVector ApexLocation;
+	float MaxTimeToApex;
+	DistanceMatchingStateMachine::SolveJumpApex(ActorLocation, Velocity, GravityZ, MaxSimulationTime, ApexLocation, MaxTimeToApex);
+
+	// One sweep up to the apex height instead of sweeping every sub-step of the arc
+	const FVector CeilingTraceEnd = FVector(ActorLocation.X, ActorLocation.Y, ApexLocation.Z);
+
+	if (Fidelity == EDistanceMatchingFidelity::Reduced)
+	{
+		ResolvePrediction(PredictResult, ApexLocation, MaxTimeToApex);
+		return;
+	}
+
+	PredictResult.Location = ApexLocation;
+	PredictResult.Time = MaxTimeToApex;
+
+	if (TraceMode == EDistanceMatchingTraceMode::Async)
+	{
+		FPendingPrediction& Pending = AddPendingPrediction(PredictResult);
+		Pending.TraceHandles.Add(RequestAsyncSweep(ActorLocation, CeilingTraceEnd));
+		Pending.PredictedTime = MaxTimeToApex;
+		Pending.SweepType = EPendingSweepType::Ceiling;
+		Pending.PathSweep.Start(DistanceMatchingCore::ToCore(ActorLocation), DistanceMatchingCore::ToCore(Velocity), GravityZ, MaxTimeToApex, GetJumpPathStepping(ApexSimulationFrequency));
+
+		return;
+	}
+
+	FCapsuleQuery Query(*this);
+	DistanceMatchingCore::FVec3 HitLocation;
+	float HitFraction;
+
+	if (Query.Sweep(DistanceMatchingCore::ToCore(ActorLocation), DistanceMatchingCore::ToCore(CeilingTraceEnd), HitLocation, HitFraction))
+	{
+		PredictJumpPath(PredictResult, MaxTimeToApex, ApexSimulationFrequency);
+		return;
+	}
+
+	PredictResult.bIsPending = false;
+}
+
+void UDistanceMatchingComponent::PredictLandingLocation(FPredictResult& PredictResult)
+{
+	DISTANCE_MATCHING_SCOPE_CYCLE_COUNTER_CSV(PredictLandingLocation);
+
+	if (bRefineMarkers)
+	{
+		// Only the path is kept, it's swept again when the fall leaves it
+		LandingPath.Start(DistanceMatchingCore::ToCore(ActorLocation), DistanceMatchingCore::ToCore(Velocity), GravityZ, MaxSimulationTime, GetJumpPathStepping(LandingSimulationFrequency));
+		LandingPath.Finish();
+		LandingPathTime = 0.0f;
+		bHasLandingPath = true;
+	}
+
+	if (bHasJumpTrajectory)
+	{
+		// Solved at the take-off and still followed, no need to sweep the arc again
+		const FVector LandingLocation = DistanceMatchingCore::ToVector(JumpTrajectory.LandingLocation) + FVector(0.0f, 0.0f, DistanceToFloor);
+		ResolvePrediction(PredictResult, LandingLocation, FMath::Max(0.0f, JumpTrajectory.LandingTime - JumpTrajectoryTime));
+		return;
+	}
+
+	if (Fidelity == EDistanceMatchingFidelity::Reduced)
+	{
+		FVector LandingLocation;
+		float LandingTime;
+		SolveLandingEstimate(LandingLocation, LandingTime);
+		ResolvePrediction(PredictResult, LandingLocation, LandingTime);
+		return;
+	}
+
+	if (bUseBroadphaseLanding && TraceMode == EDistanceMatchingTraceMode::Sync && PredictLandingLocationBroadphase(PredictResult))
+	{
+		return;
+	}
+
+	PredictJumpPath(PredictResult, MaxSimulationTime, LandingSimulationFrequency, DistanceToFloor);
+}
+
+void UDistanceMatchingComponent::PredictJumpTrajectory()
+{
+	DISTANCE_MATCHING_SCOPE_CYCLE_COUNTER_CSV(PredictJumpTrajectory);
+
+	FCapsuleQuery Query(*this);
+	DistanceMatchingCore::BuildJumpTrajectory(DistanceMatchingCore::ToCore(ActorLocation), DistanceMatchingCore::ToCore(Velocity), GravityZ, MaxSimulationTime, GetJumpPathStepping(ApexSimulationFrequency), GetJumpPathStepping(LandingSimulationFrequency), Query, JumpTrajectory);
+
+	JumpTrajectoryTime = 0.0f;
+	bHasJumpTrajectory = !JumpTrajectory.bIsApexBlocked;
+
+	// The apex is behind a falling character
+	if (DistanceMatchingType == EDistanceMatchingType::Jump)
+	{
+		ResolvePrediction(ApexMarker, DistanceMatchingCore::ToVector(JumpTrajectory.ApexLocation), JumpTrajectory.ApexTime);
+	}
+
+	if (bHasJumpTrajectory)
+	{
+		ResolvePrediction(LandingMarker, DistanceMatchingCore::ToVector(JumpTrajectory.LandingLocation) + FVector(0.0f, 0.0f, DistanceToFloor), JumpTrajectory.LandingTime);
+	}
+}
+
+void UDistanceMatchingComponent::UpdateJumpTrajectory(const EDistanceMatchingPrediction Prediction, const float DeltaTime)
+{
+	if (!bHasJumpTrajectory)
+	{
+		return;
+	}
+
+	if (DistanceMatchingType != EDistanceMatchingType::Jump && DistanceMatchingType != EDistanceMatchingType::Fall)
+	{
+		bHasJumpTrajectory = false;
+		return;
+	}
+
+	JumpTrajectoryTime += DeltaTime;
+
+	// A new take-off solves its own trajectory
+	if (Prediction == EDistanceMatchingPrediction::JumpApex)
+	{
+		return;
+	}
+
+	const FVector TrajectoryLocation = DistanceMatchingCore::ToVector(JumpTrajectory.GetLocation(JumpTrajectoryTime));
+	if (FVector::DistSquared(ActorLocation, TrajectoryLocation) <= FMath::Square(JumpTrajectoryTolerance))
+	{
+		return;
+	}
+
+	if (Fidelity != EDistanceMatchingFidelity::Full)
+	{
+		// Markers already published stay as they are, the landing is predicted as usual
+		bHasJumpTrajectory = false;
+		return;
+	}
+
+	DISTANCE_MATCHING_INC_COUNTER(Predictions, 1);
+	const uint32 PrevSweepCount = SweepCount;
+	PredictJumpTrajectory();
+	ChargeTraceBudget(PrevSweepCount);
+}
+
+void UDistanceMatchingComponent::RefineMarkers(const EDistanceMatchingPrediction Prediction, const float DeltaTime)
+{
+	if (DistanceMatchingType != EDistanceMatchingType::Fall)
+	{
+		bHasLandingPath = false;
+	}
+
+	if (!bRefineMarkers || UsesReplicatedMarkers() || Fidelity != EDistanceMatchingFidelity::Full || Prediction != EDistanceMatchingPrediction::None)
+	{
+		return;
+	}
+
+	DISTANCE_MATCHING_SCOPE_CYCLE_COUNTER(RefineMarkers);
+
+	const uint32 PrevSweepCount = SweepCount;
+
+	switch (DistanceMatchingType)
+	{
+		case EDistanceMatchingType::Stop:
+			RefineStopMarker(StopMarker, DeltaTime);
+			break;
+		case EDistanceMatchingType::Pivot:
+			RefineStopMarker(PivotMarker, DeltaTime);
+			break;
+		case EDistanceMatchingType::Fall:
+			RefineLandingMarker(DeltaTime);
+			break;
+		case EDistanceMatchingType::Start:
+		case EDistanceMatchingType::Jump:
+		case EDistanceMatchingType::None:
+			break;
+	}
+
+	ChargeTraceBudget(PrevSweepCount);
+}
+
+void UDistanceMatchingComponent::RefineStopMarker(FPredictResult& PredictResult, const float DeltaTime)
+{
+	if (PredictResult.bIsPending)
+	{
+		return;
+	}
+
+	// The closed form is cheap enough for every update, the simulation only runs once the marker has to move.
+	// Comparing analytic solutions with each other keeps the integration error of the simulation out of the check.
+	FVector PredictedLocation;
+	float PredictionTime;
+	SolveStopLocation(PredictedLocation, PredictionTime);
+
+	// The floor trace only corrects the height, so compare the planar location
+	if (FVector::DistSquaredXY(PredictedLocation, StopRefinementLocation) <= FMath::Square(MarkerRefinementTolerance))
+	{
+		return;
+	}
+
+	DISTANCE_MATCHING_INC_COUNTER(MarkerRefinements, 1);
+
+	StopRefinementLocation = PredictedLocation;
+
+	switch (StopPredictionMethod)
+	{
+		case EDistanceMatchingStopPredictionMethod::Analytic:
+			break;
+		case EDistanceMatchingStopPredictionMethod::Iterative:
+			SimulateStopLocation(DeltaTime, PredictedLocation, PredictionTime);
+			break;
+	}
+
+	FCapsuleQuery Query(*this);
+	DistanceMatchingCore::FVec3 FloorLocation;
+	DistanceMatchingCore::ProjectToFloor(DistanceMatchingCore::ToCore(PredictedLocation), StopLocationTraceHalfHeight, Query, DistanceToFloor, FloorLocation);
+
+	ResolvePrediction(PredictResult, DistanceMatchingCore::ToVector(FloorLocation), PredictionTime);
+}
+
+void UDistanceMatchingComponent::RefineLandingMarker(const float DeltaTime)
+{
+	// The jump trajectory checks the fall itself
+	if (!bHasLandingPath || bHasJumpTrajectory || LandingMarker.bIsPending)
+	{
+		return;
+	}
+
+	LandingPathTime += DeltaTime;
+
+	if (LandingPath.IsDone())
+	{
+		const FVector PathLocation = DistanceMatchingCore::ToVector(LandingPath.GetLocation(LandingPathTime));
+		if (FVector::DistSquared(ActorLocation, PathLocation) <= FMath::Square(MarkerRefinementTolerance))
+		{
+			return;
+		}
+
+		DISTANCE_MATCHING_INC_COUNTER(MarkerRefinements, 1);
+
+		// Land at the same height until the new path is swept
+		FVector EstimatedLocation;
+		float EstimatedTime;
+		DistanceMatchingStateMachine::SolveLandingLocation(ActorLocation, Velocity, GravityZ, LandingMarker.Location.Z - DistanceToFloor, MaxSimulationTime, EstimatedLocation, EstimatedTime);
+		LandingMarker.Location = EstimatedLocation + FVector(0.0f, 0.0f, DistanceToFloor);
+		LandingMarker.Time = EstimatedTime;
+
+		LandingPath.Start(DistanceMatchingCore::ToCore(ActorLocation), DistanceMatchingCore::ToCore(Velocity), GravityZ, MaxSimulationTime, GetJumpPathStepping(LandingSimulationFrequency));
+		LandingPathTime = 0.0f;
+	}
+
+	// The part of the path behind the character has been passed without a hit already
+	LandingPath.SkipTo(LandingPathTime);
+
+	FCapsuleQuery Query(*this);
+	DistanceMatchingCore::FVec3 HitLocation;
+	float HitTime;
+
+	if (LandingPath.Advance(Query, MaxRefinementSweeps, HitLocation, HitTime))
+	{
+		LandingMarker.Location = DistanceMatchingCore::ToVector(HitLocation) + FVector(0.0f, 0.0f, DistanceToFloor);
+		LandingMarker.Time = FMath::Max(0.0f, HitTime - LandingPathTime);
+	}
+	else if (LandingPath.IsDone())
+	{
+		LandingMarker.Location = DistanceMatchingCore::ToVector(LandingPath.GetLocation(LandingPath.EndTime)) + FVector(0.0f, 0.0f, DistanceToFloor);
+		LandingMarker.Time = FMath::Max(0.0f, LandingPath.EndTime - LandingPathTime);
+	}
+}
+
+void UDistanceMatchingComponent::SolveLandingEstimate(FVector& OutLocation, float& OutTime) const
+{
+	DistanceMatchingStateMachine::SolveLandingEstimate(ActorLocation, Velocity, GravityZ, GroundZ, DistanceToFloor, MaxSimulationTime, OutLocation, OutTime);
+}
+
+DistanceMatchingCore::FJumpPathStepping UDistanceMatchingComponent::GetJumpPathStepping(const float SimulationFrequency) const
+{
+	DistanceMatchingCore::FJumpPathStepping Stepping;
+	Stepping.SimulationFrequency = SimulationFrequency;
+
+	if (bUseAdaptiveJumpPath)
+	{
+		Stepping.Tolerance = JumpPathTolerance;
+		Stepping.HitTolerance = JumpPathHitTolerance;
+	}
+
+	return Stepping;
+}
+
+bool UDistanceMatchingComponent::PredictLandingLocationBroadphase(FPredictResult& PredictResult)
+{
+	FJumpPath Path;
+	BuildJumpPath(ActorLocation, Velocity, MaxSimulationTime, GetJumpPathStepping(LandingSimulationFrequency), Path);
+
+	// Bounds of the arc swept by the capsule
+	FBox PathBounds(ForceInit);
+	for (int32 PointIndex = 0; PointIndex < Path.NumPoints; PointIndex++)
+	{
+		PathBounds += DistanceMatchingCore::ToVector(Path.Points[PointIndex]);
+	}
+	PathBounds = PathBounds.ExpandBy(FVector(CapsuleRadius, CapsuleRadius, CapsuleHalfHeight));
+	const ECollisionChannel CollisionChannel = UEngineTypes::ConvertToCollisionChannel(TraceChannel);
+
+	FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(DistanceMatchingLandingBroadphase), false);
+	for (AActor* ActorToIgnore : ActorsToIgnore)
+	{
+		QueryParams.AddIgnoredActor(ActorToIgnore);
+	}
+
+	TArray<FOverlapResult> Overlaps;
+	World->OverlapMultiByChannel(Overlaps, PathBounds.GetCenter(), FQuat::Identity, CollisionChannel, FCollisionShape::MakeBox(PathBounds.GetExtent()), QueryParams);
+
+	// Only blocking primitives can stop the capsule
+	TArray<UPrimitiveComponent*, TInlineAllocator<8>> Candidates;
+	for (const FOverlapResult& Overlap : Overlaps)
+	{
+		UPrimitiveComponent* Component = Overlap.GetComponent();
+		if (Overlap.bBlockingHit && Component)
+		{
+			Candidates.AddUnique(Component);
+			if (Candidates.Num() > MaxBroadphaseCandidates)
+			{
+				return false;
+			}
+		}
+	}
+
+#if ENABLE_DRAW_DEBUG
+	if (bDrawDebugTrace)
+	{
+		DrawDebugBox(World, PathBounds.GetCenter(), PathBounds.GetExtent(), Candidates.Num() > 0 ? FColor::Red : FColor::Green, false, TraceDrawTime);
+	}
+#endif
+
+	// Without candidates there's nothing to land on inside the bounds
+	ResolvePrediction(PredictResult, DistanceMatchingCore::ToVector(Path.Last()) + FVector(0.0f, 0.0f, DistanceToFloor), MaxSimulationTime);
+
+	// The earliest hit among the candidates, as the world sweep would return. Later candidates stop at it.
+	const DistanceMatchingCore::FJumpPathStepping Stepping = GetJumpPathStepping(LandingSimulationFrequency);
+	float LandingTime = MaxSimulationTime;
+
+	for (UPrimitiveComponent* Candidate : Candidates)
+	{
+		DistanceMatchingCore::FJumpPathSweep CandidateSweep;
+		CandidateSweep.Start(DistanceMatchingCore::ToCore(ActorLocation), DistanceMatchingCore::ToCore(Velocity), GravityZ, MaxSimulationTime, Stepping);
+		CandidateSweep.StopAt(LandingTime);
+
+		FPrimitiveQuery Query(*this, *Candidate);
+		DistanceMatchingCore::FVec3 HitLocation;
+		float HitTime;
+		if (CandidateSweep.Advance(Query, MAX_int32, HitLocation, HitTime) && HitTime <= LandingTime)
+		{
+			PredictResult.Location = DistanceMatchingCore::ToVector(HitLocation) + FVector(0.0f, 0.0f, DistanceToFloor);
+			PredictResult.Time = HitTime;
+			LandingTime = HitTime;
+		}
+	}
+
+#if ENABLE_DRAW_DEBUG
+	if (DistanceMatchingCVars::ValidateBroadphaseLanding)
+	{
+		FVector WorldLandingLocation = DistanceMatchingCore::ToVector(Path.Last());
+		float WorldLandingTime = MaxSimulationTime;
+		SweepJumpPath(Path, WorldLandingLocation, WorldLandingTime);
+		WorldLandingLocation.Z += DistanceToFloor;
+
+		if (FVector::Dist(WorldLandingLocation, PredictResult.Location) > DistanceMatchingCVars::ValidateBroadphaseLandingTolerance)
+		{
+			UE_LOG(LogDistanceMatching, Warning, TEXT("Broadphase landing of %s differs from the world sweep: %s at %.3f s, world sweep %s at %.3f s."),
+				*GetNameSafe(GetOwner()), *PredictResult.Location.ToString(), PredictResult.Time, *WorldLandingLocation.ToString(), WorldLandingTime);
+		}
+	}
+#endif
+
+	return true;
+}
+
+void UDistanceMatchingComponent::ResolvePrediction(FPredictResult& PredictResult, const FVector& Location, const float Time)
+{
+	PendingPredictions.RemoveAllSwap([&PredictResult](const FPendingPrediction& Pending) { return Pending.Marker == &PredictResult; }, false);
+
+	PredictResult.Location = Location;
+	PredictResult.Time = Time;
+	PredictResult.bIsPending = false;
+}
+
+void UDistanceMatchingComponent::SetFidelity(const EDistanceMatchingFidelity InFidelity)
+{
+	// Lower tiers come first in the enum
+	bFidelityRaised |= InFidelity < Fidelity;
+	Fidelity = InFidelity;
+}
+
+void UDistanceMatchingComponent::UpdateFidelityFromSignificance(const float Significance)
+{
+	// Lower significance lowers the fidelity, negate it to select the tier as for distance
+	SetFidelity(SelectFidelity(-Significance, -ReducedFidelitySignificance, -MinimalFidelitySignificance));
+}
+
+void UDistanceMatchingComponent::UpdateFidelityFromView()
+{
+	if (FidelityMode != EDistanceMatchingFidelityMode::Distance)
+	{
+		return;
+	}
+
+	const float MinDistanceSquared = GetClosestViewDistanceSquared();
+
+	// Without local views (dedicated server) there is nothing to measure against, keep full fidelity
+	if (MinDistanceSquared == MAX_flt)
+	{
+		SetFidelity(EDistanceMatchingFidelity::Full);
+		return;
+	}
+
+	EDistanceMatchingFidelity NewFidelity = SelectFidelity(FMath::Sqrt(MinDistanceSquared), ReducedFidelityDistance, MinimalFidelityDistance);
+	if (NewFidelity == EDistanceMatchingFidelity::Full && bReduceFidelityWhenNotRendered && !Character->WasRecentlyRendered())
+	{
+		NewFidelity = EDistanceMatchingFidelity::Reduced;
+	}
+
+	SetFidelity(NewFidelity);
+}
+
+float UDistanceMatchingComponent::GetClosestViewDistanceSquared() const
+{
+	const FVector Location = Character->GetActorLocation();
+	float MinDistanceSquared = MAX_flt;
+
+	for (FConstPlayerControllerIterator Iterator = World->GetPlayerControllerIterator(); Iterator; ++Iterator)
+	{
+		const APlayerController* PlayerController = Iterator->Get();
+		if (PlayerController && PlayerController->IsLocalController() && PlayerController->PlayerCameraManager)
+		{
+			MinDistanceSquared = FMath::Min(MinDistanceSquared, FVector::DistSquared(PlayerController->PlayerCameraManager->GetCameraLocation(), Location));
+		}
+	}
+
+	return MinDistanceSquared;
+}
+
+EDistanceMatchingFidelity UDistanceMatchingComponent::SelectFidelity(const float Value, const float ReducedThreshold, const float MinimalThreshold) const
+{
+	// The value must cross a threshold by the hysteresis margin to leave the current tier
+	auto IsAbove = [this, Value](const float Threshold) { return Value > Threshold + FMath::Abs(Threshold) * FidelityHysteresis; };
+	auto IsBelow = [this, Value](const float Threshold) { return Value < Threshold - FMath::Abs(Threshold) * FidelityHysteresis; };
+
+	switch (Fidelity)
+	{
+		case EDistanceMatchingFidelity::Full:
+			return IsAbove(MinimalThreshold) ? EDistanceMatchingFidelity::Minimal : IsAbove(ReducedThreshold) ? EDistanceMatchingFidelity::Reduced : EDistanceMatchingFidelity::Full;
+		case EDistanceMatchingFidelity::Reduced:
+			return IsAbove(MinimalThreshold) ? EDistanceMatchingFidelity::Minimal : IsBelow(ReducedThreshold) ? EDistanceMatchingFidelity::Full : EDistanceMatchingFidelity::Reduced;
+		case EDistanceMatchingFidelity::Minimal:
+			return IsBelow(ReducedThreshold) ? EDistanceMatchingFidelity::Full : IsBelow(MinimalThreshold) ? EDistanceMatchingFidelity::Reduced : EDistanceMatchingFidelity::Minimal;
+	}
 
-	PredictResult.Location += FVector(0.0f, 0.0f, DistanceToFloor);
+	return Fidelity;
 }
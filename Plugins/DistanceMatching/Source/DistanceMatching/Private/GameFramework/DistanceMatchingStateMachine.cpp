@@ -0,0 +1,159 @@
+// Copyright Roman Merkushin. All Rights Reserved.
+
+#include "GameFramework/DistanceMatchingStateMachine.h"
+#include "DistanceMatchingStats.h"
+#include "Core/DistanceMatchingCoreConversion.h"
+#include "Core/DistanceMatchingCoreMovement.h"
+
+EDistanceMatchingPrediction DistanceMatchingStateMachine::UpdateType(const FDistanceMatchingMovement& Movement, const float MinPivotAngle, const FDistanceMatchingMarkersRef& Markers, bool& bOutStartMarkerUpdated)
+{
+	bOutStartMarkerUpdated = false;
+
+	if (Markers.Type != EDistanceMatchingType::Jump && Movement.bIsFalling && Movement.Velocity.Z > 0.0f)
+	{
+		Markers.Type = EDistanceMatchingType::Jump;
+		Markers.TakeOffMarker.Location = Movement.PreviousLocation;
+		Markers.TakeOffMarker.Time = 0.0f;
+
+		return EDistanceMatchingPrediction::JumpApex;
+	}
+
+	if (Markers.Type != EDistanceMatchingType::Fall && Movement.bIsFalling && Movement.Velocity.Z < 0.0f)
+	{
+		Markers.Type = EDistanceMatchingType::Fall;
+
+		return EDistanceMatchingPrediction::Landing;
+	}
+
+	if (!Movement.bIsFalling)
+	{
+		if (Movement.bIsAccelerating)
+		{
+			if (Markers.Type != EDistanceMatchingType::Start && (Movement.Velocity | Movement.Acceleration) > 0.0f && Movement.bIsMoving)
+			{
+				Markers.Type = EDistanceMatchingType::Start;
+				if (Movement.PreviousAccelerationSize < MOVEMENT_THRESHOLD)
+				{
+					Markers.StartMarker.Location = Movement.PreviousLocation;
+					Markers.StartMarker.Time = 0.0f;
+					Markers.StartMarker.Distance = 0.0f;
+					bOutStartMarkerUpdated = true;
+				}
+			}
+			else if (Markers.Type != EDistanceMatchingType::Pivot && (Movement.Velocity.GetSafeNormal() | Movement.Acceleration.GetSafeNormal()) <= -(MinPivotAngle / 180.0f))
+			{
+				Markers.Type = EDistanceMatchingType::Pivot;
+
+				return EDistanceMatchingPrediction::Pivot;
+			}
+		}
+		else if (Markers.Type != EDistanceMatchingType::Stop && Movement.bIsMoving && !Movement.bIsAccelerating)
+		{
+			Markers.Type = EDistanceMatchingType::Stop;
+
+			return EDistanceMatchingPrediction::Stop;
+		}
+		else if (!Movement.bIsMoving && !Movement.bIsAccelerating)
+		{
+			Markers.Type = EDistanceMatchingType::None;
+		}
+	}
+
+	return EDistanceMatchingPrediction::None;
+}
+
+void DistanceMatchingStateMachine::UpdateMarkers(const FVector& Location, const float DeltaTime, const FDistanceMatchingMarkersRef& Markers)
+{
+	FPredictResult& StartMarker = Markers.StartMarker;
+	FPredictResult& StopMarker = Markers.StopMarker;
+	FPredictResult& PivotMarker = Markers.PivotMarker;
+	FPredictResult& TakeOffMarker = Markers.TakeOffMarker;
+	FPredictResult& ApexMarker = Markers.ApexMarker;
+	FPredictResult& LandingMarker = Markers.LandingMarker;
+
+	// Update distance and time to marker
+	switch (Markers.Type)
+	{
+		case EDistanceMatchingType::Start:
+			DISTANCE_MATCHING_INC_COUNTER(ComponentsStart, 1);
+			StartMarker.Distance = FMath::Clamp(FVector::Distance(Location, StartMarker.Location), -MAX_MATCH_VALUE, MAX_MATCH_VALUE);
+			StartMarker.Time = FMath::Clamp(StartMarker.Time + DeltaTime, 0.0f, MAX_MATCH_VALUE);
+			break;
+		case EDistanceMatchingType::Stop:
+			DISTANCE_MATCHING_INC_COUNTER(ComponentsStop, 1);
+			StopMarker.Distance = FMath::Clamp(FVector::Distance(Location, StopMarker.Location), -MAX_MATCH_VALUE, MAX_MATCH_VALUE) * -1.0f;
+			StopMarker.Time = FMath::Clamp(StopMarker.Time - DeltaTime, 0.0f, MAX_MATCH_VALUE);
+			break;
+		case EDistanceMatchingType::Pivot:
+			DISTANCE_MATCHING_INC_COUNTER(ComponentsPivot, 1);
+			PivotMarker.Distance = FMath::Clamp(FVector::Distance(Location, PivotMarker.Location), -MAX_MATCH_VALUE, MAX_MATCH_VALUE) * -1.0f;
+			PivotMarker.Time = FMath::Clamp(PivotMarker.Time - DeltaTime, 0.0f, MAX_MATCH_VALUE);
+			break;
+		case EDistanceMatchingType::Jump:
+			DISTANCE_MATCHING_INC_COUNTER(ComponentsJump, 1);
+			TakeOffMarker.Distance = FMath::Clamp(Location.Z - TakeOffMarker.Location.Z, 0.0f, ApexMarker.Location.Z - TakeOffMarker.Location.Z);
+			ApexMarker.Distance = FMath::Clamp(ApexMarker.Location.Z - Location.Z, 0.0f, ApexMarker.Location.Z - TakeOffMarker.Location.Z) * -1.0f;
+			TakeOffMarker.Time = FMath::Clamp(TakeOffMarker.Time + DeltaTime, 0.0f, MAX_MATCH_VALUE);
+			ApexMarker.Time = FMath::Clamp(ApexMarker.Time - DeltaTime, 0.0f, MAX_MATCH_VALUE);
+			break;
+		case EDistanceMatchingType::Fall:
+			DISTANCE_MATCHING_INC_COUNTER(ComponentsFall, 1);
+			ApexMarker.Distance = FMath::Clamp(ApexMarker.Location.Z - Location.Z, 0.0f, ApexMarker.Location.Z - LandingMarker.Location.Z);
+			LandingMarker.Distance = FMath::Clamp((Location.Z - LandingMarker.Location.Z) * -1.0f, -ApexMarker.Location.Z, 0.0f);
+			ApexMarker.Time = FMath::Clamp(ApexMarker.Time + DeltaTime, 0.0f, MAX_MATCH_VALUE);
+			LandingMarker.Time = FMath::Clamp(LandingMarker.Time - DeltaTime, 0.0f, MAX_MATCH_VALUE);
+			break;
+		case EDistanceMatchingType::None:
+			DISTANCE_MATCHING_INC_COUNTER(ComponentsNone, 1);
+			StartMarker.Distance = 0.0f;
+			StopMarker.Distance = 0.0f;
+			PivotMarker.Distance = 0.0f;
+			TakeOffMarker.Distance = 0.0f;
+			ApexMarker.Distance = 0.0f;
+			LandingMarker.Distance = 0.0f;
+			StartMarker.Time = 0.0f;
+			StopMarker.Time = 0.0f;
+			PivotMarker.Time = 0.0f;
+			TakeOffMarker.Time = 0.0f;
+			ApexMarker.Time = 0.0f;
+			LandingMarker.Time = 0.0f;
+			break;
+	}
+}
+
+void DistanceMatchingStateMachine::SolveStopLocation(const FVector& Location, const FVector& Velocity, const FVector& Acceleration, const float Friction, const float BrakingDeceleration, const float BrakeToStopVelocity, const float MaxSimulationTime, FVector& OutLocation, float& OutTime)
+{
+	const DistanceMatchingCore::FBrakingParams Braking{ Friction, BrakingDeceleration, BrakeToStopVelocity };
+
+	DistanceMatchingCore::FVec3 StopLocation;
+	DistanceMatchingCore::SolveStopLocation(DistanceMatchingCore::ToCore(Location), DistanceMatchingCore::ToCore(Velocity), DistanceMatchingCore::ToCore(Acceleration), Braking, MaxSimulationTime, StopLocation, OutTime);
+	OutLocation = DistanceMatchingCore::ToVector(StopLocation);
+}
+
+void DistanceMatchingStateMachine::SolveJumpApex(const FVector& Location, const FVector& Velocity, const float GravityZ, const float MaxSimulationTime, FVector& OutLocation, float& OutTime)
+{
+	DistanceMatchingCore::FVec3 ApexLocation;
+	DistanceMatchingCore::SolveJumpApex(DistanceMatchingCore::ToCore(Location), DistanceMatchingCore::ToCore(Velocity), GravityZ, MaxSimulationTime, ApexLocation, OutTime);
+	OutLocation = DistanceMatchingCore::ToVector(ApexLocation);
+}
+
+void DistanceMatchingStateMachine::SolveLandingLocation(const FVector& Location, const FVector& Velocity, const float GravityZ, const float GroundZ, const float MaxSimulationTime, FVector& OutLocation, float& OutTime)
+{
+	DistanceMatchingCore::FVec3 LandingLocation;
+	DistanceMatchingCore::SolveLandingLocation(DistanceMatchingCore::ToCore(Location), DistanceMatchingCore::ToCore(Velocity), GravityZ, GroundZ, MaxSimulationTime, LandingLocation, OutTime);
+	OutLocation = DistanceMatchingCore::ToVector(LandingLocation);
+}
+
+void DistanceMatchingStateMachine::UpdateGroundZ(const FDistanceMatchingMovement& Movement, const float DistanceToFloor, float& InOutGroundZ)
+{
+	if (!Movement.bIsFalling)
+	{
+		InOutGroundZ = Movement.Location.Z - DistanceToFloor;
+	}
+}
+
+void DistanceMatchingStateMachine::SolveLandingEstimate(const FVector& Location, const FVector& Velocity, const float GravityZ, const float GroundZ, const float DistanceToFloor, const float MaxSimulationTime, FVector& OutLocation, float& OutTime)
+{
+	SolveLandingLocation(Location, Velocity, GravityZ, GroundZ, MaxSimulationTime, OutLocation, OutTime);
+	OutLocation.Z += DistanceToFloor;
+}
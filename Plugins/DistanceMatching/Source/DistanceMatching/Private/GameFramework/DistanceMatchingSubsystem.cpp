@@ -0,0 +1,342 @@
+// Copyright Roman Merkushin. All Rights Reserved.
+
+#include "GameFramework/DistanceMatchingSubsystem.h"
+#include "GameFramework/DistanceMatchingComponent.h"
+#include "DistanceMatchingStats.h"
+#include "DistanceMatchingTimers.h"
+#include "Algo/StableSort.h"
+#include "Async/ParallelFor.h"
+#include "Components/CapsuleComponent.h"
+#include "GameFramework/Character.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "Components/SkeletalMeshComponent.h"
+
+namespace DistanceMatchingCVars
+{
+	static int32 BatchMinParallelNum = 32;
+	FAutoConsoleVariableRef CVarBatchMinParallelNum(
+		TEXT("c.DistanceMatching.BatchMinParallelNum"),
+		BatchMinParallelNum,
+		TEXT("Minimum number of batched DistanceMatching components to update them in parallel."),
+		ECVF_Default);
+
+	static int32 TraceBudgetMaxSweeps = 32;
+	FAutoConsoleVariableRef CVarTraceBudgetMaxSweeps(
+		TEXT("c.DistanceMatching.TraceBudget.MaxSweeps"),
+		TraceBudgetMaxSweeps,
+		TEXT("Maximum number of sweeps per frame for the scheduled DistanceMatching predictions, 0 for no limit."),
+		ECVF_Default);
+
+	static float TraceBudgetMaxMicroseconds = 500.0f;
+	FAutoConsoleVariableRef CVarTraceBudgetMaxMicroseconds(
+		TEXT("c.DistanceMatching.TraceBudget.MaxMicroseconds"),
+		TraceBudgetMaxMicroseconds,
+		TEXT("Maximum time per frame in microseconds for the scheduled DistanceMatching predictions, 0 for no limit."),
+		ECVF_Default);
+
+	static int32 TraceBudgetMaxDelayFrames = 4;
+	FAutoConsoleVariableRef CVarTraceBudgetMaxDelayFrames(
+		TEXT("c.DistanceMatching.TraceBudget.MaxDelayFrames"),
+		TraceBudgetMaxDelayFrames,
+		TEXT("Number of frames after which a scheduled DistanceMatching prediction runs regardless of the trace budget."),
+		ECVF_Default);
+}  // namespace DistanceMatchingCVars
+
+void FDistanceMatchingBatchTickFunction::ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent)
+{
+	if (Subsystem && TickType != LEVELTICK_ViewportsOnly)
+	{
+		Subsystem->Tick(DeltaTime);
+	}
+}
+
+FString FDistanceMatchingBatchTickFunction::DiagnosticMessage()
+{
+	return TEXT("FDistanceMatchingBatchTickFunction");
+}
+
+void UDistanceMatchingSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	// Same tick group as the components tick in by default
+	BatchTickFunction.Subsystem = this;
+	BatchTickFunction.bCanEverTick = true;
+	BatchTickFunction.bStartWithTickEnabled = true;
+	BatchTickFunction.TickGroup = TG_PrePhysics;
+	BatchTickFunction.RegisterTickFunction(InWorld.PersistentLevel);
+}
+
+void UDistanceMatchingSubsystem::Deinitialize()
+{
+	BatchTickFunction.UnRegisterTickFunction();
+	BatchTickFunction.Subsystem = nullptr;
+
+	for (UDistanceMatchingComponent* Component : Components)
+	{
+		if (Component)
+		{
+			Component->BatchIndex = INDEX_NONE;
+		}
+	}
+	Components.Empty();
+	DeferredComponents.Empty();
+
+	// Markers keep the estimates
+	for (const FScheduledPrediction& Scheduled : ScheduledPredictions)
+	{
+		if (UDistanceMatchingComponent* Component = Scheduled.Component.Get())
+		{
+			Component->ScheduledPrediction = EDistanceMatchingPrediction::None;
+		}
+	}
+	ScheduledPredictions.Empty();
+
+	Super::Deinitialize();
+}
+
+void UDistanceMatchingSubsystem::RegisterComponent(UDistanceMatchingComponent* Component)
+{
+	if (Component && Component->BatchIndex == INDEX_NONE)
+	{
+		Component->BatchIndex = Components.Add(Component);
+
+		// Movement -> batch -> animation, as the components order their own ticks
+		BatchTickFunction.AddPrerequisite(Component->MovementComponent, Component->MovementComponent->PrimaryComponentTick);
+		if (USkeletalMeshComponent* Mesh = Component->Character->GetMesh())
+		{
+			Mesh->PrimaryComponentTick.AddPrerequisite(this, BatchTickFunction);
+		}
+	}
+}
+
+void UDistanceMatchingSubsystem::RegisterComponentNextFrame(UDistanceMatchingComponent* Component)
+{
+	if (Component && Component->BatchIndex == INDEX_NONE)
+	{
+		DeferredComponents.AddUnique(Component);
+	}
+}
+
+void UDistanceMatchingSubsystem::UnregisterComponent(UDistanceMatchingComponent* Component)
+{
+	DeferredComponents.RemoveSingleSwap(Component, false);
+
+	if (!Component || !Components.IsValidIndex(Component->BatchIndex) || Components[Component->BatchIndex] != Component)
+	{
+		return;
+	}
+
+	BatchTickFunction.RemovePrerequisite(Component->MovementComponent, Component->MovementComponent->PrimaryComponentTick);
+	if (USkeletalMeshComponent* Mesh = Component->Character->GetMesh())
+	{
+		Mesh->PrimaryComponentTick.RemovePrerequisite(this, BatchTickFunction);
+	}
+
+	// Swap the last component into the freed slot to keep the arrays dense
+	const int32 Index = Component->BatchIndex;
+	Components.RemoveAtSwap(Index, 1, false);
+	if (Components.IsValidIndex(Index))
+	{
+		Components[Index]->BatchIndex = Index;
+	}
+
+	Component->BatchIndex = INDEX_NONE;
+}
+
+void UDistanceMatchingSubsystem::SchedulePrediction(UDistanceMatchingComponent* Component)
+{
+	FScheduledPrediction& Scheduled = ScheduledPredictions.AddDefaulted_GetRef();
+	Scheduled.Component = Component;
+	Scheduled.Frame = GFrameCounter;
+	Scheduled.ViewDistanceSquared = Component->GetClosestViewDistanceSquared();
+
+	if (Component->Character->IsLocallyControlled())
+	{
+		Scheduled.Priority = 0;
+	}
+	else if (Component->Character->WasRecentlyRendered())
+	{
+		Scheduled.Priority = 1;
+	}
+	else
+	{
+		Scheduled.Priority = 2;
+	}
+}
+
+void UDistanceMatchingSubsystem::RunScheduledPredictions()
+{
+	// Refinements and drift re-predictions traced since the last run already spent part of the budget
+	const int64 NumUnscheduledSweeps = NumChargedSweeps;
+	NumChargedSweeps = 0;
+
+	if (ScheduledPredictions.Num() == 0)
+	{
+		return;
+	}
+
+	DISTANCE_MATCHING_SCOPE_CYCLE_COUNTER(RunScheduledPredictions);
+
+	const uint64 MaxDelayFrames = FMath::Max(0, DistanceMatchingCVars::TraceBudgetMaxDelayFrames);
+	const uint64 FrameCounter = GFrameCounter;
+
+	// Overdue predictions first, then by priority, the oldest ones among equals
+	Algo::StableSort(ScheduledPredictions, [MaxDelayFrames, FrameCounter](const FScheduledPrediction& A, const FScheduledPrediction& B)
+	{
+		const bool bIsAOverdue = FrameCounter - A.Frame >= MaxDelayFrames;
+		const bool bIsBOverdue = FrameCounter - B.Frame >= MaxDelayFrames;
+		if (bIsAOverdue != bIsBOverdue)
+		{
+			return bIsAOverdue;
+		}
+		if (A.Priority != B.Priority)
+		{
+			return A.Priority < B.Priority;
+		}
+		return A.ViewDistanceSquared < B.ViewDistanceSquared;
+	});
+
+	const double StartTime = FPlatformTime::Seconds();
+	const int32 MaxSweeps = DistanceMatchingCVars::TraceBudgetMaxSweeps;
+	const double MaxSeconds = DistanceMatchingCVars::TraceBudgetMaxMicroseconds * 1e-6;
+	int64 NumSweeps = NumUnscheduledSweeps;
+	int32 NumRun = 0;
+
+	for (; NumRun < ScheduledPredictions.Num(); NumRun++)
+	{
+		const FScheduledPrediction& Scheduled = ScheduledPredictions[NumRun];
+
+		// At least one prediction runs every frame, so the queue always drains
+		const bool bIsOverdue = FrameCounter - Scheduled.Frame >= MaxDelayFrames;
+		const bool bIsOverBudget = (MaxSweeps > 0 && NumSweeps >= MaxSweeps) || (MaxSeconds > 0.0 && FPlatformTime::Seconds() - StartTime >= MaxSeconds);
+		if (NumRun > 0 && !bIsOverdue && bIsOverBudget)
+		{
+			break;
+		}
+
+		if (UDistanceMatchingComponent* Component = Scheduled.Component.Get())
+		{
+			const uint32 SweepCount = Component->SweepCount;
+			Component->RunScheduledPrediction();
+			NumSweeps += Component->SweepCount - SweepCount;
+		}
+	}
+
+	ScheduledPredictions.RemoveAt(0, NumRun, false);
+
+	DISTANCE_MATCHING_INC_COUNTER(DeferredPredictions, ScheduledPredictions.Num());
+}
+
+void UDistanceMatchingSubsystem::Tick(const float DeltaTime)
+{
+	DISTANCE_MATCHING_SCOPE_CYCLE_COUNTER_CSV(BatchTick);
+	DISTANCE_MATCHING_SCOPED_TIMER(BatchTick);
+
+	// Components woken up in this frame are already updated
+	for (int32 Index = DeferredComponents.Num() - 1; Index >= 0; Index--)
+	{
+		if (DeferredComponents[Index]->WakeUpFrame != GFrameCounter)
+		{
+			UDistanceMatchingComponent* Component = DeferredComponents[Index];
+			DeferredComponents.RemoveAtSwap(Index, 1, false);
+			RegisterComponent(Component);
+		}
+	}
+
+	const int32 NumComponents = Components.Num();
+	if (NumComponents == 0)
+	{
+		RunScheduledPredictions();
+		return;
+	}
+
+	Locations.SetNumUninitialized(NumComponents, false);
+	Velocities.SetNumUninitialized(NumComponents, false);
+	Accelerations.SetNumUninitialized(NumComponents, false);
+	CapsuleRadii.SetNumUninitialized(NumComponents, false);
+	CapsuleHalfHeights.SetNumUninitialized(NumComponents, false);
+	FloorDistances.SetNumUninitialized(NumComponents, false);
+	GravityZs.SetNumUninitialized(NumComponents, false);
+	FallingFlags.SetNumUninitialized(NumComponents, false);
+	Predictions.SetNumUninitialized(NumComponents, false);
+
+	// Gather the movement state, character and its components are only safe to read on the game thread
+	for (int32 Index = 0; Index < NumComponents; Index++)
+	{
+		UDistanceMatchingComponent* Component = Components[Index];
+		Component->UpdateFidelityFromView();
+
+		const UCharacterMovementComponent* MovementComponent = Component->MovementComponent;
+		const UCapsuleComponent* CapsuleComponent = Component->CapsuleComponent;
+
+		Locations[Index] = Component->Character->GetActorLocation();
+		Velocities[Index] = Component->Character->GetVelocity();
+		Accelerations[Index] = MovementComponent->GetCurrentAcceleration();
+		CapsuleRadii[Index] = CapsuleComponent->GetScaledCapsuleRadius();
+		CapsuleHalfHeights[Index] = CapsuleComponent->GetScaledCapsuleHalfHeight();
+		FloorDistances[Index] = MovementComponent->CurrentFloor.FloorDist;
+		GravityZs[Index] = MovementComponent->GetGravityZ();
+		FallingFlags[Index] = MovementComponent->IsFalling();
+	}
+
+	const EParallelForFlags ParallelForFlags = NumComponents < DistanceMatchingCVars::BatchMinParallelNum ? EParallelForFlags::ForceSingleThread : EParallelForFlags::None;
+
+	// State machine only touches the component own state
+	ParallelFor(
+		NumComponents, [this](const int32 Index)
+		{
+			UDistanceMatchingComponent* Component = Components[Index];
+			Component->ApplyMovementState(Locations[Index], Velocities[Index], Accelerations[Index], CapsuleRadii[Index], CapsuleHalfHeights[Index], FloorDistances[Index], GravityZs[Index], FallingFlags[Index]);
+			Predictions[Index] = Component->UsesReplicatedMarkers() ? EDistanceMatchingPrediction::None : Component->UpdateDistanceMatchingType();
+		},
+		ParallelForFlags);
+
+	// Predictions trace the world, run them only for components which changed the state or wait for async traces
+	for (int32 Index = 0; Index < NumComponents; Index++)
+	{
+		if (Components[Index]->PendingPredictions.Num() > 0)
+		{
+			Components[Index]->ResolvePendingPredictions();
+		}
+
+		Components[Index]->UpdateJumpTrajectory(Predictions[Index], DeltaTime);
+
+		if (Predictions[Index] != EDistanceMatchingPrediction::None)
+		{
+			Components[Index]->RunPrediction(Predictions[Index], DeltaTime);
+		}
+
+		Components[Index]->RefineMarkers(Predictions[Index], DeltaTime);
+
+		Components[Index]->SendReplicatedMarkers(Predictions[Index]);
+
+#if ENABLE_DRAW_DEBUG
+		Components[Index]->DrawDebug(Predictions[Index]);
+#endif
+	}
+
+	// Predictions scheduled in this frame see the movement state they were scheduled with
+	RunScheduledPredictions();
+
+	ParallelFor(
+		NumComponents, [this, DeltaTime](const int32 Index)
+		{
+			Components[Index]->UpdateMarkers(DeltaTime);
+		},
+		ParallelForFlags);
+
+	// Idle components leave the batch, backwards as the last component is swapped into the freed slot
+	for (int32 Index = NumComponents - 1; Index >= 0; Index--)
+	{
+		if (Components[Index]->ShouldSleep())
+		{
+			Components[Index]->Sleep();
+		}
+	}
+}
+
+bool UDistanceMatchingSubsystem::DoesSupportWorldType(EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
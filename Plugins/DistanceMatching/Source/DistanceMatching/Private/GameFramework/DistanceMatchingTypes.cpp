@@ -0,0 +1,56 @@
+// Copyright Roman Merkushin. All Rights Reserved.
+
+#include "GameFramework/DistanceMatchingTypes.h"
+
+namespace DistanceMatchingReplication
+{
+	/** Serialize the time in milliseconds, markers are never further than a few seconds away. */
+	static void SerializeTime(FArchive& Ar, float& Time)
+	{
+		uint16 Milliseconds = Ar.IsSaving() ? static_cast<uint16>(FMath::Clamp(FMath::RoundToInt(Time * 1000.0f), 0, static_cast<int32>(MAX_uint16))) : 0;
+		Ar << Milliseconds;
+		Time = Milliseconds / 1000.0f;
+	}
+}  // namespace DistanceMatchingReplication
+
+int32 FDistanceMatchingReplicatedMarkers::GetNumMarkers(const EDistanceMatchingType Type)
+{
+	switch (Type)
+	{
+		case EDistanceMatchingType::Start:
+		case EDistanceMatchingType::Stop:
+		case EDistanceMatchingType::Pivot:
+			return 1;
+		case EDistanceMatchingType::Jump:
+		case EDistanceMatchingType::Fall:
+			return 2;
+		default:
+			return 0;
+	}
+}
+
+bool FDistanceMatchingReplicatedMarkers::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+{
+	uint8 Type = static_cast<uint8>(DistanceMatchingType);
+	Ar.SerializeBits(&Type, 3);
+	DistanceMatchingType = static_cast<EDistanceMatchingType>(Type);
+
+	Ar << TransitionCount;
+
+	bOutSuccess = true;
+
+	const int32 NumMarkers = GetNumMarkers(DistanceMatchingType);
+	if (NumMarkers > 0)
+	{
+		bOutSuccess &= SerializePackedVector<10, 24>(FirstLocation, Ar);
+		DistanceMatchingReplication::SerializeTime(Ar, FirstTime);
+	}
+
+	if (NumMarkers > 1)
+	{
+		bOutSuccess &= SerializePackedVector<10, 24>(SecondLocation, Ar);
+		DistanceMatchingReplication::SerializeTime(Ar, SecondTime);
+	}
+
+	return true;
+}
@@ -4,9 +4,27 @@
 
 #include "CoreMinimal.h"
 #include "Animation/AnimNode_AssetPlayerBase.h"
+#include "Animation/AttributesRuntime.h"
+#include "BonePose.h"
+#include "Animation/DistanceCurveCache.h"
+#include "Animation/BakedDistanceCurve.h"
+#include "GameFramework/DistanceMatchingTypes.h"
 #include "AnimNode_DistanceMatching.generated.h"
 
-struct FAnimCurveBufferAccess;
+class UDistanceMatchingComponent;
+
+/** Distance matching node which plays its sequence as normal, because the distance curve can't be accessed. */
+struct FDistanceMatchingDegradedNode
+{
+	/** Anim instance which owns the node. */
+	TWeakObjectPtr<UObject> AnimInstance;
+
+	/** Sequence without an accessible distance curve. */
+	TWeakObjectPtr<UAnimSequenceBase> Sequence;
+
+	/** Name of the distance curve. */
+	FName CurveName;
+};
 
 USTRUCT(BlueprintInternalUseOnly)
 struct DISTANCEMATCHING_API FAnimNode_DistanceMatching : public FAnimNode_AssetPlayerBase
@@ -22,17 +40,44 @@ struct DISTANCEMATCHING_API FAnimNode_DistanceMatching : public FAnimNode_AssetP
 	// End of FAnimNode_AssetPlayerBase interface
 
 	// FAnimNode_Base interface
+	virtual bool NeedsOnInitializeAnimInstance() const override { return bUseComponentMarker; }
+	virtual void OnInitializeAnimInstance(const FAnimInstanceProxy* InProxy, const UAnimInstance* InAnimInstance) override;
 	virtual void Initialize_AnyThread(const FAnimationInitializeContext& Context) override;
 	virtual void Evaluate_AnyThread(FPoseContext& Output) override;
 	virtual void OverrideAsset(UAnimationAsset* NewAsset) override;
 	virtual void UpdateAssetPlayer(const FAnimationUpdateContext& Context) override;
 	// End of FAnimNode_Base interface
 
+	/** Returns the share of curve searches which found the segment at the previous one, in [0, 1]. */
+	float GetSearchHintHitRatio() const { return SearchHint.NumSearches > 0 ? static_cast<float>(SearchHint.NumHits) / SearchHint.NumSearches : 0.0f; }
+
+	/** Returns true if the distance curve can't be accessed and the sequence is played as normal. */
+	bool IsDegraded() const { return bIsDegraded; }
+
+	/** Returns all nodes of alive anim instances which fell back to playback. Thread safe. */
+	static void GetDegradedNodes(TArray<FDistanceMatchingDegradedNode>& OutNodes);
+
 private:
-	TSharedPtr<FAnimCurveBufferAccess> CurveBuffer;
-	int32 CurveBufferNumSamples;
+	FDistanceCurvePtr Curve;
+	FDistanceCurveSearchHint SearchHint;
 	TObjectPtr<UAnimSequenceBase> PrevSequence;
+	FName PrevDistanceCurveName;
 	uint8 bIsEnabled : 1;
+	uint8 bIsDegraded : 1;
+
+	/** Component of the owning actor to read the marker from, see bUseComponentMarker. */
+	TWeakObjectPtr<UDistanceMatchingComponent> MarkerComponent;
+
+	// Last evaluated pose and what it was evaluated for, see bCachePose
+	FCompactHeapPose CachedPose;
+	FBlendedHeapCurve CachedCurve;
+	UE::Anim::FHeapAttributeContainer CachedAttributes;
+	TObjectPtr<UAnimSequenceBase> CachedSequence;
+	float CachedTime;
+	float PrevEvaluatedTime;
+	uint16 CachedBoneContainerSerial;
+	uint8 bCachedRootMotion : 1;
+	uint8 bIsPoseCached : 1;
 
 public:
 	/** The animation sequence asset to play. */
@@ -47,6 +92,17 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Settings", meta = (PinHiddenByDefault))
 	FName DistanceCurveName;
 
+	/**
+	 * Read the distance from the marker of the DistanceMatching component of the owning actor instead of the Distance pin.
+	 * The marker is read from the thread safe snapshot, so the graph doesn't need to copy it on the game thread.
+	 */
+	UPROPERTY(EditAnywhere, Category = "Settings", meta = (NeverAsPin))
+	uint8 bUseComponentMarker : 1;
+
+	/** Marker to read the distance from. See bUseComponentMarker. */
+	UPROPERTY(EditAnywhere, Category = "Settings", meta = (NeverAsPin, EditCondition = "bUseComponentMarker"))
+	EDistanceMatchingMarker Marker;
+
 	/** Continue play animation as normal when distance limit is exceeded. */
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Settings", meta = (PinHiddenByDefault))
 	uint8 bEnableDistanceLimit : 1;
@@ -55,13 +111,28 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Settings", meta = (PinHiddenByDefault, EditCondition = "bEnableDistanceLimit"))
 	float DistanceLimit;
 
+	/**
+	 * Keep a copy of the last evaluated pose and return it while the time, sequence and required bones stay the same, e.g. when the stop animation holds its last frame.
+	 * The copy is taken only once the time holds still, at the time of the previous evaluation or at either end of the sequence.
+	 * Trades the memory of a pose for skipping the decompression.
+	 */
+	UPROPERTY(EditAnywhere, Category = "Performance", meta = (NeverAsPin))
+	uint8 bCachePose : 1;
+
+	/** Distance curve of the sequence baked at compile time. Used instead of reading the curve at runtime while the sequence matches. */
+	UPROPERTY()
+	FBakedDistanceCurve BakedCurve;
+
 private:
-	/** Update curve buffer from sequence by curve name. */
-	void UpdateCurveBuffer();
+	/** Update the shared distance curve from sequence by curve name. Switches the node to playback if the curve can't be accessed. */
+	void UpdateCurve(const FAnimationBaseContext& Context);
 
 	/** Returns the time of a named curve for corresponding distance value. */
-	float GetCurveTime() const;
+	float GetCurveTime();
 
 	/** Play animation sequence. */
 	void PlaySequence(const FAnimationUpdateContext& Context);
+
+	/** Returns true if the cached pose was evaluated for the same time, sequence and required bones. */
+	bool IsPoseCacheValid(const FPoseContext& Output, const bool bExtractRootMotion) const;
 };
@@ -0,0 +1,65 @@
+// Copyright Roman Merkushin. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BakedDistanceCurve.generated.h"
+
+class UAnimSequenceBase;
+struct FDistanceCurve;
+
+/**
+ * Distance curve baked at Anim Blueprint compile time.
+ * Times and values are quantized to 16 bits over their ranges, so the curve doesn't depend on the sequence curve codec.
+ */
+USTRUCT()
+struct DISTANCEMATCHING_API FBakedDistanceCurve
+{
+	GENERATED_BODY()
+
+	/** The sequence the curve was baked from. */
+	UPROPERTY()
+	TObjectPtr<UAnimSequenceBase> Sequence;
+
+	/** The name of the baked curve. */
+	UPROPERTY()
+	FName CurveName;
+
+	UPROPERTY()
+	float MinTime;
+
+	UPROPERTY()
+	float TimeRange;
+
+	UPROPERTY()
+	float MinValue;
+
+	UPROPERTY()
+	float ValueRange;
+
+	UPROPERTY()
+	TArray<uint16> QuantizedTimes;
+
+	UPROPERTY()
+	TArray<uint16> QuantizedValues;
+
+	FBakedDistanceCurve();
+
+	/** Returns true if the curve was baked for the sequence and curve name. */
+	bool IsBakedFor(const UAnimSequenceBase* InSequence, const FName InCurveName) const;
+
+	/**
+	* Quantize the curve keys.
+	*
+	* @param InSequence		The sequence the keys belong to.
+	* @param InCurveName	The name of the curve.
+	* @param Times			Key times in seconds.
+	* @param Values			Key values, one per time.
+	*/
+	void Bake(UAnimSequenceBase* InSequence, const FName InCurveName, const TArray<float>& Times, const TArray<float>& Values);
+
+	/** Restores the keys into the distance curve. */
+	void Decompress(FDistanceCurve& OutCurve) const;
+
+	void Reset();
+};
@@ -0,0 +1,132 @@
+// Copyright Roman Merkushin. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/CriticalSection.h"
+#include "UObject/ObjectKey.h"
+#include "Core/DistanceMatchingCoreCurve.h"
+
+class UAnimSequenceBase;
+struct FBakedDistanceCurve;
+
+using FDistanceCurveSearchHint = DistanceMatchingCore::FCurveSearchHint;
+
+/** Plain copy of the distance curve keys extracted from an animation sequence. */
+struct DISTANCEMATCHING_API FDistanceCurve
+{
+	/** Sample times in seconds. */
+	TArray<float> Times;
+
+	/** Sample values (distances), one per time. */
+	TArray<float> Values;
+
+	/** Times sampled at a uniform distance step. Empty when the curve isn't monotonic or the table would exceed its size limit. */
+	TArray<float> InverseTable;
+
+	/** Distance of the first inverse table entry. */
+	float InverseTableMinDistance = 0.0f;
+
+	/** Reciprocal of the inverse table distance step. */
+	float InverseTableStepInv = 0.0f;
+
+	/** True if the values never decrease, so the search result doesn't depend on where the search starts. */
+	bool bIsSorted = false;
+
+	int32 GetNumSamples() const { return Times.Num(); }
+
+	bool HasInverseTable() const { return InverseTable.Num() > 0; }
+
+	/**
+	* Build the data used to speed up the lookups: the sorted flag and the distance to time table.
+	*
+	* @param Tolerance		Maximum allowed time error (in seconds) of the table compared to the search.
+	* @param MaxSize		Maximum number of table entries.
+	*/
+	void BuildLookupData(const float Tolerance, const int32 MaxSize);
+
+	/** Returns the time for corresponding distance value. Uses the inverse table when available, otherwise falls back to search. */
+	float GetTime(const float Distance) const;
+
+	/** Same as above, but the search (if needed) starts from the segment found by the previous one. */
+	float GetTime(const float Distance, FDistanceCurveSearchHint& Hint) const;
+
+	/** Returns the time for corresponding distance value by lower bound search over the curve keys. */
+	float FindTimeBySearch(const float Distance) const;
+
+	/** Returns the time for corresponding distance value by galloping search around the hint. Matches FindTimeBySearch exactly, the curve must be sorted. */
+	float FindTimeBySearch(const float Distance, FDistanceCurveSearchHint& Hint) const;
+
+	/** Returns the memory allocated by this curve. */
+	SIZE_T GetAllocatedSize() const;
+
+	/** Returns the curve arrays for the engine independent lookups in DistanceMatchingCore. */
+	DistanceMatchingCore::FCurveView GetView() const;
+};
+
+using FDistanceCurvePtr = TSharedPtr<const FDistanceCurve, ESPMode::ThreadSafe>;
+
+/**
+ * Thread-safe cache of distance curves shared by all distance matching nodes.
+ * Curves are keyed by sequence and curve name, so each pair is extracted only once no matter how many nodes play it.
+ */
+class DISTANCEMATCHING_API FDistanceCurveCache
+{
+public:
+	static FDistanceCurveCache& Get();
+
+	/**
+	 * Returns the shared curve for the sequence, extracting it on the first request. Returns nullptr if the curve can't be accessed.
+	 * A failed extraction is remembered, so it is reported once and not retried until the sequence is invalidated.
+	 */
+	FDistanceCurvePtr FindOrAdd(const UAnimSequenceBase* Sequence, const FName CurveName);
+
+	/** Returns the shared curve restored from data baked at compile time. Doesn't touch the sequence curve codec. */
+	FDistanceCurvePtr FindOrAdd(const FBakedDistanceCurve& BakedCurve);
+
+	/** Removes all cached curves and failed extractions of the sequence, e.g. when its curve data has been modified. */
+	void Invalidate(const UAnimSequenceBase* Sequence);
+
+	/** Removes cached curves whose sequences have been garbage collected. */
+	void RemoveStaleEntries();
+
+	/** Removes all cached curves. Nodes which still reference a curve keep it alive until they release it. */
+	void Empty();
+
+	/** Returns the number of cached curves. */
+	int32 Num() const;
+
+	/** Returns the number of curves which failed to extract. */
+	int32 NumFailed() const;
+
+	/** Returns the memory allocated by the cache and all cached curves. */
+	SIZE_T GetAllocatedSize() const;
+
+private:
+	struct FKey
+	{
+		FObjectKey Sequence;
+		FName CurveName;
+
+		/** Baked curves are quantized, they never stand in for the keys extracted from the sequence and the other way around. */
+		bool bBaked = false;
+
+		bool operator==(const FKey& Other) const { return Sequence == Other.Sequence && CurveName == Other.CurveName && bBaked == Other.bBaked; }
+		friend uint32 GetTypeHash(const FKey& Key) { return HashCombine(HashCombine(GetTypeHash(Key.Sequence), GetTypeHash(Key.CurveName)), GetTypeHash(Key.bBaked)); }
+	};
+
+	/** Returns the cached curve for the key, building it on a miss. */
+	FDistanceCurvePtr FindOrAdd(const FKey& Key, TFunctionRef<FDistanceCurvePtr()> Build);
+
+	/** Extracts the curve keys from the sequence. */
+	static FDistanceCurvePtr BuildCurve(const UAnimSequenceBase* Sequence, const FName CurveName);
+
+	/** Restores the curve keys from baked data. */
+	static FDistanceCurvePtr BuildCurve(const FBakedDistanceCurve& BakedCurve);
+
+	mutable FRWLock Lock;
+	TMap<FKey, FDistanceCurvePtr> Curves;
+
+	/** Curves which can't be extracted from their sequences. */
+	TSet<FKey> FailedCurves;
+};
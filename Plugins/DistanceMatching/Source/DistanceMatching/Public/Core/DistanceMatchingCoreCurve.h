@@ -0,0 +1,349 @@
+// Copyright Roman Merkushin. All Rights Reserved.
+
+#pragma once
+
+#include "Core/DistanceMatchingCoreMath.h"
+
+namespace DistanceMatchingCore
+{
+	/** Segment found by the previous search. Distance changes smoothly between updates, so the next search starts from there. */
+	struct FCurveSearchHint
+	{
+		/** Second key of the segment found by the previous search. */
+		int32_t Segment = -1;
+
+		/** Number of searches which used the hint. */
+		uint32_t NumSearches = 0;
+
+		/** Number of searches which found the segment at the hint. */
+		uint32_t NumHits = 0;
+
+		void Reset() { *this = FCurveSearchHint(); }
+	};
+
+	/** Distance curve keys and lookup data in plain arrays, owned by the caller. */
+	struct FCurveView
+	{
+		/** Sample times in seconds. */
+		const float* Times = nullptr;
+
+		/** Sample values (distances), one per time. */
+		const float* Values = nullptr;
+
+		int32_t NumSamples = 0;
+
+		/** Times sampled at a uniform distance step, may be empty. */
+		const float* InverseTable = nullptr;
+
+		int32_t InverseTableNum = 0;
+
+		/** Distance of the first inverse table entry. */
+		float InverseTableMinDistance = 0.0f;
+
+		/** Reciprocal of the inverse table distance step. */
+		float InverseTableStepInv = 0.0f;
+
+		/** True if the values never decrease. */
+		bool bIsSorted = false;
+
+		bool HasInverseTable() const { return InverseTableNum > 0; }
+	};
+
+	/** Returns true if the values never decrease, so the search result doesn't depend on where the search starts. */
+	inline bool IsSorted(const float* Values, const int32_t NumSamples)
+	{
+		for (int32_t Index = 1; Index < NumSamples; Index++)
+		{
+			if (Values[Index] < Values[Index - 1])
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/** Returns the time from the inverse table for corresponding distance value. */
+	inline float SampleInverseTable(const FCurveView& Curve, const float Distance)
+	{
+		const float Position = (Distance - Curve.InverseTableMinDistance) * Curve.InverseTableStepInv;
+		const int32_t Index = Clamp(static_cast<int32_t>(Position), 0, Curve.InverseTableNum - 2);
+
+		return Lerp(Curve.InverseTable[Index], Curve.InverseTable[Index + 1], Position - Index);
+	}
+
+	/**
+	* Build the distance to time table of a sorted curve.
+	*
+	* @param Curve				Curve keys, the inverse table fields are ignored.
+	* @param Tolerance			Maximum allowed time error (in seconds) of the table compared to the search.
+	* @param MaxSize			Maximum number of table entries.
+	* @param Allocate			Callable taking the number of entries and returning the table storage for them. May be called several times, only the last storage holds the table.
+	* @param OutNum				Number of table entries, zero if the curve can't have a table.
+	* @param OutMinDistance		Distance of the first table entry.
+	* @param OutStepInv			Reciprocal of the table distance step.
+	*/
+	template <typename AllocateType>
+	void BuildInverseTable(const FCurveView& Curve, const float Tolerance, const int32_t MaxSize, AllocateType&& Allocate, int32_t& OutNum, float& OutMinDistance, float& OutStepInv)
+	{
+		const float* Times = Curve.Times;
+		const float* Values = Curve.Values;
+		const int32_t NumSamples = Curve.NumSamples;
+
+		OutNum = 0;
+
+		if (NumSamples < 2 || Tolerance <= 0.0f || !Curve.bIsSorted)
+		{
+			return;
+		}
+
+		// Repeated values at the ends don't break the monotonicity, the search resolves them to the last leading and the first trailing key
+		int32_t First = 0;
+		while (First + 1 < NumSamples && Values[First + 1] == Values[0])
+		{
+			First++;
+		}
+
+		int32_t Last = NumSamples - 1;
+		while (Last - 1 > First && Values[Last - 1] == Values[NumSamples - 1])
+		{
+			Last--;
+		}
+
+		if (First >= Last)
+		{
+			return;
+		}
+
+		for (int32_t Index = First; Index < Last; Index++)
+		{
+			if (Values[Index + 1] <= Values[Index])
+			{
+				// Not strictly monotonic, inverse doesn't exist
+				return;
+			}
+		}
+
+		const float MinDistance = Values[First];
+		const float Range = Values[Last] - MinDistance;
+
+		// Start from the key count and double the resolution until the error is within tolerance
+		for (int32_t NumCells = Last - First; NumCells + 1 <= MaxSize; NumCells *= 2)
+		{
+			const float Step = Range / NumCells;
+			float* Table = Allocate(NumCells + 1);
+
+			int32_t Segment = First;
+			for (int32_t Cell = 0; Cell <= NumCells; Cell++)
+			{
+				const float CellDistance = Cell == NumCells ? Values[Last] : MinDistance + Cell * Step;
+				while (Segment + 1 < Last && Values[Segment + 1] <= CellDistance)
+				{
+					Segment++;
+				}
+
+				const float Alpha = (CellDistance - Values[Segment]) / (Values[Segment + 1] - Values[Segment]);
+				Table[Cell] = Lerp(Times[Segment], Times[Segment + 1], Alpha);
+			}
+
+			FCurveView TableView;
+			TableView.InverseTable = Table;
+			TableView.InverseTableNum = NumCells + 1;
+			TableView.InverseTableMinDistance = MinDistance;
+			TableView.InverseTableStepInv = 1.0f / Step;
+
+			// Both the table and the curve are piecewise linear, so the largest error is at one of the keys
+			bool bWithinTolerance = true;
+			for (int32_t Index = First; Index <= Last && bWithinTolerance; Index++)
+			{
+				bWithinTolerance = std::abs(SampleInverseTable(TableView, Values[Index]) - Times[Index]) <= Tolerance;
+			}
+
+			if (bWithinTolerance)
+			{
+				OutNum = TableView.InverseTableNum;
+				OutMinDistance = TableView.InverseTableMinDistance;
+				OutStepInv = TableView.InverseTableStepInv;
+				return;
+			}
+		}
+	}
+
+	/**
+	* Returns the first key in (Low, High] with value greater than distance, where High is the last key or its value is greater.
+	* Adds the number of compared keys to InOutNumProbes.
+	*/
+	inline int32_t LowerBound(const FCurveView& Curve, const float Distance, const int32_t Low, const int32_t High, int32_t& InOutNumProbes)
+	{
+		int32_t First = Low + 1;
+		int32_t Count = High - First;
+
+		while (Count > 0)
+		{
+			InOutNumProbes++;
+
+			const int32_t Step = Count / 2;
+			const int32_t Middle = First + Step;
+
+			if (Distance >= Curve.Values[Middle])
+			{
+				First = Middle + 1;
+				Count -= Step + 1;
+			}
+			else
+			{
+				Count = Step;
+			}
+		}
+
+		return First;
+	}
+
+	/** Returns the time between the keys Second - 1 and Second for corresponding distance value. */
+	inline float InterpolateSegment(const FCurveView& Curve, const int32_t Second, const float Distance)
+	{
+		const float Diff = Curve.Values[Second] - Curve.Values[Second - 1];
+
+		if (Diff > 0.0f)
+		{
+			const float Alpha = (Distance - Curve.Values[Second - 1]) / Diff;
+			const float P0 = Curve.Times[Second - 1];
+			const float P3 = Curve.Times[Second];
+
+			// Find time by two nearest known points on the curve
+			return Lerp(P0, P3, Alpha);
+		}
+
+		return Curve.Times[Second - 1];
+	}
+
+	/** Returns the time for corresponding distance value by lower bound search over the curve keys. */
+	inline float FindTimeBySearch(const FCurveView& Curve, const float Distance, int32_t& InOutNumProbes)
+	{
+		const int32_t NumSamples = Curve.NumSamples;
+
+		if (NumSamples == 0)
+		{
+			// If no keys in curve, return 0
+			return 0.0f;
+		}
+
+		if (NumSamples < 2)
+		{
+			return Curve.Times[0];
+		}
+
+		if (Distance < Curve.Values[NumSamples - 1])
+		{
+			// Perform a lower bound to get the second of the interpolation nodes
+			return InterpolateSegment(Curve, LowerBound(Curve, Distance, 0, NumSamples - 1, InOutNumProbes), Distance);
+		}
+
+		return Curve.Times[NumSamples - 1];
+	}
+
+	/** Returns the time for corresponding distance value by galloping search around the hint. Matches the search above exactly, the curve must be sorted. */
+	inline float FindTimeBySearch(const FCurveView& Curve, const float Distance, FCurveSearchHint& Hint, int32_t& InOutNumProbes)
+	{
+		const float* Values = Curve.Values;
+		const int32_t NumSamples = Curve.NumSamples;
+
+		if (NumSamples < 2 || Distance >= Values[NumSamples - 1])
+		{
+			return FindTimeBySearch(Curve, Distance, InOutNumProbes);
+		}
+
+		const int32_t Last = NumSamples - 1;
+		const int32_t Hinted = Clamp(Hint.Segment, 1, Last);
+		int32_t Segment;
+		// Keys around the hinted segment are always compared
+		InOutNumProbes += 2;
+
+		// Values are sorted, so the segment is the one whose previous key is not greater and whose own key is greater than distance
+		const bool bPreviousNotGreater = Hinted == 1 || Distance >= Values[Hinted - 1];
+		const bool bCurrentGreater = Hinted == Last || Distance < Values[Hinted];
+
+		if (bPreviousNotGreater && bCurrentGreater)
+		{
+			Segment = Hinted;
+			Hint.NumHits++;
+		}
+		else if (bPreviousNotGreater)
+		{
+			// Gallop forward with doubling steps until a greater key brackets the segment
+			int32_t Low = Hinted;
+			int32_t Step = 1;
+			int32_t High = Min(Low + Step, Last);
+			while (High < Last && Distance >= Values[High])
+			{
+				InOutNumProbes++;
+				Low = High;
+				Step *= 2;
+				High = Min(Low + Step, Last);
+			}
+
+			Segment = LowerBound(Curve, Distance, Low, High, InOutNumProbes);
+		}
+		else
+		{
+			// Gallop backward until a not greater key brackets the segment
+			int32_t High = Hinted - 1;
+			int32_t Step = 1;
+			int32_t Low = Max(High - Step, 0);
+			while (Low > 0 && Distance < Values[Low])
+			{
+				InOutNumProbes++;
+				High = Low;
+				Step *= 2;
+				Low = Max(High - Step, 0);
+			}
+
+			Segment = LowerBound(Curve, Distance, Low, High, InOutNumProbes);
+		}
+
+		Hint.Segment = Segment;
+		Hint.NumSearches++;
+
+		return InterpolateSegment(Curve, Segment, Distance);
+	}
+
+	/** Returns the time for corresponding distance value. Uses the inverse table when available, otherwise falls back to search. */
+	inline float GetTime(const FCurveView& Curve, const float Distance, int32_t& InOutNumProbes)
+	{
+		const int32_t NumSamples = Curve.NumSamples;
+
+		if (NumSamples == 0)
+		{
+			// If no keys in curve, return 0
+			return 0.0f;
+		}
+
+		if (NumSamples < 2)
+		{
+			return Curve.Times[0];
+		}
+
+		if (Distance >= Curve.Values[NumSamples - 1])
+		{
+			return Curve.Times[NumSamples - 1];
+		}
+
+		if (Curve.HasInverseTable())
+		{
+			// Below the table range the search ends up on the first segment anyway
+			return Distance >= Curve.InverseTableMinDistance ? SampleInverseTable(Curve, Distance) : InterpolateSegment(Curve, 1, Distance);
+		}
+
+		return FindTimeBySearch(Curve, Distance, InOutNumProbes);
+	}
+
+	/** Same as above, but the search (if needed) starts from the segment found by the previous one. */
+	inline float GetTime(const FCurveView& Curve, const float Distance, FCurveSearchHint& Hint, int32_t& InOutNumProbes)
+	{
+		if (Curve.HasInverseTable() || !Curve.bIsSorted)
+		{
+			return GetTime(Curve, Distance, InOutNumProbes);
+		}
+
+		return FindTimeBySearch(Curve, Distance, Hint, InOutNumProbes);
+	}
+}  // namespace DistanceMatchingCore
@@ -0,0 +1,86 @@
+// Copyright Roman Merkushin. All Rights Reserved.
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+/**
+ * Engine independent core of the distance matching predictions and curve lookups.
+ * Headers under Core/ include the standard library only, so the math builds and runs outside of the engine,
+ * e.g. in the standalone benchmark in Extras/CoreBenchmark. The engine classes convert their types and forward here.
+ */
+namespace DistanceMatchingCore
+{
+	/** Tolerance used where the engine code compares against KINDA_SMALL_NUMBER. */
+	constexpr float KindaSmallNumber = 1.e-4f;
+
+	/** Squared size below which a vector has no direction, same as SMALL_NUMBER in the engine. */
+	constexpr double SmallNumber = 1.e-8;
+
+	/** Location, velocity or acceleration. Double precision to match large world coordinates of the engine. */
+	struct FVec3
+	{
+		double X = 0.0;
+		double Y = 0.0;
+		double Z = 0.0;
+
+		constexpr FVec3() = default;
+		constexpr FVec3(const double InX, const double InY, const double InZ) : X(InX), Y(InY), Z(InZ) {}
+
+		FVec3 operator+(const FVec3& Other) const { return FVec3(X + Other.X, Y + Other.Y, Z + Other.Z); }
+		FVec3 operator-(const FVec3& Other) const { return FVec3(X - Other.X, Y - Other.Y, Z - Other.Z); }
+		FVec3 operator-() const { return FVec3(-X, -Y, -Z); }
+		FVec3 operator*(const double Scale) const { return FVec3(X * Scale, Y * Scale, Z * Scale); }
+		FVec3& operator+=(const FVec3& Other) { X += Other.X; Y += Other.Y; Z += Other.Z; return *this; }
+
+		double SizeSquared() const { return X * X + Y * Y + Z * Z; }
+		double Size() const { return std::sqrt(SizeSquared()); }
+		bool IsZero() const { return X == 0.0 && Y == 0.0 && Z == 0.0; }
+
+		/** Returns the unit vector, or zero if the vector is too short to have a direction. */
+		FVec3 GetSafeNormal() const
+		{
+			const double SquaredSize = SizeSquared();
+			if (SquaredSize == 1.0)
+			{
+				return *this;
+			}
+			return SquaredSize < SmallNumber ? FVec3() : *this * (1.0 / std::sqrt(SquaredSize));
+		}
+	};
+
+	inline FVec3 operator*(const double Scale, const FVec3& Vector) { return Vector * Scale; }
+
+	inline double Dot(const FVec3& A, const FVec3& B) { return A.X * B.X + A.Y * B.Y + A.Z * B.Z; }
+
+	template <typename T>
+	inline T Lerp(const T& A, const T& B, const float Alpha) { return A + Alpha * (B - A); }
+
+	template <typename T>
+	inline T Min(const T A, const T B) { return A < B ? A : B; }
+
+	template <typename T>
+	inline T Max(const T A, const T B) { return A > B ? A : B; }
+
+	template <typename T>
+	inline T Clamp(const T Value, const T MinValue, const T MaxValue) { return Value < MinValue ? MinValue : Value < MaxValue ? Value : MaxValue; }
+
+	/** Collision queried along the predicted paths. The engine sweeps the character capsule, the benchmark uses analytic shapes. */
+	class ICollisionQuery
+	{
+	public:
+		virtual ~ICollisionQuery() = default;
+
+		/**
+		* Sweep the shape from start to end.
+		*
+		* @param Start			Start of the sweep.
+		* @param End			End of the sweep.
+		* @param OutLocation	Location of the shape at the first blocking hit.
+		* @param OutFraction	Fraction of the sweep (0 to 1) at the first blocking hit.
+		* @return				True if the sweep is blocked.
+		*/
+		virtual bool Sweep(const FVec3& Start, const FVec3& End, FVec3& OutLocation, float& OutFraction) = 0;
+	};
+}  // namespace DistanceMatchingCore
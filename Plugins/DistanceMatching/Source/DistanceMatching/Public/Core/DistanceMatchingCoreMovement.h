@@ -0,0 +1,657 @@
+// Copyright Roman Merkushin. All Rights Reserved.
+
+#pragma once
+
+#include "Core/DistanceMatchingCoreMath.h"
+
+namespace DistanceMatchingCore
+{
+	/** Braking settings of the movement, taken from the character movement component or the crowd agent config. */
+	struct FBrakingParams
+	{
+		/** Braking friction (ground friction multiplied by the braking friction factor). */
+		float Friction = 0.0f;
+
+		/** Constant deceleration applied while braking. */
+		float BrakingDeceleration = 0.0f;
+
+		/** Speed below which the braking movement stops. */
+		float BrakeToStopVelocity = 0.0f;
+	};
+
+	/** Returns the largest distance between the arc of a ballistic sub-step and its chord, |G| * T^2 / 8. */
+	inline float GetChordError(const float GravityZ, const float StepTime)
+	{
+		return 0.125f * std::abs(GravityZ) * StepTime * StepTime;
+	}
+
+	/** How a jump path is split into the sub-steps swept one by one. */
+	struct FJumpPathStepping
+	{
+		/** Sub-steps per second with fixed steps. */
+		float SimulationFrequency = 10.0f;
+
+		/** Largest distance in world units between a sub-step and the arc, enables the adaptive steps when positive. */
+		float Tolerance = 0.0f;
+
+		/** The sub-step which hits is swept again in halves until it's within this distance of the arc, 0 for no refinement. */
+		float HitTolerance = 0.0f;
+
+		/**
+		* Returns the time of one sub-step. Adaptive steps are the longest ones within the tolerance, evenly split over the simulation time.
+		* Gravity alone bends the path, so the error of a sub-step depends on its time only and the whole path is split evenly.
+		*
+		* @param GravityZ			Gravity acceleration, negative when pointing down.
+		* @param SimulationTime		Simulation time of the path.
+		*/
+		float GetStepTime(const float GravityZ, const float SimulationTime) const
+		{
+			if (Tolerance <= 0.0f)
+			{
+				return 1.0f / SimulationFrequency;
+			}
+
+			// |G| * T^2 / 8 <= Tolerance, a straight path without gravity is swept at once
+			const float Gravity = std::abs(GravityZ);
+			if (Gravity <= KindaSmallNumber || SimulationTime <= 0.0f)
+			{
+				return Max(SimulationTime, KindaSmallNumber);
+			}
+
+			const float MaxStepTime = std::sqrt(8.0f * Tolerance / Gravity);
+			return SimulationTime / std::ceil(SimulationTime / MaxStepTime);
+		}
+	};
+
+	/**
+	* Sweep the sub-step which hit again in halves until its chord is within the tolerance of the arc, so the hit near geometry follows the arc.
+	* The half with the first hit is kept. If neither half hits, the arc passes the geometry and the hit of the whole sub-step stays.
+	*
+	* @param Start			Start of the sub-step.
+	* @param End			End of the sub-step.
+	* @param StartTime		Time at the start of the sub-step.
+	* @param EndTime		Time at the end of the sub-step.
+	* @param GravityZ		Gravity acceleration, negative when pointing down.
+	* @param HitTolerance	Largest distance between the sub-step which hits and the arc.
+	* @param Query			Collision to sweep against.
+	* @param InOutLocation	Location of the hit.
+	* @param InOutTime		Time of the hit relative to the path start.
+	*/
+	inline void RefineSweepHit(const FVec3& Start, const FVec3& End, const float StartTime, const float EndTime, const float GravityZ, const float HitTolerance, ICollisionQuery& Query, FVec3& InOutLocation, float& InOutTime)
+	{
+		FVec3 StepStart = Start;
+		FVec3 StepEnd = End;
+		float StepStartTime = StartTime;
+		float StepEndTime = EndTime;
+
+		while (HitTolerance > 0.0f && GetChordError(GravityZ, StepEndTime - StepStartTime) > HitTolerance)
+		{
+			// P(t + T / 2) = (P(t) + P(t + T)) / 2 - G * T^2 / 8
+			const float HalfStepTime = 0.5f * (StepEndTime - StepStartTime);
+			const float MidTime = StepStartTime + HalfStepTime;
+			const FVec3 Mid = (StepStart + StepEnd) * 0.5 + FVec3(0.0, 0.0, -0.5f * GravityZ * HalfStepTime * HalfStepTime);
+
+			FVec3 HitLocation;
+			float HitFraction;
+			if (Query.Sweep(StepStart, Mid, HitLocation, HitFraction))
+			{
+				StepEnd = Mid;
+				StepEndTime = MidTime;
+			}
+			else if (Query.Sweep(Mid, StepEnd, HitLocation, HitFraction))
+			{
+				StepStart = Mid;
+				StepStartTime = MidTime;
+			}
+			else
+			{
+				return;
+			}
+
+			InOutLocation = HitLocation;
+			InOutTime = Lerp(StepStartTime, StepEndTime, HitFraction);
+		}
+	}
+
+	/** Sub-steps of a jump path. Sweep N goes from Points[N] to Points[N + 1] and starts at Times[N]. */
+	struct FJumpPath
+	{
+		/** Points beyond the capacity are dropped, the path then ends early. 5 seconds at 30 Hz need 151. */
+		static constexpr int32_t MaxPoints = 256;
+
+		FVec3 Points[MaxPoints];
+		float Times[MaxPoints];
+		int32_t NumPoints = 0;
+
+		/** Gravity of the path, the arc between two points follows from it. */
+		float GravityZ = 0.0f;
+
+		/** The sub-step which hits is swept again in halves until it's within this distance of the arc, 0 for no refinement. */
+		float HitTolerance = 0.0f;
+
+		void Reset() { NumPoints = 0; }
+
+		bool IsFull() const { return NumPoints == MaxPoints; }
+
+		void Add(const FVec3& Point, const float Time)
+		{
+			Points[NumPoints] = Point;
+			Times[NumPoints] = Time;
+			NumPoints++;
+		}
+
+		const FVec3& Last() const { return Points[NumPoints - 1]; }
+	};
+
+	/** Path of a body moving under gravity alone. */
+	struct FBallisticPath
+	{
+		FVec3 StartLocation;
+		FVec3 StartVelocity;
+		float GravityZ = 0.0f;
+
+		/** Returns the location on the unobstructed path at the time since the start. */
+		FVec3 GetLocation(const float Time) const
+		{
+			// P(t) = P0 + V0 * t + G * t^2 / 2
+			return StartLocation + StartVelocity * Time + FVec3(0.0, 0.0, 0.5f * GravityZ * Time * Time);
+		}
+	};
+
+	/** Ballistic path of a jump from the take-off to the landing, with the apex and landing solved once at the take-off. */
+	struct FJumpTrajectory : public FBallisticPath
+	{
+		/** Apex location, or where the rise is blocked. */
+		FVec3 ApexLocation;
+
+		/** Time from the start to the apex. */
+		float ApexTime = 0.0f;
+
+		/** Where the path is blocked after the apex, or the end of the simulation without a hit. */
+		FVec3 LandingLocation;
+
+		/** Time from the start to the landing. */
+		float LandingTime = 0.0f;
+
+		/** The path hits something before the apex, the movement after it is unknown and the landing isn't solved. */
+		bool bIsApexBlocked = false;
+	};
+
+	/** Sweeps along a ballistic path a few sub-steps at a time, so a long path can be swept over several frames. */
+	struct FJumpPathSweep : public FBallisticPath
+	{
+		/** Duration of each sub-step. */
+		float StepTime = 0.0f;
+
+		/** Time the sweep ends at without a hit. */
+		float EndTime = 0.0f;
+
+		/** Start time of the next sub-step to sweep. */
+		float NextTime = 0.0f;
+
+		/** The sub-step which hits is swept again in halves until it's within this distance of the arc, 0 for no refinement. */
+		float HitTolerance = 0.0f;
+
+		/**
+		* Start sweeping a new path.
+		*
+		* @param InStartLocation		Location the path starts from.
+		* @param InStartVelocity		Velocity at the start of the path.
+		* @param InGravityZ				Gravity acceleration, negative when pointing down.
+		* @param SimulationTime			Simulation time of the path.
+		* @param Stepping				Determines size of each sub-step in the simulation.
+		*/
+		void Start(const FVec3& InStartLocation, const FVec3& InStartVelocity, const float InGravityZ, const float SimulationTime, const FJumpPathStepping& Stepping)
+		{
+			StartLocation = InStartLocation;
+			StartVelocity = InStartVelocity;
+			GravityZ = InGravityZ;
+			StepTime = Stepping.GetStepTime(InGravityZ, SimulationTime);
+			EndTime = SimulationTime;
+			NextTime = 0.0f;
+			HitTolerance = Stepping.HitTolerance;
+		}
+
+		/** Stop sweeping, the path is kept. */
+		void Finish() { NextTime = EndTime; }
+
+		bool IsDone() const { return NextTime >= EndTime; }
+
+		/** Skip the sub-steps before the time, e.g. the part of the path already passed. */
+		void SkipTo(const float Time) { NextTime = Max(NextTime, Min(Time, EndTime)); }
+
+		/** End the sweep at the time if it's earlier, e.g. at a hit already found against other collision. */
+		void StopAt(const float Time) { EndTime = Max(NextTime, Min(Time, EndTime)); }
+
+		/**
+		* Take the next sub-step without sweeping it, for sweeps requested by the caller, e.g. async traces.
+		*
+		* @param OutStart		Start of the sub-step.
+		* @param OutEnd			End of the sub-step.
+		* @param OutStartTime	Time at the start of the sub-step.
+		* @param OutEndTime		Time at the end of the sub-step.
+		* @return				False if the sweep is done.
+		*/
+		bool NextStep(FVec3& OutStart, FVec3& OutEnd, float& OutStartTime, float& OutEndTime)
+		{
+			if (IsDone())
+			{
+				return false;
+			}
+
+			// Don't leave a sliver of a sub-step at the end
+			OutStartTime = NextTime;
+			OutEndTime = EndTime - NextTime <= StepTime + KindaSmallNumber ? EndTime : NextTime + StepTime;
+			OutStart = GetLocation(OutStartTime);
+			OutEnd = GetLocation(OutEndTime);
+			NextTime = OutEndTime;
+
+			return true;
+		}
+
+		/**
+		* Continue with the sub-step which hit, split into the longest steps within the hit tolerance. Used by callers which can't
+		* sweep the halves one after another right away, e.g. async traces. The first hit of the shorter steps replaces the hit of the sub-step.
+		*
+		* @param StepStartTime		Time at the start of the sub-step which hit.
+		* @param StepEndTime		Time at the end of the sub-step which hit.
+		* @return					False if the sub-step is within the hit tolerance already, the sweep is done then.
+		*/
+		bool RefineStep(const float StepStartTime, const float StepEndTime)
+		{
+			const float Gravity = std::abs(GravityZ);
+			if (HitTolerance <= 0.0f || GetChordError(GravityZ, StepEndTime - StepStartTime) <= HitTolerance)
+			{
+				Finish();
+				return false;
+			}
+
+			const float MaxStepTime = std::sqrt(8.0f * HitTolerance / Gravity);
+			StepTime = (StepEndTime - StepStartTime) / std::ceil((StepEndTime - StepStartTime) / MaxStepTime);
+			NextTime = StepStartTime;
+			EndTime = StepEndTime;
+			HitTolerance = 0.0f;
+
+			return true;
+		}
+
+		/**
+		* Sweep the next sub-steps until the first blocking hit.
+		*
+		* @param Query			Collision to sweep against.
+		* @param MaxSteps		Maximum number of sub-steps to sweep.
+		* @param OutLocation	Location of the hit.
+		* @param OutTime		Time of the hit relative to the path start.
+		* @return				True if the path is blocked, the sweep is done then.
+		*/
+		bool Advance(ICollisionQuery& Query, const int32_t MaxSteps, FVec3& OutLocation, float& OutTime)
+		{
+			FVec3 StepStart;
+			FVec3 StepEnd;
+			float StepStartTime;
+			float StepEndTime;
+
+			for (int32_t Step = 0; Step < MaxSteps && NextStep(StepStart, StepEnd, StepStartTime, StepEndTime); Step++)
+			{
+				float HitFraction;
+				if (Query.Sweep(StepStart, StepEnd, OutLocation, HitFraction))
+				{
+					OutTime = Lerp(StepStartTime, StepEndTime, HitFraction);
+					RefineSweepHit(StepStart, StepEnd, StepStartTime, StepEndTime, GravityZ, HitTolerance, Query, OutLocation, OutTime);
+					Finish();
+					return true;
+				}
+			}
+
+			return false;
+		}
+	};
+
+	/**
+	* Solve the braking motion in closed form: exact for braking without acceleration, continuous approximation for pivot.
+	*
+	* @param Location				Current location.
+	* @param Velocity				Current velocity.
+	* @param Acceleration			Current acceleration, zero for stop.
+	* @param Braking				Braking settings of the movement.
+	* @param MaxSimulationTime		Maximum time of the prediction.
+	* @param OutLocation			Location where the movement stops (or turns for pivot).
+	* @param OutTime				Time to stop, limited by MaxSimulationTime.
+	*/
+	inline void SolveStopLocation(const FVec3& Location, const FVec3& Velocity, const FVec3& Acceleration, const FBrakingParams& Braking, const float MaxSimulationTime, FVec3& OutLocation, float& OutTime)
+	{
+		const float Friction = Braking.Friction;
+		const float BrakingDeceleration = Braking.BrakingDeceleration;
+		const bool bZeroFriction = Friction == 0.0f;
+		const bool bZeroBraking = BrakingDeceleration == 0.0f;
+
+		OutLocation = Location;
+		OutTime = 0.0f;
+
+		if (Acceleration.IsZero())
+		{
+			// dV/dt = -Friction * V - BrakingDeceleration, until the speed drops below the stop threshold
+			const float Speed = static_cast<float>(Velocity.Size());
+			const float StopSpeed = bZeroBraking ? std::sqrt(KindaSmallNumber) : Braking.BrakeToStopVelocity;
+
+			if (Speed <= StopSpeed || (bZeroFriction && bZeroBraking))
+			{
+				return;
+			}
+
+			float StopDistance;
+			if (bZeroFriction)
+			{
+				OutTime = Min((Speed - StopSpeed) / BrakingDeceleration, MaxSimulationTime);
+				StopDistance = Speed * OutTime - 0.5f * BrakingDeceleration * OutTime * OutTime;
+			}
+			else
+			{
+				// V(t) = (V0 + B / F) * e^(-F * t) - B / F
+				const float BrakingSpeed = BrakingDeceleration / Friction;
+				OutTime = Min(std::log((Speed + BrakingSpeed) / (StopSpeed + BrakingSpeed)) / Friction, MaxSimulationTime);
+				StopDistance = (Speed + BrakingSpeed) * (1.0f - std::exp(-Friction * OutTime)) / Friction - BrakingSpeed * OutTime;
+			}
+
+			OutLocation += Velocity.GetSafeNormal() * StopDistance;
+			return;
+		}
+
+		// Pivot: speed along the acceleration is negative and changes by dU/dt = -2 * Friction * U + A until it turns to zero
+		const FVec3 AccelerationDirection = Acceleration.GetSafeNormal();
+		const float AccelerationSize = static_cast<float>(Acceleration.Size());
+		const float Speed = static_cast<float>(Dot(Velocity, AccelerationDirection));
+		float PivotDistance;
+
+		if (Speed >= 0.0f || bZeroFriction)
+		{
+			// Friction doesn't affect velocity aligned with acceleration
+			OutTime = Speed < 0.0f ? Min(-Speed / AccelerationSize, MaxSimulationTime) : MaxSimulationTime;
+			PivotDistance = Speed * OutTime + 0.5f * AccelerationSize * OutTime * OutTime;
+		}
+		else
+		{
+			// U(t) = (U0 - A / 2F) * e^(-2F * t) + A / 2F
+			const float DoubleFriction = 2.0f * Friction;
+			const float TerminalSpeed = AccelerationSize / DoubleFriction;
+			OutTime = Min(std::log(1.0f - Speed / TerminalSpeed) / DoubleFriction, MaxSimulationTime);
+			PivotDistance = TerminalSpeed * OutTime + (Speed - TerminalSpeed) * (1.0f - std::exp(-DoubleFriction * OutTime)) / DoubleFriction;
+		}
+
+		OutLocation += AccelerationDirection * PivotDistance;
+	}
+
+	/**
+	* Integrate the braking motion in steps of TimeStep, the same way the character movement component does.
+	*
+	* @param Location				Current location.
+	* @param Velocity				Current velocity.
+	* @param Acceleration			Current acceleration, zero for stop.
+	* @param Braking				Braking settings of the movement.
+	* @param MaxSimulationTime		Maximum time of the prediction.
+	* @param TimeStep				Integration step, usually the time since the last tick.
+	* @param OutLocation			Location where the movement stops (or turns for pivot).
+	* @param OutTime				Time to stop, limited by MaxSimulationTime.
+	*/
+	inline void SimulateStopLocation(const FVec3& Location, const FVec3& Velocity, const FVec3& Acceleration, const FBrakingParams& Braking, const float MaxSimulationTime, const float TimeStep, FVec3& OutLocation, float& OutTime)
+	{
+		const float Friction = Braking.Friction;
+		const float BrakingDeceleration = Braking.BrakingDeceleration;
+		const bool bZeroFriction = Friction == 0.0f;
+		const bool bZeroBraking = BrakingDeceleration == 0.0f;
+		const bool bZeroAcceleration = Acceleration.IsZero();
+		const FVec3 AccelerationDirection = Acceleration.GetSafeNormal();
+
+		FVec3 PredictedVelocity = bZeroAcceleration ? Velocity : AccelerationDirection * Dot(Velocity, AccelerationDirection);
+		OutLocation = Location;
+		OutTime = 0.0f;
+
+		if (TimeStep <= 0.0f)
+		{
+			return;
+		}
+
+		while (MaxSimulationTime > OutTime)
+		{
+			const FVec3 PreviousVelocity = PredictedVelocity;
+			const float SimulationTimeStep = Min(MaxSimulationTime - OutTime, TimeStep);
+
+			// Apply velocity braking
+			if (bZeroAcceleration)
+			{
+				if (PredictedVelocity.IsZero() || (bZeroFriction && bZeroBraking))
+				{
+					break;
+				}
+
+				// Decelerate to brake to a stop
+				const FVec3 ReverseAcceleration = bZeroBraking ? FVec3() : PredictedVelocity.GetSafeNormal() * -BrakingDeceleration;
+
+				// Apply friction and braking
+				PredictedVelocity = PredictedVelocity + (PredictedVelocity * -Friction + ReverseAcceleration) * SimulationTimeStep;
+
+				// Clamp to zero if nearly zero, or if below min threshold and braking
+				const double VelocitySizeSquared = PredictedVelocity.SizeSquared();
+				if (VelocitySizeSquared <= KindaSmallNumber || (!bZeroBraking && VelocitySizeSquared <= Braking.BrakeToStopVelocity * Braking.BrakeToStopVelocity))
+				{
+					break;
+				}
+			}
+			else
+			{
+				// Friction affects our ability to change direction. This is only done for input acceleration, not path following.
+				const double Speed = PredictedVelocity.Size();
+				PredictedVelocity = PredictedVelocity - (PredictedVelocity - AccelerationDirection * Speed) * Min(SimulationTimeStep * Friction, 1.0f);
+
+				// Apply additional requested acceleration
+				PredictedVelocity += Acceleration * SimulationTimeStep;
+			}
+
+			// Don't reverse direction
+			if (Dot(PredictedVelocity, PreviousVelocity) <= 0.0)
+			{
+				break;
+			}
+
+			OutLocation += PredictedVelocity * SimulationTimeStep;
+			OutTime += SimulationTimeStep;
+		}
+	}
+
+	/**
+	* Solve the apex of the ballistic jump path.
+	*
+	* @param Location				Take-off location.
+	* @param Velocity				Take-off velocity.
+	* @param GravityZ				Gravity acceleration, negative when pointing down.
+	* @param MaxSimulationTime		Time to the apex without gravity.
+	* @param OutLocation			Apex location.
+	* @param OutTime				Time to the apex.
+	*/
+	inline void SolveJumpApex(const FVec3& Location, const FVec3& Velocity, const float GravityZ, const float MaxSimulationTime, FVec3& OutLocation, float& OutTime)
+	{
+		// Velocity * Sin jump angle / Gravity, no apex without gravity so simulate the whole time then
+		const float Gravity = std::abs(GravityZ);
+		OutTime = Gravity > KindaSmallNumber ? Max(0.0f, static_cast<float>(Velocity.Z)) / Gravity : MaxSimulationTime;
+
+		// P(t) = P0 + V0 * t + G * t^2 / 2
+		OutLocation = Location + Velocity * OutTime + FVec3(0.0, 0.0, 0.5f * GravityZ * OutTime * OutTime);
+	}
+
+	/**
+	* Solve where the ballistic path comes down to the ground height, for movement without collision queries.
+	*
+	* @param Location				Current location.
+	* @param Velocity				Current velocity.
+	* @param GravityZ				Gravity acceleration, negative when pointing down.
+	* @param GroundZ				Height of the ground to land on.
+	* @param MaxSimulationTime		Maximum time of the prediction.
+	* @param OutLocation			Landing location.
+	* @param OutTime				Time to the landing, limited by MaxSimulationTime.
+	*/
+	inline void SolveLandingLocation(const FVec3& Location, const FVec3& Velocity, const float GravityZ, const double GroundZ, const float MaxSimulationTime, FVec3& OutLocation, float& OutTime)
+	{
+		// Later root of Z0 + Vz * t + G * t^2 / 2 = GroundZ, without a root the path never comes down to the ground
+		const float Height = static_cast<float>(Location.Z - GroundZ);
+		const float VelocityZ = static_cast<float>(Velocity.Z);
+		const float Discriminant = VelocityZ * VelocityZ + 2.0f * -GravityZ * Height;
+
+		if (GravityZ < -KindaSmallNumber && Discriminant >= 0.0f)
+		{
+			OutTime = Clamp((VelocityZ + std::sqrt(Discriminant)) / -GravityZ, 0.0f, MaxSimulationTime);
+		}
+		else
+		{
+			OutTime = MaxSimulationTime;
+		}
+
+		OutLocation = Location + Velocity * OutTime + FVec3(0.0, 0.0, 0.5f * GravityZ * OutTime * OutTime);
+	}
+
+	/**
+	* Integrate the arc of a jump path affected by gravity.
+	*
+	* @param StartLocation			Location the path starts from.
+	* @param StartVelocity			Velocity at the start of the path.
+	* @param GravityZ				Gravity acceleration, negative when pointing down.
+	* @param SimulationTime			Simulation time of the path.
+	* @param Stepping				Determines size of each sub-step in the simulation (chopping up SimulationTime).
+	* @param OutPath				Sub-step points of the path.
+	*/
+	inline void BuildJumpPath(const FVec3& StartLocation, const FVec3& StartVelocity, const float GravityZ, const float SimulationTime, const FJumpPathStepping& Stepping, FJumpPath& OutPath)
+	{
+		const float SubstepDeltaTime = Stepping.GetStepTime(GravityZ, SimulationTime);
+
+		FVec3 CurrentVelocity = StartVelocity;
+		FVec3 CurrentLocation = StartLocation;
+		float CurrentTime = 0.0f;
+
+		OutPath.Reset();
+		OutPath.GravityZ = GravityZ;
+		OutPath.HitTolerance = Stepping.HitTolerance;
+		OutPath.Add(CurrentLocation, CurrentTime);
+
+		while (CurrentTime < SimulationTime && !OutPath.IsFull())
+		{
+			// Limit step to not go further than total time, and don't leave a sliver of a step at the end
+			const float ActualStepDeltaTime = SimulationTime - CurrentTime <= SubstepDeltaTime + KindaSmallNumber ? SimulationTime - CurrentTime : SubstepDeltaTime;
+			CurrentTime += ActualStepDeltaTime;
+
+			// Integrate (Velocity Verlet method)
+			const FVec3 PreviousVelocity = CurrentVelocity;
+			CurrentVelocity = PreviousVelocity + FVec3(0.0, 0.0, GravityZ * ActualStepDeltaTime);
+			CurrentLocation += (PreviousVelocity + CurrentVelocity) * (0.5f * ActualStepDeltaTime);
+
+			OutPath.Add(CurrentLocation, CurrentTime);
+		}
+	}
+
+	/**
+	* Sweep along the jump path sub-steps until the first blocking hit.
+	*
+	* @param Path			Sub-step points of the path.
+	* @param Query			Collision to sweep against.
+	* @param OutLocation	Location of the hit.
+	* @param OutTime		Time of the hit relative to the path start.
+	* @param StartTime		Sub-steps which end before this time are skipped.
+	* @return				True if the path is blocked. The sub-step which hits is refined by the hit tolerance of the path.
+	*/
+	inline bool SweepJumpPath(const FJumpPath& Path, ICollisionQuery& Query, FVec3& OutLocation, float& OutTime, const float StartTime = 0.0f)
+	{
+		for (int32_t StepIndex = 0; StepIndex < Path.NumPoints - 1; StepIndex++)
+		{
+			if (Path.Times[StepIndex + 1] <= StartTime)
+			{
+				continue;
+			}
+
+			float HitFraction;
+			if (Query.Sweep(Path.Points[StepIndex], Path.Points[StepIndex + 1], OutLocation, HitFraction))
+			{
+				OutTime = Lerp(Path.Times[StepIndex], Path.Times[StepIndex + 1], HitFraction);
+				RefineSweepHit(Path.Points[StepIndex], Path.Points[StepIndex + 1], Path.Times[StepIndex], Path.Times[StepIndex + 1], Path.GravityZ, Path.HitTolerance, Query, OutLocation, OutTime);
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	/**
+	* Solve the apex and sweep the jump path once for both the apex and the landing.
+	* One vertical sweep up to the apex height checks for a ceiling. Without one, only the sub-steps after the apex are swept for the landing.
+	*
+	* @param StartLocation			Location the path starts from.
+	* @param StartVelocity			Velocity at the start of the path.
+	* @param GravityZ				Gravity acceleration, negative when pointing down.
+	* @param MaxSimulationTime		Maximum simulation time after the apex.
+	* @param RiseStepping			Determines size of each sub-step of the rise, swept only when something is above the take-off location.
+	* @param FallStepping			Determines size of each sub-step of the fall to the landing.
+	* @param Query					Collision to sweep against.
+	* @param OutTrajectory			Solved trajectory.
+	*/
+	inline void BuildJumpTrajectory(const FVec3& StartLocation, const FVec3& StartVelocity, const float GravityZ, const float MaxSimulationTime, const FJumpPathStepping& RiseStepping, const FJumpPathStepping& FallStepping, ICollisionQuery& Query, FJumpTrajectory& OutTrajectory)
+	{
+		OutTrajectory.StartLocation = StartLocation;
+		OutTrajectory.StartVelocity = StartVelocity;
+		OutTrajectory.GravityZ = GravityZ;
+		OutTrajectory.bIsApexBlocked = false;
+
+		SolveJumpApex(StartLocation, StartVelocity, GravityZ, MaxSimulationTime, OutTrajectory.ApexLocation, OutTrajectory.ApexTime);
+
+		FJumpPath Path;
+		FVec3 HitLocation;
+		float HitFraction;
+
+		if (OutTrajectory.ApexTime > 0.0f && Query.Sweep(StartLocation, FVec3(StartLocation.X, StartLocation.Y, OutTrajectory.ApexLocation.Z), HitLocation, HitFraction))
+		{
+			// Something is above the take-off location, follow the rise to find where the jump is blocked
+			BuildJumpPath(StartLocation, StartVelocity, GravityZ, OutTrajectory.ApexTime, RiseStepping, Path);
+
+			float HitTime;
+			if (SweepJumpPath(Path, Query, HitLocation, HitTime))
+			{
+				OutTrajectory.ApexLocation = HitLocation;
+				OutTrajectory.ApexTime = HitTime;
+				OutTrajectory.bIsApexBlocked = true;
+				return;
+			}
+		}
+
+		const float SimulationTime = OutTrajectory.ApexTime + MaxSimulationTime;
+		BuildJumpPath(StartLocation, StartVelocity, GravityZ, SimulationTime, FallStepping, Path);
+
+		if (!SweepJumpPath(Path, Query, OutTrajectory.LandingLocation, OutTrajectory.LandingTime, OutTrajectory.ApexTime))
+		{
+			OutTrajectory.LandingLocation = Path.Last();
+			OutTrajectory.LandingTime = Path.Times[Path.NumPoints - 1];
+		}
+	}
+
+	/**
+	* Move the predicted location onto the floor below or above it.
+	*
+	* @param Location			Predicted location.
+	* @param TraceHalfHeight	Half height of the vertical sweep around the location.
+	* @param Query				Collision to sweep against.
+	* @param OffsetZ			Offset added to the Z of the hit location.
+	* @param OutLocation		Location on the floor.
+	* @return					True if the floor was found.
+	*/
+	inline bool ProjectToFloor(const FVec3& Location, const float TraceHalfHeight, ICollisionQuery& Query, const float OffsetZ, FVec3& OutLocation)
+	{
+		const FVec3 TraceStart(Location.X, Location.Y, Location.Z + TraceHalfHeight);
+		const FVec3 TraceEnd(Location.X, Location.Y, Location.Z - TraceHalfHeight);
+
+		float HitFraction;
+		FVec3 HitLocation;
+		if (Query.Sweep(TraceStart, TraceEnd, HitLocation, HitFraction))
+		{
+			OutLocation = FVec3(HitLocation.X, HitLocation.Y, HitLocation.Z + OffsetZ);
+			return true;
+		}
+
+		OutLocation = Location;
+		return false;
+	}
+}  // namespace DistanceMatchingCore
@@ -0,0 +1,56 @@
+// Copyright Roman Merkushin. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+
+DECLARE_STATS_GROUP(TEXT("DistanceMatching"), STATGROUP_DistanceMatching, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Tick Component"), STAT_DistanceMatching_TickComponent, STATGROUP_DistanceMatching, DISTANCEMATCHING_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Batch Tick"), STAT_DistanceMatching_BatchTick, STATGROUP_DistanceMatching, DISTANCEMATCHING_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Resolve Pending Predictions"), STAT_DistanceMatching_ResolvePendingPredictions, STATGROUP_DistanceMatching, DISTANCEMATCHING_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Predict Stop Location"), STAT_DistanceMatching_PredictStopLocation, STATGROUP_DistanceMatching, DISTANCEMATCHING_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Predict Jump Apex"), STAT_DistanceMatching_PredictJumpApex, STATGROUP_DistanceMatching, DISTANCEMATCHING_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Predict Landing Location"), STAT_DistanceMatching_PredictLandingLocation, STATGROUP_DistanceMatching, DISTANCEMATCHING_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Predict Jump Trajectory"), STAT_DistanceMatching_PredictJumpTrajectory, STATGROUP_DistanceMatching, DISTANCEMATCHING_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Refine Markers"), STAT_DistanceMatching_RefineMarkers, STATGROUP_DistanceMatching, DISTANCEMATCHING_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Run Scheduled Predictions"), STAT_DistanceMatching_RunScheduledPredictions, STATGROUP_DistanceMatching, DISTANCEMATCHING_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Update Asset Player"), STAT_DistanceMatching_UpdateAssetPlayer, STATGROUP_DistanceMatching, DISTANCEMATCHING_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Get Curve Time"), STAT_DistanceMatching_GetCurveTime, STATGROUP_DistanceMatching, DISTANCEMATCHING_API);
+
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Predictions"), STAT_DistanceMatching_Predictions, STATGROUP_DistanceMatching, DISTANCEMATCHING_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Marker Refinements"), STAT_DistanceMatching_MarkerRefinements, STATGROUP_DistanceMatching, DISTANCEMATCHING_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Deferred Predictions"), STAT_DistanceMatching_DeferredPredictions, STATGROUP_DistanceMatching, DISTANCEMATCHING_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Capsule Sweeps"), STAT_DistanceMatching_Sweeps, STATGROUP_DistanceMatching, DISTANCEMATCHING_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Curve Search Probes"), STAT_DistanceMatching_CurveSearchProbes, STATGROUP_DistanceMatching, DISTANCEMATCHING_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Pose Cache Hits"), STAT_DistanceMatching_PoseCacheHits, STATGROUP_DistanceMatching, DISTANCEMATCHING_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Components (None)"), STAT_DistanceMatching_ComponentsNone, STATGROUP_DistanceMatching, DISTANCEMATCHING_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Components (Start)"), STAT_DistanceMatching_ComponentsStart, STATGROUP_DistanceMatching, DISTANCEMATCHING_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Components (Stop)"), STAT_DistanceMatching_ComponentsStop, STATGROUP_DistanceMatching, DISTANCEMATCHING_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Components (Pivot)"), STAT_DistanceMatching_ComponentsPivot, STATGROUP_DistanceMatching, DISTANCEMATCHING_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Components (Jump)"), STAT_DistanceMatching_ComponentsJump, STATGROUP_DistanceMatching, DISTANCEMATCHING_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Components (Fall)"), STAT_DistanceMatching_ComponentsFall, STATGROUP_DistanceMatching, DISTANCEMATCHING_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Components (Sleeping)"), STAT_DistanceMatching_ComponentsSleeping, STATGROUP_DistanceMatching, DISTANCEMATCHING_API);
+
+CSV_DECLARE_CATEGORY_MODULE_EXTERN(DISTANCEMATCHING_API, DistanceMatching);
+
+/** Cycle stat and Insights scope. Name is the stat name without the STAT_DistanceMatching_ prefix. */
+#define DISTANCE_MATCHING_SCOPE_CYCLE_COUNTER(Name) \
+	SCOPE_CYCLE_COUNTER(STAT_DistanceMatching_##Name); \
+	TRACE_CPUPROFILER_EVENT_SCOPE(DistanceMatching_##Name)
+
+/** Cycle stat, Insights scope and CSV profiler timing, for the coarse scopes only. */
+#define DISTANCE_MATCHING_SCOPE_CYCLE_COUNTER_CSV(Name) \
+	DISTANCE_MATCHING_SCOPE_CYCLE_COUNTER(Name); \
+	CSV_SCOPED_TIMING_STAT(DistanceMatching, Name)
+
+/** Per frame counter in the stats and the CSV profiler. */
+#define DISTANCE_MATCHING_INC_COUNTER(Name, Amount) \
+	do \
+	{ \
+		INC_DWORD_STAT_BY(STAT_DistanceMatching_##Name, Amount); \
+		CSV_CUSTOM_STAT(DistanceMatching, Name, static_cast<int32>(Amount), ECsvCustomStatOp::Accumulate); \
+	} while (0)
@@ -0,0 +1,73 @@
+// Copyright Roman Merkushin. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include <atomic>
+
+#ifndef DISTANCE_MATCHING_TIMERS
+#define DISTANCE_MATCHING_TIMERS !UE_BUILD_SHIPPING
+#endif
+
+/** Distance matching scopes timed for benchmarks. */
+enum class EDistanceMatchingTimer : uint8
+{
+	TickComponent,
+	BatchTick,
+	Prediction,
+	UpdateAssetPlayer,
+	Num,
+};
+
+/**
+ * Cycles accumulated in the distance matching scopes since the last reset.
+ * Disabled by default, then a scope costs a branch only. Scopes run on worker threads too, so the counters are atomic.
+ */
+struct DISTANCEMATCHING_API FDistanceMatchingTimers
+{
+	static void SetEnabled(const bool bInEnabled) { bEnabled = bInEnabled; }
+
+	static bool IsEnabled() { return bEnabled; }
+
+	static void Add(const EDistanceMatchingTimer Timer, const uint64 InCycles);
+
+	/** Returns the time accumulated in the scope since the last reset, in milliseconds. */
+	static double GetMilliseconds(const EDistanceMatchingTimer Timer);
+
+	static void Reset();
+
+	static const TCHAR* GetName(const EDistanceMatchingTimer Timer);
+
+private:
+	static bool bEnabled;
+	static std::atomic<uint64> Cycles[static_cast<uint8>(EDistanceMatchingTimer::Num)];
+};
+
+/** Adds the cycles spent in the scope to the timer. */
+class FDistanceMatchingScopedTimer
+{
+public:
+	explicit FDistanceMatchingScopedTimer(const EDistanceMatchingTimer InTimer)
+		: Timer(InTimer)
+		, StartCycles(FDistanceMatchingTimers::IsEnabled() ? FPlatformTime::Cycles64() : 0)
+	{
+	}
+
+	~FDistanceMatchingScopedTimer()
+	{
+		if (StartCycles != 0)
+		{
+			FDistanceMatchingTimers::Add(Timer, FPlatformTime::Cycles64() - StartCycles);
+		}
+	}
+
+private:
+	EDistanceMatchingTimer Timer;
+	uint64 StartCycles;
+};
+
+#if DISTANCE_MATCHING_TIMERS
+#define DISTANCE_MATCHING_SCOPED_TIMER(Timer) FDistanceMatchingScopedTimer PREPROCESSOR_JOIN(DistanceMatchingScopedTimer, __LINE__)(EDistanceMatchingTimer::Timer)
+#else
+#define DISTANCE_MATCHING_SCOPED_TIMER(Timer)
+#endif
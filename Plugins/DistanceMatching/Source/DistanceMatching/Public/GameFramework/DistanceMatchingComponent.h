@@ -3,16 +3,17 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "WorldCollision.h"
 #include "GameFramework/DistanceMatchingTypes.h"
+#include "GameFramework/DistanceMatchingStateMachine.h"
+#include "Core/DistanceMatchingCoreMovement.h"
+#include <atomic>
 #include "DistanceMatchingComponent.generated.h"
 
-// Maximum distance or time value to prevent float overflow.
-#define MAX_MATCH_VALUE (1000.0f)
-// Minimum value to determine if character moving or accelerating.
-#define MOVEMENT_THRESHOLD (0.00001f)
-
 class UCapsuleComponent;
+class UPrimitiveComponent;
 class UCharacterMovementComponent;
+class UDistanceMatchingSubsystem;
 
 UCLASS(ClassGroup = (Custom), meta = (BlueprintSpawnableComponent))
 class DISTANCEMATCHING_API UDistanceMatchingComponent : public UActorComponent
@@ -22,7 +23,10 @@ class DISTANCEMATCHING_API UDistanceMatchingComponent : public UActorComponent
 public:
 	UDistanceMatchingComponent();
 	virtual void InitializeComponent() override;
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 	virtual void TickComponent(const float DeltaTime, const ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
 
 private:
 	// Variables from character and its components
@@ -38,6 +42,9 @@ private:
 	float DistanceToFloor;
 	float GravityZ;
 
+	// Actor height on the last walkable floor, the landing estimate solves against it
+	float GroundZ;
+
 	// Debug flags
 	uint8 bShowDebug : 1;
 	uint8 bDrawDebugTrace : 1;
@@ -47,6 +54,129 @@ private:
 	uint8 bIsAccelerating : 1;
 	uint8 bIsFalling : 1;
 
+	// Start marker was moved to the current location in this frame
+	uint8 bStartMarkerUpdated : 1;
+
+	// Idle and not updated until the movement wakes it up
+	uint8 bIsSleeping : 1;
+
+	// Apex and landing come from the jump trajectory solved at the take-off
+	uint8 bHasJumpTrajectory : 1;
+
+	// The fall is checked against the path the landing was predicted along
+	uint8 bHasLandingPath : 1;
+
+	// Markers of the current state were predicted at a lower fidelity and are predicted again in the next update
+	uint8 bFidelityRaised : 1;
+
+	// Index in the batch tick arrays of the world subsystem
+	int32 BatchIndex;
+
+	// Frame the component was woken up and updated in
+	uint64 WakeUpFrame;
+
+	/** What the async sweeps of a pending prediction check. */
+	enum class EPendingSweepType : uint8
+	{
+		/** Floor trace under the marker, corrects the location only. */
+		Floor,
+		/** Sweeps along the path a chunk at a time, the hit changes the time too. */
+		Path,
+		/** Vertical sweep above the take-off location, turns into a path sweep in the next frame when it hits. */
+		Ceiling
+	};
+
+	/** Async sweeps requested for a marker prediction. */
+	struct FPendingPrediction
+	{
+		/** Marker published with the simulated location, refined when the results arrive. */
+		FPredictResult* Marker = nullptr;
+
+		/** Sweeps in order along the predicted path. */
+		TArray<FTraceHandle, TInlineAllocator<1>> TraceHandles;
+
+		/** Time of each sweep start relative to the prediction start, for path sweeps only. */
+		TArray<float, TInlineAllocator<1>> StepStartTimes;
+
+		/** Time of each sweep, for path sweeps only. */
+		TArray<float, TInlineAllocator<1>> StepDurations;
+
+		/** Sub-steps of the path not requested yet, for path and ceiling sweeps. */
+		DistanceMatchingCore::FJumpPathSweep PathSweep;
+
+		/** Time the marker was published with. */
+		float PredictedTime = 0.0f;
+
+		/** Offset added to the Z of the hit location. */
+		float LocationOffsetZ = 0.0f;
+
+		EPendingSweepType SweepType = EPendingSweepType::Floor;
+	};
+
+	using FJumpPath = DistanceMatchingCore::FJumpPath;
+
+	/** Sweeps the character capsule for the engine independent predictions. */
+	struct FCapsuleQuery final : public DistanceMatchingCore::ICollisionQuery
+	{
+		explicit FCapsuleQuery(const UDistanceMatchingComponent& InComponent) : Component(InComponent) {}
+
+		virtual bool Sweep(const DistanceMatchingCore::FVec3& Start, const DistanceMatchingCore::FVec3& End, DistanceMatchingCore::FVec3& OutLocation, float& OutFraction) override;
+
+		const UDistanceMatchingComponent& Component;
+	};
+
+	/** Sweeps the character capsule against one primitive found by the landing broadphase, sub-steps outside its bounds aren't swept. */
+	struct FPrimitiveQuery final : public DistanceMatchingCore::ICollisionQuery
+	{
+		FPrimitiveQuery(const UDistanceMatchingComponent& InComponent, UPrimitiveComponent& InPrimitive);
+
+		virtual bool Sweep(const DistanceMatchingCore::FVec3& Start, const DistanceMatchingCore::FVec3& End, DistanceMatchingCore::FVec3& OutLocation, float& OutFraction) override;
+
+		const UDistanceMatchingComponent& Component;
+		UPrimitiveComponent& Primitive;
+
+		/** Bounds of the primitive expanded by the capsule extent. */
+		FBox Bounds;
+	};
+
+	TArray<FPendingPrediction> PendingPredictions;
+
+	/** Trajectory of the current jump, followed while bHasJumpTrajectory is set. */
+	DistanceMatchingCore::FJumpTrajectory JumpTrajectory;
+
+	/** Time since the start of the jump trajectory. */
+	float JumpTrajectoryTime;
+
+	/** Path the landing marker was predicted along, swept again a few sub-steps per update while the landing is refined. */
+	DistanceMatchingCore::FJumpPathSweep LandingPath;
+
+	/** Time since the start of the landing path. */
+	float LandingPathTime;
+
+	/** Analytic stop or pivot location when the marker was last predicted, refinement compares against it whatever the prediction method is. */
+	FVector StopRefinementLocation;
+
+	/** Prediction waiting for the trace budget of the world subsystem, the marker holds the estimate until then. */
+	EDistanceMatchingPrediction ScheduledPrediction;
+
+	/** The time since the last update when the prediction was scheduled. */
+	float ScheduledDeltaTime;
+
+	/** Number of sweeps requested by this component, the subsystem charges them to the trace budget. */
+	mutable uint32 SweepCount;
+
+	/**
+	* Double-buffered snapshot guarded by a sequence lock. The sequence is odd while a snapshot is written,
+	* and each write goes to the buffer readers don't use, so a reader retries only if two writes overlap its copy.
+	*/
+	FDistanceMatchingSnapshot Snapshots[2];
+	std::atomic<uint32> SnapshotSequence;
+
+	/** World time of the last markers sent, refinements are rate limited by it. */
+	double LastMarkerSendTime;
+
+	friend class UDistanceMatchingSubsystem;
+
 protected:
 	UPROPERTY(Transient)
 	TObjectPtr<UWorld> World;
@@ -61,6 +191,7 @@ protected:
 	TObjectPtr<UCharacterMovementComponent> MovementComponent;
 
 	EDistanceMatchingType DistanceMatchingType;
+	EDistanceMatchingFidelity Fidelity;
 	FPredictResult StartMarker;
 	FPredictResult StopMarker;
 	FPredictResult PivotMarker;
@@ -68,6 +199,10 @@ protected:
 	FPredictResult ApexMarker;
 	FPredictResult LandingMarker;
 
+	/** Markers received by simulated proxies. On the sending side, the last markers sent. */
+	UPROPERTY(ReplicatedUsing = OnRep_ReplicatedMarkers)
+	FDistanceMatchingReplicatedMarkers ReplicatedMarkers;
+
 public:
 	/** Maximum simulation time for the stop/pivot location or jump path predictions. */
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DistanceMatching", meta = (ClampMin = 0.1f, ClampMax = 5.0f, UIMin = 0.1f, UIMax = 5.0f))
@@ -81,6 +216,26 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DistanceMatching", meta = (ClampMin = 1.0f, ClampMax = 30.0f, UIMin = 1.0f, UIMax = 30.0f))
 	float LandingSimulationFrequency;
 
+	/**
+	* Split the jump paths by an error bound in world units instead of the simulation frequencies. Sub-steps are as long as their chords
+	* stay within JumpPathTolerance of the arc, and the sub-step which hits geometry is swept again in halves down to JumpPathHitTolerance.
+	* Async path sweeps refine the sub-step which hit in one more async stage. The broadphase landing uses the adaptive sub-steps only.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DistanceMatching")
+	uint8 bUseAdaptiveJumpPath : 1;
+
+	/** Largest distance between the swept sub-steps and the jump arc in open air. Ledges closer to the arc than this may be missed or clipped. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DistanceMatching", meta = (EditCondition = "bUseAdaptiveJumpPath", ClampMin = 0.5f, UIMin = 0.5f, UIMax = 50.0f))
+	float JumpPathTolerance;
+
+	/** Largest distance between the sub-step which hits and the jump arc, the error of the hit location and time. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DistanceMatching", meta = (EditCondition = "bUseAdaptiveJumpPath", ClampMin = 0.1f, UIMin = 0.1f, UIMax = 50.0f))
+	float JumpPathHitTolerance;
+
+	/** How the stop and pivot locations are predicted. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DistanceMatching")
+	EDistanceMatchingStopPredictionMethod StopPredictionMethod;
+
 	/** Minimum angle for pivot detection. */
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DistanceMatching", meta = (ClampMin = 0.0f, ClampMax = 180.0f, UIMin = 0.0f, UIMax = 180.0f))
 	float MinPivotAngle;
@@ -89,6 +244,15 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DistanceMatching|Trace")
 	TEnumAsByte<ETraceTypeQuery> TraceChannel;
 
+	/**
+	* How the traces for marker predictions run. In async mode markers are published as pending with the simulated location
+	* and refined in the next frame, when the trace results arrive. This adds one frame of latency to the collision correction.
+	* Jump paths are swept a chunk of sub-steps per frame (c.DistanceMatching.AsyncPathSweeps) until one hits, then the sub-step
+	* which hit is swept again within the hit tolerance, so they may take a few frames.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DistanceMatching|Trace")
+	EDistanceMatchingTraceMode TraceMode;
+
 	/** Actors which will be ignored for all kind of traces used for distance matching. */
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DistanceMatching|Trace")
 	TArray<TObjectPtr<AActor>> ActorsToIgnore;
@@ -97,6 +261,106 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DistanceMatching|Trace", meta = (ClampMin = 100.0f, ClampMax = 1000.0f, UIMin = 100.0f, UIMax = 1000.0f))
 	float StopLocationTraceHalfHeight;
 
+	/**
+	* Predict the landing with one overlap query over the bounds of the whole jump arc and sweep the arc only against the blocking
+	* primitives found there, each up to the earliest hit so far and only where the arc passes their bounds. Without any, the arc
+	* is not swept at all. Used in the sync trace mode only, async predictions sweep the world along the arc.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DistanceMatching|Trace")
+	uint8 bUseBroadphaseLanding : 1;
+
+	/** Sweep the world along the arc instead when the broadphase finds more blocking primitives than this. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DistanceMatching|Trace", meta = (EditCondition = "bUseBroadphaseLanding", ClampMin = 1, UIMin = 1, UIMax = 64))
+	int32 MaxBroadphaseCandidates;
+
+	/**
+	* Solve the jump apex and landing once at the take-off and follow the trajectory until the landing. The landing isn't swept again
+	* when the character starts falling, the trajectory is solved again only if the character drifts from it by more than the tolerance,
+	* e.g. by air control or a collision. Used with full fidelity and sync trace mode.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DistanceMatching|Trace")
+	uint8 bUseJumpTrajectory : 1;
+
+	/** Distance between the character and its jump trajectory beyond which the trajectory is solved again. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DistanceMatching|Trace", meta = (EditCondition = "bUseJumpTrajectory", ClampMin = 1.0f, UIMin = 1.0f, UIMax = 100.0f))
+	float JumpTrajectoryTolerance;
+
+	/**
+	* Check the stop, pivot and landing markers in every update and correct them when the movement no longer leads there, e.g. when the
+	* character is pushed or the braking settings change. The stop and pivot are solved again and traced only if they moved by more than
+	* the tolerance. The fall is checked against the path the landing was predicted along, and the new path is swept over several updates.
+	* Used with full fidelity, markers waiting for async traces are not refined.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DistanceMatching|Refinement")
+	uint8 bRefineMarkers : 1;
+
+	/** Distance the marker or the fall path must be off by to be refined. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DistanceMatching|Refinement", meta = (EditCondition = "bRefineMarkers", ClampMin = 1.0f, UIMin = 1.0f, UIMax = 100.0f))
+	float MarkerRefinementTolerance;
+
+	/** Maximum number of landing path sub-steps swept per update while the landing is refined. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DistanceMatching|Refinement", meta = (EditCondition = "bRefineMarkers", ClampMin = 1, UIMin = 1, UIMax = 16))
+	int32 MaxRefinementSweeps;
+
+	/**
+	* Tick together with all other batched components of the world instead of own tick function.
+	* The movement state is gathered once for all of them and the state machine and markers are updated in parallel.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "DistanceMatching|Performance")
+	uint8 bUseBatchTick : 1;
+
+	/**
+	* Stop updating while the character is idle and wake up on movement mode changes or movement updates with velocity or acceleration.
+	* The markers are updated right away on wake up, so they are never a frame stale.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "DistanceMatching|Performance")
+	uint8 bSleepWhenIdle : 1;
+
+	/**
+	* Run the traced predictions within the per-frame trace budget shared by all components of the world, see c.DistanceMatching.TraceBudget.*.
+	* The marker is published right away with the estimate solved without traces and stays pending until the prediction runs,
+	* by priority: locally controlled, recently rendered, then closer to the local views. Marker refinements and drift re-predictions
+	* run right away but are charged to the same budget. Used with full fidelity.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "DistanceMatching|Performance")
+	uint8 bUseTraceBudget : 1;
+
+	/**
+	* Replicate the markers instead of predicting them on every machine. The authority, or the autonomous proxy for player controlled
+	* characters, sends the quantized markers on state transitions and their refined locations, rate limited. Simulated proxies skip the
+	* state machine and traces and only update the distances to the received markers. Enables the component replication.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "DistanceMatching|Replication")
+	uint8 bReplicateMarkers : 1;
+
+	/** How the prediction fidelity is selected. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DistanceMatching|Fidelity")
+	EDistanceMatchingFidelityMode FidelityMode;
+
+	/** Distance to the closest local view beyond which the fidelity is reduced. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DistanceMatching|Fidelity", meta = (ClampMin = 0.0f, UIMin = 0.0f, UIMax = 20000.0f))
+	float ReducedFidelityDistance;
+
+	/** Distance to the closest local view beyond which only the state machine is updated. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DistanceMatching|Fidelity", meta = (ClampMin = 0.0f, UIMin = 0.0f, UIMax = 50000.0f))
+	float MinimalFidelityDistance;
+
+	/** Significance below which the fidelity is reduced. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DistanceMatching|Fidelity", meta = (ClampMin = 0.0f, UIMin = 0.0f, UIMax = 1.0f))
+	float ReducedFidelitySignificance;
+
+	/** Significance below which only the state machine is updated. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DistanceMatching|Fidelity", meta = (ClampMin = 0.0f, UIMin = 0.0f, UIMax = 1.0f))
+	float MinimalFidelitySignificance;
+
+	/** Fraction of a threshold the value must cross it by to change the fidelity, prevents switching back and forth at the border. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DistanceMatching|Fidelity", meta = (ClampMin = 0.0f, ClampMax = 1.0f, UIMin = 0.0f, UIMax = 0.5f))
+	float FidelityHysteresis;
+
+	/** Use at least reduced fidelity for characters which were not rendered recently, in distance mode. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DistanceMatching|Fidelity")
+	uint8 bReduceFidelityWhenNotRendered : 1;
+
 	/** Debug sphere radius for markers. */
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DistanceMatching|Debug")
 	float DebugSphereRadius;
@@ -110,30 +374,272 @@ public:
 	float TraceDrawTime;
 
 private:
+	/** Update the movement state, the state machine, predictions and markers. */
+	void Update(const float DeltaTime);
+
+	/** Returns true if the state and markers are received from the server instead of predicted. */
+	bool UsesReplicatedMarkers() const { return bReplicateMarkers && GetOwnerRole() == ROLE_SimulatedProxy; }
+
+	/**
+	* Send the markers on state transitions, and their refined locations at most every c.DistanceMatching.MarkerRefinementSendInterval.
+	* Transitions go to the server reliably, refinements unreliably. Must be called from the game thread.
+	*/
+	void SendReplicatedMarkers(const EDistanceMatchingPrediction Prediction);
+
+	/** Returns the markers of the current state for replication. */
+	FDistanceMatchingReplicatedMarkers MakeReplicatedMarkers();
+
+	/** Returns the markers used by the current state, the first and the second one in the replicated markers. */
+	void GetReplicatedMarkers(FPredictResult*& OutFirstMarker, FPredictResult*& OutSecondMarker);
+
+	UFUNCTION(Server, Reliable)
+	void ServerSetReplicatedMarkers(const FDistanceMatchingReplicatedMarkers& InReplicatedMarkers);
+
+	/** Refined locations of the markers of the current transition, ignored if they arrive for another one. */
+	UFUNCTION(Server, Unreliable)
+	void ServerRefineReplicatedMarkers(const FDistanceMatchingReplicatedMarkers& InReplicatedMarkers);
+
+	UFUNCTION()
+	void OnRep_ReplicatedMarkers();
+
+	/** Tick after the character movement and before the mesh, so the animation update reads the markers of this frame. */
+	void AddTickDependencies();
+
+	/** Remove the tick dependencies added by AddTickDependencies. */
+	void RemoveTickDependencies();
+
+	/** Returns true if the character is idle and nothing is pending, so the component can sleep. */
+	bool ShouldSleep() const;
+
+	/** Stop updating until the movement wakes the component up. */
+	void Sleep();
+
+	/** Resume updating and update right away. */
+	void WakeUp(const float DeltaTime);
+
+	UFUNCTION()
+	void OnMovementModeChanged(ACharacter* InCharacter, EMovementMode PrevMovementMode, uint8 PreviousCustomMode);
+
+	UFUNCTION()
+	void OnCharacterMovementUpdated(float DeltaSeconds, FVector OldLocation, FVector OldVelocity);
+
+	/** Read the movement state from the character and its components. */
+	void UpdateMovementState();
+
+	/** Update the movement state with values read from the character and its components. */
+	void ApplyMovementState(const FVector& InActorLocation, const FVector& InVelocity, const FVector& InAcceleration, const float InCapsuleRadius, const float InCapsuleHalfHeight, const float InDistanceToFloor, const float InGravityZ, const bool bInIsFalling);
+
+	/** Returns the movement state as the input of the shared state machine. */
+	FDistanceMatchingMovement GetMovement() const;
+
+	/** Returns references to the type and markers for the shared state machine. */
+	FDistanceMatchingMarkersRef GetMarkersRef();
+
+	/** Update the distance matching type by the movement state. Returns the marker prediction required by the transition, or by a raised fidelity. */
+	EDistanceMatchingPrediction UpdateDistanceMatchingType();
+
+	/** Run the marker prediction. Traces the world, so it must be called from the game thread. */
+	void RunPrediction(const EDistanceMatchingPrediction Prediction, const float DeltaTime);
+
+	/** Run the prediction of the marker required by the transition right away. */
+	void PredictMarker(const EDistanceMatchingPrediction Prediction, const float DeltaTime);
+
+	/**
+	* Publish the estimate and queue the prediction in the trace budget of the world subsystem.
+	*
+	* @param Prediction		Prediction required by the state transition in this frame.
+	* @param DeltaTime		The time since the last update.
+	* @return				False if the prediction should run right away.
+	*/
+	bool SchedulePrediction(const EDistanceMatchingPrediction Prediction, const float DeltaTime);
+
+	/** Run the prediction queued by SchedulePrediction, unless the state changed since. Must be called from the game thread. */
+	void RunScheduledPrediction();
+
+	/** Charge the sweeps requested since the given sweep count to the trace budget of the world subsystem, if the component uses it. */
+	void ChargeTraceBudget(const uint32 PrevSweepCount) const;
+
+	/** Publish the marker solved without traces as pending. */
+	void PublishEstimate(const EDistanceMatchingPrediction Prediction, const float DeltaTime);
+
+	/** Returns the marker updated by the prediction, nullptr for none. */
+	FPredictResult* GetPredictionMarker(const EDistanceMatchingPrediction Prediction);
+
+	/** Returns the prediction of the markers of the current distance matching type, None if it has no predicted markers. */
+	EDistanceMatchingPrediction GetTypePrediction() const;
+
+	/** Apply the results of async traces requested in previous frames. Must be called from the game thread. */
+	void ResolvePendingPredictions();
+
+	/** Adds a pending prediction for the marker, replacing the previous one. */
+	FPendingPrediction& AddPendingPrediction(FPredictResult& Marker);
+
+	/** Request an async capsule sweep with the trace settings of this component. */
+	FTraceHandle RequestAsyncSweep(const FVector& Start, const FVector& End) const;
+
+	/** Request async sweeps of the next chunk of the pending path sub-steps. Returns false if the path has been swept completely. */
+	bool RequestPathSweeps(FPendingPrediction& Pending) const;
+
+	/** Update distance and time to the marker of the current distance matching type. Jump and fall markers follow the jump trajectory while there is one. */
+	void UpdateMarkers(const float DeltaTime);
+
+	/** Publish the state and markers for readers on other threads. Called by the single writer only. */
+	void PublishSnapshot();
+
+#if ENABLE_DRAW_DEBUG
+	/** Draw the markers and the character path. */
+	void DrawDebug(const EDistanceMatchingPrediction Prediction) const;
+#endif
+
 	/**
 	* Predict the stop or pivot location for the character.
 	*
 	* @param PredictResult		Output result of the prediction (location and time).
 	* @param DeltaTime			The time since the last tick.
 	*/
-	void PredictStopLocation(FPredictResult& PredictResult, const float DeltaTime) const;
+	void PredictStopLocation(FPredictResult& PredictResult, const float DeltaTime);
+
+	/** Returns the braking settings of the character movement component. */
+	DistanceMatchingCore::FBrakingParams GetBrakingParams() const;
+
+	/**
+	* Solve the braking motion in closed form: exact for braking without acceleration, continuous approximation for pivot.
+	*
+	* @param OutLocation	Location where the character stops (or turns for pivot).
+	* @param OutTime		Time to stop, limited by MaxSimulationTime.
+	*/
+	void SolveStopLocation(FVector& OutLocation, float& OutTime) const;
+
+	/**
+	* Integrate the braking motion in steps of DeltaTime.
+	*
+	* @param DeltaTime		The time since the last tick.
+	* @param OutLocation	Location where the character stops (or turns for pivot).
+	* @param OutTime		Time to stop, limited by MaxSimulationTime.
+	*/
+	void SimulateStopLocation(const float DeltaTime, FVector& OutLocation, float& OutTime) const;
 
 	/**
 	* Predict the arc of a jump path affected by gravity with collision checks along the arc.
 	*
 	* @param PredictResult			Output result of the prediction (location and time).
 	* @param SimulationTime			Maximum simulation time for the jump path prediction.
-	* @param SimulationFrequency	Determines size of each sub-step in the simulation (chopping up SimulationTime).
+	* @param SimulationFrequency	Determines size of each sub-step in the simulation (chopping up SimulationTime), unless the jump path is adaptive.
+	* @param LocationOffsetZ		Offset added to the Z of the hit location.
+	*/
+	void PredictJumpPath(FPredictResult& PredictResult, const float SimulationTime = 2.0f, const float SimulationFrequency = 10.0f, const float LocationOffsetZ = 0.0f);
+
+	/**
+	* Integrate the arc of a jump path affected by gravity.
+	*
+	* @param StartLocation			Location the path starts from.
+	* @param StartVelocity			Velocity at the start of the path.
+	* @param SimulationTime			Simulation time of the path.
+	* @param Stepping				Determines size of each sub-step in the simulation (chopping up SimulationTime).
+	* @param OutPath				Sub-step points of the path.
 	*/
-	void PredictJumpPath(FPredictResult& PredictResult, const float SimulationTime = 2.0f, const float SimulationFrequency = 10.0f) const;
+	void BuildJumpPath(const FVector& StartLocation, const FVector& StartVelocity, const float SimulationTime, const DistanceMatchingCore::FJumpPathStepping& Stepping, FJumpPath& OutPath) const;
 
-	/** Predict the jump apex location and time to it. */
-	void PredictJumpApex(FPredictResult& PredictResult) const;
+	/**
+	* Sweep the capsule along the jump path sub-steps until the first blocking hit.
+	*
+	* @param Path			Sub-step points of the path.
+	* @param OutLocation	Location of the hit.
+	* @param OutTime		Time of the hit relative to the path start.
+	* @return				True if the path is blocked.
+	*/
+	bool SweepJumpPath(const FJumpPath& Path, FVector& OutLocation, float& OutTime) const;
+
+	/**
+	* Predict the jump apex location and time to it.
+	* The apex is solved from the ballistic equations, the path is swept sub-step by sub-step only when there is a ceiling above the take-off.
+	*/
+	void PredictJumpApex(FPredictResult& PredictResult);
 
 	/** Predict the jump landing location and time to it. */
-	void PredictLandingLocation(FPredictResult& PredictResult) const;
+	void PredictLandingLocation(FPredictResult& PredictResult);
+
+	/** Solve the jump trajectory from the current location and velocity and publish its apex (while rising) and landing. */
+	void PredictJumpTrajectory();
+
+	/**
+	* Advance along the jump trajectory and solve it again if the character drifted from it. Must be called from the game thread.
+	*
+	* @param Prediction		Prediction required by the state transition in this frame.
+	* @param DeltaTime		The time since the last update.
+	*/
+	void UpdateJumpTrajectory(const EDistanceMatchingPrediction Prediction, const float DeltaTime);
+
+	/**
+	* Correct the marker of the current state if the movement no longer leads there. Must be called from the game thread.
+	*
+	* @param Prediction		Prediction required by the state transition in this frame, fresh markers are not refined.
+	* @param DeltaTime		The time since the last update.
+	*/
+	void RefineMarkers(const EDistanceMatchingPrediction Prediction, const float DeltaTime);
+
+	/** Solve the stop or pivot analytically and predict it again with the configured method if it moved by more than the tolerance. */
+	void RefineStopMarker(FPredictResult& PredictResult, const float DeltaTime);
+
+	/** Check the fall against the landing path and sweep the new path within the budget once it leaves it. */
+	void RefineLandingMarker(const float DeltaTime);
+
+	/** Publish a marker predicted without traces, discarding async sweeps still pending for it. */
+	void ResolvePrediction(FPredictResult& PredictResult, const FVector& Location, const float Time);
+
+	/** Select the fidelity by the distance to the local views in distance mode. Must be called from the game thread. */
+	void UpdateFidelityFromView();
+
+	/** Returns the squared distance to the closest local view, MAX_flt without local views. */
+	float GetClosestViewDistanceSquared() const;
+
+	/**
+	* Select the fidelity tier for a value with hysteresis.
+	*
+	* @param Value				Value which lowers the fidelity as it grows.
+	* @param ReducedThreshold	Value beyond which the fidelity is reduced.
+	* @param MinimalThreshold	Value beyond which the fidelity is minimal.
+	*/
+	EDistanceMatchingFidelity SelectFidelity(const float Value, const float ReducedThreshold, const float MinimalThreshold) const;
+
+	/** Solve the landing without traces against the height of the last walkable floor, before the jump or the fall off a ledge. */
+	void SolveLandingEstimate(FVector& OutLocation, float& OutTime) const;
+
+	/** Returns the jump path sub-steps for the simulation frequency, or the adaptive ones. */
+	DistanceMatchingCore::FJumpPathStepping GetJumpPathStepping(const float SimulationFrequency) const;
+
+	/**
+	* Predict the landing by sweeping the arc against the primitives overlapping its bounds only.
+	*
+	* @param PredictResult		Output result of the prediction (location and time).
+	* @return					False if there are too many candidates and the world should be swept instead.
+	*/
+	bool PredictLandingLocationBroadphase(FPredictResult& PredictResult);
 
 public:
+	/** Returns the current prediction fidelity. */
+	UFUNCTION(BlueprintCallable, Category = "DistanceMatching|Fidelity")
+	EDistanceMatchingFidelity GetFidelity() const { return Fidelity; }
+
+	/** Set the prediction fidelity. Overridden every frame in distance mode. */
+	UFUNCTION(BlueprintCallable, Category = "DistanceMatching|Fidelity")
+	void SetFidelity(const EDistanceMatchingFidelity InFidelity);
+
+	/** Select the fidelity by the significance of the character, e.g. from a Significance Manager post significance function. */
+	UFUNCTION(BlueprintCallable, Category = "DistanceMatching|Fidelity")
+	void UpdateFidelityFromSignificance(const float Significance);
+
+	/**
+	* Returns the state and markers of the last update. Safe to call from any thread,
+	* e.g. from thread safe update functions of animation blueprints through Property Access.
+	*/
+	UFUNCTION(BlueprintPure, Category = "DistanceMatching", meta = (BlueprintThreadSafe))
+	FDistanceMatchingSnapshot GetSnapshot() const;
+
+	/** Returns the marker of the last update. Safe to call from any thread. */
+	UFUNCTION(BlueprintPure, Category = "DistanceMatching", meta = (BlueprintThreadSafe))
+	FPredictResult GetSnapshotMarker(const EDistanceMatchingMarker Marker) const { return GetSnapshot().GetMarker(Marker); }
+
 	/** Returns a struct with location, distance and time to marker. */
 	UFUNCTION(BlueprintCallable, Category = "DistanceMatching")
 	FPredictResult GetStartMarker() const { return StartMarker; }
@@ -0,0 +1,149 @@
+// Copyright Roman Merkushin. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/DistanceMatchingTypes.h"
+
+// Maximum distance or time value to prevent float overflow.
+#define MAX_MATCH_VALUE (1000.0f)
+// Minimum value to determine if character moving or accelerating.
+#define MOVEMENT_THRESHOLD (0.00001f)
+
+/** Movement of a character or a crowd agent in the current frame. */
+struct FDistanceMatchingMovement
+{
+	FVector Location;
+	FVector PreviousLocation;
+	FVector Velocity;
+	FVector Acceleration;
+	float PreviousAccelerationSize;
+	bool bIsMoving;
+	bool bIsAccelerating;
+	bool bIsFalling;
+};
+
+/** Distance matching type and markers of a character or a crowd agent, each owner keeps them in its own layout. */
+struct FDistanceMatchingMarkersRef
+{
+	EDistanceMatchingType& Type;
+	FPredictResult& StartMarker;
+	FPredictResult& StopMarker;
+	FPredictResult& PivotMarker;
+	FPredictResult& TakeOffMarker;
+	FPredictResult& ApexMarker;
+	FPredictResult& LandingMarker;
+
+	explicit FDistanceMatchingMarkersRef(FDistanceMatchingSnapshot& Snapshot)
+		: Type(Snapshot.DistanceMatchingType)
+		, StartMarker(Snapshot.StartMarker)
+		, StopMarker(Snapshot.StopMarker)
+		, PivotMarker(Snapshot.PivotMarker)
+		, TakeOffMarker(Snapshot.TakeOffMarker)
+		, ApexMarker(Snapshot.ApexMarker)
+		, LandingMarker(Snapshot.LandingMarker)
+	{
+	}
+
+	FDistanceMatchingMarkersRef(EDistanceMatchingType& InType, FPredictResult& InStartMarker, FPredictResult& InStopMarker, FPredictResult& InPivotMarker, FPredictResult& InTakeOffMarker, FPredictResult& InApexMarker, FPredictResult& InLandingMarker)
+		: Type(InType)
+		, StartMarker(InStartMarker)
+		, StopMarker(InStopMarker)
+		, PivotMarker(InPivotMarker)
+		, TakeOffMarker(InTakeOffMarker)
+		, ApexMarker(InApexMarker)
+		, LandingMarker(InLandingMarker)
+	{
+	}
+};
+
+/**
+ * Distance matching logic shared by UDistanceMatchingComponent and the Mass processors.
+ * Works on plain data only, so it runs on any thread and doesn't depend on the character classes.
+ * The solvers forward to the engine independent DistanceMatchingCore.
+ */
+namespace DistanceMatchingStateMachine
+{
+	/**
+	* Update the distance matching type by the movement. Moves the start and take-off markers on the corresponding transitions.
+	*
+	* @param Movement			Movement in the current frame.
+	* @param MinPivotAngle		Minimum angle between the velocity and acceleration for pivot detection.
+	* @param Markers			Type and markers to update.
+	* @param bOutStartMarkerUpdated	Set to true if the start marker was moved to the previous location.
+	* @return					Marker prediction required by the transition.
+	*/
+	DISTANCEMATCHING_API EDistanceMatchingPrediction UpdateType(const FDistanceMatchingMovement& Movement, const float MinPivotAngle, const FDistanceMatchingMarkersRef& Markers, bool& bOutStartMarkerUpdated);
+
+	/**
+	* Update distance and time to the markers of the current distance matching type.
+	*
+	* @param Location		Current location.
+	* @param DeltaTime		The time since the last update.
+	* @param Markers		Type and markers to update.
+	*/
+	DISTANCEMATCHING_API void UpdateMarkers(const FVector& Location, const float DeltaTime, const FDistanceMatchingMarkersRef& Markers);
+
+	/**
+	* Solve the braking motion in closed form: exact for braking without acceleration, continuous approximation for pivot.
+	*
+	* @param Location				Current location.
+	* @param Velocity				Current velocity.
+	* @param Acceleration			Current acceleration, zero for stop.
+	* @param Friction				Braking friction (ground friction multiplied by the braking friction factor).
+	* @param BrakingDeceleration	Constant deceleration applied while braking.
+	* @param BrakeToStopVelocity	Speed below which the braking movement stops.
+	* @param MaxSimulationTime		Maximum time of the prediction.
+	* @param OutLocation			Location where the movement stops (or turns for pivot).
+	* @param OutTime				Time to stop, limited by MaxSimulationTime.
+	*/
+	DISTANCEMATCHING_API void SolveStopLocation(const FVector& Location, const FVector& Velocity, const FVector& Acceleration, const float Friction, const float BrakingDeceleration, const float BrakeToStopVelocity, const float MaxSimulationTime, FVector& OutLocation, float& OutTime);
+
+	/**
+	* Solve the apex of the ballistic jump path.
+	*
+	* @param Location				Take-off location.
+	* @param Velocity				Take-off velocity.
+	* @param GravityZ				Gravity acceleration, negative when pointing down.
+	* @param MaxSimulationTime		Time to the apex without gravity.
+	* @param OutLocation			Apex location.
+	* @param OutTime				Time to the apex.
+	*/
+	DISTANCEMATCHING_API void SolveJumpApex(const FVector& Location, const FVector& Velocity, const float GravityZ, const float MaxSimulationTime, FVector& OutLocation, float& OutTime);
+
+	/**
+	* Solve where the ballistic path comes down to the ground height, for movement without collision queries.
+	*
+	* @param Location				Current location.
+	* @param Velocity				Current velocity.
+	* @param GravityZ				Gravity acceleration, negative when pointing down.
+	* @param GroundZ				Height of the ground to land on.
+	* @param MaxSimulationTime		Maximum time of the prediction.
+	* @param OutLocation			Landing location.
+	* @param OutTime				Time to the landing, limited by MaxSimulationTime.
+	*/
+	DISTANCEMATCHING_API void SolveLandingLocation(const FVector& Location, const FVector& Velocity, const float GravityZ, const float GroundZ, const float MaxSimulationTime, FVector& OutLocation, float& OutTime);
+
+	/**
+	* Record the ground height while the movement is on the ground. It's kept through the jump or the fall off a ledge for the landing estimate.
+	*
+	* @param Movement			Movement in the current frame.
+	* @param DistanceToFloor	Distance between the bottom of the character and the floor, 0 for agents without one.
+	* @param InOutGroundZ		Ground height, updated when not falling.
+	*/
+	DISTANCEMATCHING_API void UpdateGroundZ(const FDistanceMatchingMovement& Movement, const float DistanceToFloor, float& InOutGroundZ);
+
+	/**
+	* Estimate the landing without collision queries, on the ground height recorded by UpdateGroundZ.
+	*
+	* @param Location				Current location.
+	* @param Velocity				Current velocity.
+	* @param GravityZ				Gravity acceleration, negative when pointing down.
+	* @param GroundZ				Ground height recorded before the fall.
+	* @param DistanceToFloor		Distance between the bottom of the character and the floor, added back to the landing height.
+	* @param MaxSimulationTime		Maximum time of the prediction.
+	* @param OutLocation			Landing location.
+	* @param OutTime				Time to the landing, limited by MaxSimulationTime.
+	*/
+	DISTANCEMATCHING_API void SolveLandingEstimate(const FVector& Location, const FVector& Velocity, const float GravityZ, const float GroundZ, const float DistanceToFloor, const float MaxSimulationTime, FVector& OutLocation, float& OutTime);
+}  // namespace DistanceMatchingStateMachine
@@ -0,0 +1,128 @@
+// Copyright Roman Merkushin. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/EngineBaseTypes.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "GameFramework/DistanceMatchingTypes.h"
+#include "DistanceMatchingSubsystem.generated.h"
+
+class UDistanceMatchingComponent;
+class UDistanceMatchingSubsystem;
+
+/** Tick function which updates all batched distance matching components of the world. */
+USTRUCT()
+struct FDistanceMatchingBatchTickFunction : public FTickFunction
+{
+	GENERATED_BODY()
+
+	UDistanceMatchingSubsystem* Subsystem = nullptr;
+
+	// FTickFunction interface
+	virtual void ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent) override;
+	virtual FString DiagnosticMessage() override;
+	// End of FTickFunction interface
+};
+
+template <>
+struct TStructOpsTypeTraits<FDistanceMatchingBatchTickFunction> : public TStructOpsTypeTraitsBase2<FDistanceMatchingBatchTickFunction>
+{
+	enum
+	{
+		WithCopy = false
+	};
+};
+
+/**
+ * Ticks all distance matching components with bUseBatchTick in one go.
+ * The movement state is gathered into arrays on the game thread, then the state machine and marker updates run in parallel.
+ * Only the predictions which need traces run serially in between.
+ * Also runs the predictions scheduled within the per-frame trace budget, for batched and not batched components alike.
+ * The batch ticks after the movement of all batched characters and before their meshes.
+ */
+UCLASS()
+class DISTANCEMATCHING_API UDistanceMatchingSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	// UWorldSubsystem interface
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Deinitialize() override;
+	// End of UWorldSubsystem interface
+
+	/** Add the component to the batch. Its own tick function should be disabled. */
+	void RegisterComponent(UDistanceMatchingComponent* Component);
+
+	/** Remove the component from the batch. */
+	void UnregisterComponent(UDistanceMatchingComponent* Component);
+
+	/** Add a component which was woken up and updated in this frame. It joins the batch from the next frame. */
+	void RegisterComponentNextFrame(UDistanceMatchingComponent* Component);
+
+	/** Returns the number of batched components. */
+	int32 GetNumComponents() const { return Components.Num(); }
+
+	/** Queue the prediction scheduled by the component, it runs within the trace budget of this or the next frames. */
+	void SchedulePrediction(UDistanceMatchingComponent* Component);
+
+	/** Returns the number of predictions waiting for the trace budget. */
+	int32 GetNumScheduledPredictions() const { return ScheduledPredictions.Num(); }
+
+	/** Charge the sweeps a component traced outside of the scheduler, they are taken from the trace budget of the next scheduled run. */
+	void ChargeSweeps(const int32 NumSweeps) { NumChargedSweeps += NumSweeps; }
+
+	/** Update all batched components. */
+	void Tick(const float DeltaTime);
+
+protected:
+	virtual bool DoesSupportWorldType(EWorldType::Type WorldType) const override;
+
+private:
+	/** Run the scheduled predictions by priority until the trace budget of the frame is spent. Must be called from the game thread. */
+	void RunScheduledPredictions();
+
+	/** Prediction of a component waiting for the trace budget. */
+	struct FScheduledPrediction
+	{
+		TWeakObjectPtr<UDistanceMatchingComponent> Component;
+
+		/** Lower runs first: locally controlled, recently rendered, others. */
+		uint8 Priority = 0;
+
+		/** Squared distance to the closest local view, orders the predictions of the same priority. */
+		float ViewDistanceSquared = 0.0f;
+
+		/** Frame the prediction was scheduled in. */
+		uint64 Frame = 0;
+	};
+
+	FDistanceMatchingBatchTickFunction BatchTickFunction;
+
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<UDistanceMatchingComponent>> Components;
+
+	/** Woken up components waiting to join the batch. */
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<UDistanceMatchingComponent>> DeferredComponents;
+
+	// Movement state gathered from the characters, one element per component
+	TArray<FVector> Locations;
+	TArray<FVector> Velocities;
+	TArray<FVector> Accelerations;
+	TArray<float> CapsuleRadii;
+	TArray<float> CapsuleHalfHeights;
+	TArray<float> FloorDistances;
+	TArray<float> GravityZs;
+	TArray<bool> FallingFlags;
+
+	// Predictions requested by the state machine in the current frame
+	TArray<EDistanceMatchingPrediction> Predictions;
+
+	// Predictions waiting for the trace budget
+	TArray<FScheduledPrediction> ScheduledPredictions;
+
+	// Sweeps traced outside of the scheduler since the last scheduled run
+	int64 NumChargedSweeps = 0;
+};
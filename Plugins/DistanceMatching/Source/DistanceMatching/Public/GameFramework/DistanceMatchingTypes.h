@@ -2,6 +2,7 @@
 
 #pragma once
 
+#include "Engine/NetSerialization.h"
 #include "DistanceMatchingTypes.generated.h"
 
 UENUM(BlueprintType)
@@ -15,6 +16,65 @@ enum class EDistanceMatchingType : uint8
 	None,
 };
 
+UENUM(BlueprintType)
+enum class EDistanceMatchingTraceMode : uint8
+{
+	/** Traces run immediately on the game thread. */
+	Sync,
+	/** Traces run on the async trace tasks, results are applied in the next frame. */
+	Async,
+};
+
+UENUM(BlueprintType)
+enum class EDistanceMatchingStopPredictionMethod : uint8
+{
+	/** Closed-form solution of the braking motion, the cost doesn't depend on the frame rate. */
+	Analytic,
+	/** Integrate the braking motion in steps of the frame time. Reference for validation. */
+	Iterative,
+};
+
+UENUM(BlueprintType)
+enum class EDistanceMatchingFidelity : uint8
+{
+	/** All predictions with collision traces. */
+	Full,
+	/** Analytic predictions without traces, the landing is solved against the height of the last walkable floor. */
+	Reduced,
+	/** State machine and the analytic estimates without traces, markers are not refined. */
+	Minimal,
+};
+
+UENUM(BlueprintType)
+enum class EDistanceMatchingFidelityMode : uint8
+{
+	/** Fidelity is set with SetFidelity or UpdateFidelityFromSignificance, e.g. from the Significance Manager. */
+	Manual,
+	/** Fidelity is selected by the distance to the closest local view and whether the character was recently rendered. */
+	Distance,
+};
+
+UENUM(BlueprintType)
+enum class EDistanceMatchingMarker : uint8
+{
+	Start,
+	Stop,
+	Pivot,
+	TakeOff,
+	Apex,
+	Landing,
+};
+
+/** Marker prediction requested by a distance matching state transition. */
+enum class EDistanceMatchingPrediction : uint8
+{
+	None,
+	Stop,
+	Pivot,
+	JumpApex,
+	Landing,
+};
+
 USTRUCT(BlueprintType)
 struct FPredictResult
 {
@@ -32,10 +92,121 @@ struct FPredictResult
 	UPROPERTY(BlueprintReadOnly)
 	float Time;
 
+	/** Marker is predicted without collision yet, it will be refined when the async trace results arrive. */
+	UPROPERTY(BlueprintReadOnly)
+	uint8 bIsPending : 1;
+
 	FPredictResult()
 		: Location(ForceInitToZero)
 		, Distance(0.0f)
 		, Time(0.0f)
+		, bIsPending(false)
+	{
+	}
+};
+
+/**
+ * Markers of the current distance matching state, sent by the authority or the autonomous proxy on state transitions.
+ * Only the markers used by the state are serialized: Start, Stop and Pivot use the first one,
+ * Jump uses the take-off and apex, Fall uses the apex and landing. Locations are quantized to 0.1 cm and times to 1 ms.
+ */
+USTRUCT()
+struct DISTANCEMATCHING_API FDistanceMatchingReplicatedMarkers
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	EDistanceMatchingType DistanceMatchingType;
+
+	/** Incremented on every transition, so a repeated transition to the same state is replicated too. Refinements keep it. */
+	UPROPERTY()
+	uint8 TransitionCount;
+
+	UPROPERTY()
+	FVector FirstLocation;
+
+	UPROPERTY()
+	float FirstTime;
+
+	UPROPERTY()
+	FVector SecondLocation;
+
+	UPROPERTY()
+	float SecondTime;
+
+	FDistanceMatchingReplicatedMarkers()
+		: DistanceMatchingType(EDistanceMatchingType::None)
+		, TransitionCount(0)
+		, FirstLocation(ForceInitToZero)
+		, FirstTime(0.0f)
+		, SecondLocation(ForceInitToZero)
+		, SecondTime(0.0f)
+	{
+	}
+
+	/** Returns the number of markers used by the distance matching state. */
+	static int32 GetNumMarkers(const EDistanceMatchingType Type);
+
+	bool NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess);
+};
+
+template <>
+struct TStructOpsTypeTraits<FDistanceMatchingReplicatedMarkers> : public TStructOpsTypeTraitsBase2<FDistanceMatchingReplicatedMarkers>
+{
+	enum
+	{
+		WithNetSerializer = true
+	};
+};
+
+/** Distance matching state and markers published at the end of the component update. */
+USTRUCT(BlueprintType)
+struct FDistanceMatchingSnapshot
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly)
+	EDistanceMatchingType DistanceMatchingType;
+
+	UPROPERTY(BlueprintReadOnly)
+	FPredictResult StartMarker;
+
+	UPROPERTY(BlueprintReadOnly)
+	FPredictResult StopMarker;
+
+	UPROPERTY(BlueprintReadOnly)
+	FPredictResult PivotMarker;
+
+	UPROPERTY(BlueprintReadOnly)
+	FPredictResult TakeOffMarker;
+
+	UPROPERTY(BlueprintReadOnly)
+	FPredictResult ApexMarker;
+
+	UPROPERTY(BlueprintReadOnly)
+	FPredictResult LandingMarker;
+
+	FDistanceMatchingSnapshot()
+		: DistanceMatchingType(EDistanceMatchingType::None)
+	{
+	}
+
+	const FPredictResult& GetMarker(const EDistanceMatchingMarker Marker) const
 	{
+		switch (Marker)
+		{
+			case EDistanceMatchingMarker::Start:
+				return StartMarker;
+			case EDistanceMatchingMarker::Stop:
+				return StopMarker;
+			case EDistanceMatchingMarker::Pivot:
+				return PivotMarker;
+			case EDistanceMatchingMarker::TakeOff:
+				return TakeOffMarker;
+			case EDistanceMatchingMarker::Apex:
+				return ApexMarker;
+			default:
+				return LandingMarker;
+		}
 	}
 };
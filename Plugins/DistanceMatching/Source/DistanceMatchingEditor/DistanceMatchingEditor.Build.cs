@@ -21,7 +21,9 @@ public class DistanceMatchingEditor : ModuleRules
 				"AnimationModifiers",
 				"DistanceMatching",
 				"UnrealEd",
-				"BlueprintGraph"
+				"BlueprintGraph",
+				"Json",
+				"AssetRegistry"
 			}
 		);
 	}
@@ -3,6 +3,7 @@
 #include "AnimGraph/AnimGraphNode_DistanceMatching.h"
 #include "EditorCategoryUtils.h"
 #include "Animation/AnimComposite.h"
+#include "Animation/AnimCurveTypes.h"
 #include "Kismet2/CompilerResultsLog.h"
 
 #define LOCTEXT_NAMESPACE "AnimGraphNode_DistanceMatching"
@@ -83,6 +84,15 @@ void UAnimGraphNode_DistanceMatching::ValidateAnimNodeDuringCompilation(USkeleto
 		{
 			MessageLog.Error(TEXT("@@ references sequence that uses different skeleton @@"), this, SeqSkeleton);
 		}
+
+		TArray<float> Times;
+		TArray<float> Values;
+		if (SeqSkeleton && !GetDistanceCurveKeys(SequenceToCheck, Times, Values))
+		{
+			const FText ErrorMessage = FText::Format(
+				LOCTEXT("MissingDistanceCurveError", "@@ references sequence @@ which has no distance curve {0}."), FText::FromName(Node.DistanceCurveName));
+			MessageLog.Error(*ErrorMessage.ToString(), this, SequenceToCheck);
+		}
 	}
 }
 
@@ -100,6 +110,17 @@ void UAnimGraphNode_DistanceMatching::BakeDataDuringCompilation(FCompilerResults
 	Node.GroupName = SyncGroup.GroupName;
 	Node.GroupRole = SyncGroup.GroupRole;
 	Node.Method = SyncGroup.Method;
+
+	// Bake the distance curve, so the node doesn't read it through the sequence curve codec at runtime
+	Node.BakedCurve.Reset();
+
+	UAnimSequenceBase* SequenceToBake = Cast<UAnimSequenceBase>(GetAnimationAsset());
+	TArray<float> Times;
+	TArray<float> Values;
+	if (SequenceToBake && GetDistanceCurveKeys(SequenceToBake, Times, Values))
+	{
+		Node.BakedCurve.Bake(SequenceToBake, Node.DistanceCurveName, Times, Values);
+	}
 }
 
 UAnimationAsset* UAnimGraphNode_DistanceMatching::GetAnimationAsset() const
@@ -165,4 +186,72 @@ void UAnimGraphNode_DistanceMatching::UpdateNodeTitleForSequence(const ENodeTitl
 	CachedNodeTitle.SetCachedText(FText::Format(LOCTEXT("DistanceMatching", "Distance Matching: {SequenceName}"), Args), this);
 }
 
+bool UAnimGraphNode_DistanceMatching::GetDistanceCurveKeys(const UAnimSequenceBase* InSequence, TArray<float>& OutTimes, TArray<float>& OutValues) const
+{
+	const USkeleton* Skeleton = InSequence->GetSkeleton();
+	if (!Skeleton)
+	{
+		return false;
+	}
+
+	FSmartName CurveSmartName;
+	if (!Skeleton->GetSmartNameByName(USkeleton::AnimCurveMappingName, Node.DistanceCurveName, CurveSmartName))
+	{
+		return false;
+	}
+
+	// Source curve data is independent of the curve compression codec
+	const FFloatCurve* Curve = static_cast<const FFloatCurve*>(InSequence->GetCurveData().GetCurveData(CurveSmartName.UID, ERawCurveTrackTypes::RCT_Float));
+	if (!Curve)
+	{
+		return false;
+	}
+
+	const FRichCurve& FloatCurve = Curve->FloatCurve;
+	const TArray<FRichCurveKey>& Keys = FloatCurve.GetConstRefOfKeys();
+	if (Keys.Num() == 0)
+	{
+		return false;
+	}
+
+	// The runtime interpolates the baked keys linearly, the interpolation mode of the last key is never used
+	bool bIsLinear = true;
+	for (int32 Index = 0; Index < Keys.Num() - 1 && bIsLinear; Index++)
+	{
+		bIsLinear = Keys[Index].InterpMode == RCIM_Linear;
+	}
+
+	if (bIsLinear)
+	{
+		OutTimes.Reset(Keys.Num());
+		OutValues.Reset(Keys.Num());
+
+		for (const FRichCurveKey& Key : Keys)
+		{
+			OutTimes.Add(Key.Time);
+			OutValues.Add(Key.Value);
+		}
+
+		return true;
+	}
+
+	// Cubic or constant keys, sample the curve the way the sequence evaluates it at the sampling rate of the sequence
+	const float StartTime = Keys[0].Time;
+	const float EndTime = Keys.Last().Time;
+	const double FrameRate = InSequence->GetSamplingFrameRate().AsDecimal();
+	const int32 NumSamples = FMath::Max(1, FMath::CeilToInt((EndTime - StartTime) * FrameRate)) + 1;
+
+	OutTimes.Reset(NumSamples);
+	OutValues.Reset(NumSamples);
+
+	for (int32 Sample = 0; Sample < NumSamples; Sample++)
+	{
+		const float Time = FMath::Min(StartTime + static_cast<float>(Sample / FrameRate), EndTime);
+		OutTimes.Add(Time);
+		OutValues.Add(FloatCurve.Eval(Time));
+	}
+
+	return true;
+}
+
 #undef LOCTEXT_NAMESPACE
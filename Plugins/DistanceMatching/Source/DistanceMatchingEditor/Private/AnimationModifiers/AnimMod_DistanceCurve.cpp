@@ -2,7 +2,19 @@
 
 #include "AnimationModifiers/AnimMod_DistanceCurve.h"
 #include "Animation/AnimSequence.h"
+#include "Animation/AnimData/AnimDataModel.h"
+#include "Animation/AnimData/IAnimationDataController.h"
 #include "AnimationBlueprintLibrary.h"
+#include "Animation/DistanceCurveCache.h"
+#include "Async/ParallelFor.h"
+
+#define LOCTEXT_NAMESPACE "AnimMod_DistanceCurve"
+
+namespace DistanceCurveModifier
+{
+	// Bump when the curve computation changes, so the source hashes of existing curves don't match anymore
+	constexpr uint32 Version = 1;
+}  // namespace DistanceCurveModifier
 
 UAnimMod_DistanceCurve::UAnimMod_DistanceCurve()
 	: RootBoneName(FName("root"))
@@ -18,41 +30,106 @@ void UAnimMod_DistanceCurve::OnApply_Implementation(UAnimSequence* AnimationSequ
 		return;
 	}
 
-	const bool bCurveExists = UAnimationBlueprintLibrary::DoesCurveExist(AnimationSequence, CurveName, ERawCurveTrackTypes::RCT_Float);
+	FDistanceCurveSource Source;
+	GatherDistanceCurveSource(AnimationSequence, Source);
+	ReadRawRootKeys(Source);
+
+	FDistanceCurveKeys Keys;
+	ComputeDistanceCurveKeys(Source, Keys);
+	WriteDistanceCurveKeys(AnimationSequence, Keys);
+}
 
-	if (bCurveExists)
+void UAnimMod_DistanceCurve::OnRevert_Implementation(UAnimSequence* AnimationSequence)
+{
+	if (!AnimationSequence)
 	{
-		UAnimationBlueprintLibrary::RemoveCurve(AnimationSequence, CurveName, false);
+		return;
 	}
-	UAnimationBlueprintLibrary::AddCurve(AnimationSequence, CurveName, ERawCurveTrackTypes::RCT_Float, false);
 
-	int32 NumFrames;
-	UAnimationBlueprintLibrary::GetNumFrames(AnimationSequence, NumFrames);
+	UAnimationBlueprintLibrary::RemoveCurve(AnimationSequence, CurveName, false);
 
-	const int32 StartIndex = GetStartIndex(AnimationSequence, NumFrames);
+	RecompressAndInvalidate(AnimationSequence);
+}
 
-	if (DistanceMatchingType == EDistanceMatchingType::Start || DistanceMatchingType == EDistanceMatchingType::Pivot)
+void UAnimMod_DistanceCurve::ApplyToSequences(const TArray<UAnimSequence*>& AnimationSequences) const
+{
+	if (DistanceMatchingType == EDistanceMatchingType::None)
 	{
-		SetDistanceCurveKeys(AnimationSequence, StartIndex, NumFrames, false);
+		return;
 	}
-	if (DistanceMatchingType == EDistanceMatchingType::Stop || DistanceMatchingType == EDistanceMatchingType::Pivot)
+
+	TArray<FDistanceCurveSource> Sources;
+	GatherDistanceCurveSources(AnimationSequences, Sources);
+
+	TArray<FDistanceCurveKeys> Keys;
+	Keys.SetNum(AnimationSequences.Num());
+
+	// Raw root tracks are plain data, they're read in parallel together with the key math
+	ParallelFor(AnimationSequences.Num(), [this, &AnimationSequences, &Sources, &Keys](const int32 Index)
+	{
+		if (AnimationSequences[Index])
+		{
+			ReadRawRootKeys(Sources[Index]);
+			ComputeDistanceCurveKeys(Sources[Index], Keys[Index]);
+		}
+	});
+
+	// Data model changes broadcast to the editor, write on the game thread
+	for (int32 Index = 0; Index < AnimationSequences.Num(); Index++)
 	{
-		const float EndIndex = DistanceMatchingType == EDistanceMatchingType::Pivot ? StartIndex : NumFrames;
-		SetDistanceCurveKeys(AnimationSequence, 0, EndIndex, true);
+		if (AnimationSequences[Index])
+		{
+			WriteDistanceCurveKeys(AnimationSequences[Index], Keys[Index]);
+		}
 	}
 }
 
-void UAnimMod_DistanceCurve::OnRevert_Implementation(UAnimSequence* AnimationSequence)
+uint32 UAnimMod_DistanceCurve::GetSourceHash(const UAnimSequence* AnimationSequence) const
 {
 	if (!AnimationSequence)
 	{
-		return;
+		return 0;
 	}
 
-	UAnimationBlueprintLibrary::RemoveCurve(AnimationSequence, CurveName, false);
+	FDistanceCurveSource Source;
+	GatherDistanceCurveSource(AnimationSequence, Source);
+	ReadRawRootKeys(Source);
+
+	return HashDistanceCurveSource(Source);
+}
+
+void UAnimMod_DistanceCurve::GetSourceHashes(const TArray<UAnimSequence*>& AnimationSequences, TArray<uint32>& OutHashes) const
+{
+	TArray<FDistanceCurveSource> Sources;
+	GatherDistanceCurveSources(AnimationSequences, Sources);
+
+	OutHashes.SetNumZeroed(AnimationSequences.Num());
+
+	ParallelFor(AnimationSequences.Num(), [this, &AnimationSequences, &Sources, &OutHashes](const int32 Index)
+	{
+		if (AnimationSequences[Index])
+		{
+			ReadRawRootKeys(Sources[Index]);
+			OutHashes[Index] = HashDistanceCurveSource(Sources[Index]);
+		}
+	});
+}
+
+uint32 UAnimMod_DistanceCurve::HashDistanceCurveSource(const FDistanceCurveSource& Source) const
+{
+	const uint8 Type = static_cast<uint8>(DistanceMatchingType);
+
+	uint32 Hash = FCrc::MemCrc32(&DistanceCurveModifier::Version, sizeof(DistanceCurveModifier::Version));
+	Hash = FCrc::MemCrc32(Source.RootBoneLocations.GetData(), Source.RootBoneLocations.Num() * Source.RootBoneLocations.GetTypeSize(), Hash);
+	Hash = FCrc::MemCrc32(&Source.FrameRate, sizeof(Source.FrameRate), Hash);
+	Hash = FCrc::MemCrc32(&Type, sizeof(Type), Hash);
+	Hash = FCrc::StrCrc32(*RootBoneName.ToString(), Hash);
+	Hash = FCrc::StrCrc32(*CurveName.ToString(), Hash);
+
+	return Hash;
 }
 
-FVector UAnimMod_DistanceCurve::GetRootBoneLocationAtFrame(const TObjectPtr<UAnimSequence> AnimationSequence, const int32 Frame) const
+FVector UAnimMod_DistanceCurve::GetRootBoneLocationAtFrame(const UAnimSequence* AnimationSequence, const int32 Frame) const
 {
 	FTransform Pose;
 	UAnimationBlueprintLibrary::GetBonePoseForFrame(AnimationSequence, RootBoneName, Frame, true, Pose);
@@ -60,42 +137,170 @@ FVector UAnimMod_DistanceCurve::GetRootBoneLocationAtFrame(const TObjectPtr<UAni
 	return Pose.GetLocation();
 }
 
-int32 UAnimMod_DistanceCurve::GetStartIndex(const TObjectPtr<UAnimSequence> AnimationSequence, const int32 NumFrames) const
+const TArray<FVector3f>* UAnimMod_DistanceCurve::FindRawRootKeys(const UAnimSequence* AnimationSequence, const int32 NumFrames) const
+{
+	const UAnimDataModel* DataModel = AnimationSequence->GetDataModel();
+	const FBoneAnimationTrack* BoneTrack = DataModel ? DataModel->FindBoneTrackByName(RootBoneName) : nullptr;
+
+	// Raw keys match the evaluated pose only with one key per frame, or a single key for a bone which doesn't move,
+	// and without root motion extraction or the root lock, which the pose evaluation applies to the root
+	const int32 NumPosKeys = BoneTrack ? BoneTrack->InternalTrackData.PosKeys.Num() : 0;
+	if (AnimationSequence->bEnableRootMotion || AnimationSequence->bForceRootLock || (NumPosKeys != NumFrames + 1 && NumPosKeys != 1))
+	{
+		return nullptr;
+	}
+
+	// Anything else the evaluation applies shows at the ends, evaluate every frame then
+	const TArray<FVector3f>& PosKeys = BoneTrack->InternalTrackData.PosKeys;
+	if (!FVector(PosKeys[0]).Equals(GetRootBoneLocationAtFrame(AnimationSequence, 0), KINDA_SMALL_NUMBER)
+		|| !FVector(PosKeys.Last()).Equals(GetRootBoneLocationAtFrame(AnimationSequence, NumFrames), KINDA_SMALL_NUMBER))
+	{
+		return nullptr;
+	}
+
+	return &PosKeys;
+}
+
+void UAnimMod_DistanceCurve::ReadRawRootKeys(FDistanceCurveSource& Source) const
+{
+	if (!Source.RawRootKeys)
+	{
+		return;
+	}
+
+	const TArray<FVector3f>& PosKeys = *Source.RawRootKeys;
+	const int32 NumLocations = Source.FrameTimes.Num();
+	Source.RootBoneLocations.SetNumUninitialized(NumLocations);
+
+	for (int32 Frame = 0; Frame < NumLocations; Frame++)
+	{
+		Source.RootBoneLocations[Frame] = FVector(PosKeys[PosKeys.Num() == 1 ? 0 : Frame]);
+	}
+}
+
+int32 UAnimMod_DistanceCurve::GetStartIndex(const TArray<FVector>& RootBoneLocations) const
 {
 	if (DistanceMatchingType != EDistanceMatchingType::Pivot)
 	{
 		return 0;
 	}
 
-	FVector PreviousLocation = GetRootBoneLocationAtFrame(AnimationSequence, 0);
-	for (int32 Frame = 1; Frame <= NumFrames; Frame++)
+	for (int32 Frame = 1; Frame < RootBoneLocations.Num(); Frame++)
 	{
-		FVector CurrentLocation = GetRootBoneLocationAtFrame(AnimationSequence, Frame);
-
-		if (CurrentLocation.Size() < PreviousLocation.Size())
+		if (RootBoneLocations[Frame].Size() < RootBoneLocations[Frame - 1].Size())
 		{
 			return Frame - 1;
 		}
-
-		PreviousLocation = CurrentLocation;
 	}
 
 	return 0;
 }
 
-void UAnimMod_DistanceCurve::SetDistanceCurveKeys(const TObjectPtr<UAnimSequence> AnimationSequence, const int32 StartIndex, const int32 EndIndex, const bool bRevert) const
+void UAnimMod_DistanceCurve::GatherDistanceCurveSource(const UAnimSequence* AnimationSequence, FDistanceCurveSource& OutSource) const
 {
-	const FVector StartLocation = GetRootBoneLocationAtFrame(AnimationSequence, StartIndex);
-	const FVector EndLocation = GetRootBoneLocationAtFrame(AnimationSequence, EndIndex);
+	int32 NumFrames;
+	UAnimationBlueprintLibrary::GetNumFrames(AnimationSequence, NumFrames);
+
+	OutSource.FrameRate = AnimationSequence->GetSamplingFrameRate();
+	OutSource.FrameTimes.SetNumUninitialized(NumFrames + 1);
+	for (int32 Frame = 0; Frame <= NumFrames; Frame++)
+	{
+		OutSource.FrameTimes[Frame] = AnimationSequence->GetTimeAtFrame(Frame);
+	}
+
+	// Read later with ReadRawRootKeys, only the poses have to be evaluated here
+	OutSource.RawRootKeys = FindRawRootKeys(AnimationSequence, NumFrames);
+	if (OutSource.RawRootKeys)
+	{
+		return;
+	}
+
+	OutSource.RootBoneLocations.SetNumUninitialized(NumFrames + 1);
+	for (int32 Frame = 0; Frame <= NumFrames; Frame++)
+	{
+		OutSource.RootBoneLocations[Frame] = GetRootBoneLocationAtFrame(AnimationSequence, Frame);
+	}
+}
+
+void UAnimMod_DistanceCurve::GatherDistanceCurveSources(const TArray<UAnimSequence*>& AnimationSequences, TArray<FDistanceCurveSource>& OutSources) const
+{
+	OutSources.SetNum(AnimationSequences.Num());
+	for (int32 Index = 0; Index < AnimationSequences.Num(); Index++)
+	{
+		if (AnimationSequences[Index])
+		{
+			GatherDistanceCurveSource(AnimationSequences[Index], OutSources[Index]);
+		}
+	}
+}
+
+void UAnimMod_DistanceCurve::ComputeDistanceCurveKeys(const FDistanceCurveSource& Source, FDistanceCurveKeys& OutKeys) const
+{
+	const int32 NumFrames = Source.RootBoneLocations.Num() - 1;
+	const int32 StartIndex = GetStartIndex(Source.RootBoneLocations);
+
+	OutKeys.Times.Reset(NumFrames + 1);
+	OutKeys.Values.Reset(NumFrames + 1);
+
+	// Keys are added in time order, the part before the pivot first
+	if (DistanceMatchingType == EDistanceMatchingType::Stop || DistanceMatchingType == EDistanceMatchingType::Pivot)
+	{
+		const int32 EndIndex = DistanceMatchingType == EDistanceMatchingType::Pivot ? StartIndex : NumFrames;
+		AddDistanceCurveKeys(Source, 0, EndIndex, true, OutKeys);
+	}
+	if (DistanceMatchingType == EDistanceMatchingType::Start || DistanceMatchingType == EDistanceMatchingType::Pivot)
+	{
+		AddDistanceCurveKeys(Source, StartIndex, NumFrames, false, OutKeys);
+	}
+}
+
+void UAnimMod_DistanceCurve::AddDistanceCurveKeys(const FDistanceCurveSource& Source, const int32 StartIndex, const int32 EndIndex, const bool bRevert, FDistanceCurveKeys& OutKeys) const
+{
+	const TArray<FVector>& RootBoneLocations = Source.RootBoneLocations;
+	const FVector& StartLocation = RootBoneLocations[StartIndex];
+	const FVector& EndLocation = RootBoneLocations[EndIndex];
 
 	for (int32 Frame = StartIndex; Frame <= EndIndex; Frame++)
 	{
-		float CurrentTime;
-		UAnimationBlueprintLibrary::GetTimeAtFrame(AnimationSequence, Frame, CurrentTime);
-		FVector CurrentLocation = GetRootBoneLocationAtFrame(AnimationSequence, Frame);
+		const float CurrentTime = Source.FrameTimes[Frame];
+		if (OutKeys.Times.Num() > 0 && CurrentTime <= OutKeys.Times.Last())
+		{
+			continue;
+		}
 
+		const FVector& CurrentLocation = RootBoneLocations[Frame];
 		const float Distance = bRevert ? FVector::Distance(CurrentLocation, EndLocation) * -1.0f : FVector::Distance(StartLocation, CurrentLocation);
 
-		UAnimationBlueprintLibrary::AddFloatCurveKey(AnimationSequence, CurveName, CurrentTime, Distance);
+		OutKeys.Times.Add(CurrentTime);
+		OutKeys.Values.Add(Distance);
 	}
 }
+
+void UAnimMod_DistanceCurve::WriteDistanceCurveKeys(UAnimSequence* AnimationSequence, const FDistanceCurveKeys& Keys) const
+{
+	{
+		// One bracket, so the sequence is rebuilt and the editor notified once instead of per key
+		IAnimationDataController& Controller = AnimationSequence->GetController();
+		IAnimationDataController::FScopedBracket ScopedBracket(Controller, LOCTEXT("ApplyDistanceCurve", "Applying distance curve"));
+
+		if (UAnimationBlueprintLibrary::DoesCurveExist(AnimationSequence, CurveName, ERawCurveTrackTypes::RCT_Float))
+		{
+			UAnimationBlueprintLibrary::RemoveCurve(AnimationSequence, CurveName, false);
+		}
+		UAnimationBlueprintLibrary::AddCurve(AnimationSequence, CurveName, ERawCurveTrackTypes::RCT_Float, false);
+		UAnimationBlueprintLibrary::AddFloatCurveKeys(AnimationSequence, CurveName, Keys.Times, Keys.Values);
+	}
+
+	RecompressAndInvalidate(AnimationSequence);
+}
+
+void UAnimMod_DistanceCurve::RecompressAndInvalidate(UAnimSequence* AnimationSequence) const
+{
+	// The model change only requests an async recompression, a node extracting the curve meanwhile would cache the old keys.
+	// Finish the compression first, then drop the cached curves so nodes pick up the new ones.
+	AnimationSequence->RequestSyncAnimRecompression(false);
+
+	FDistanceCurveCache::Get().Invalidate(AnimationSequence);
+}
+
+#undef LOCTEXT_NAMESPACE
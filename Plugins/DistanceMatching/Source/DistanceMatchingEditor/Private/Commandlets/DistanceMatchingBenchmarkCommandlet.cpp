@@ -0,0 +1,418 @@
+// Copyright Roman Merkushin. All Rights Reserved.
+
+#include "Commandlets/DistanceMatchingBenchmarkCommandlet.h"
+#include "DistanceMatchingTimers.h"
+#include "GameFramework/DistanceMatchingComponent.h"
+#include "Animation/AnimInstance.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "Components/StaticMeshComponent.h"
+#include "Dom/JsonObject.h"
+#include "Engine/Engine.h"
+#include "Engine/SkeletalMesh.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/StaticMeshActor.h"
+#include "Engine/World.h"
+#include "GameFramework/Character.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogDistanceMatchingBenchmark, Log, All);
+
+namespace DistanceMatchingBenchmark
+{
+	// Input script: start, stop, start, pivot with a jump, idle
+	constexpr float ScriptDuration = 7.0f;
+	constexpr float StopTime = 2.0f;
+	constexpr float RestartTime = 3.0f;
+	constexpr float PivotTime = 4.0f;
+	constexpr float JumpTime = 5.0f;
+	constexpr float JumpDuration = 0.2f;
+	constexpr float IdleTime = 5.5f;
+
+	constexpr float CharacterSpacing = 400.0f;
+
+	double GetPercentile(const TArray<double>& SortedSamples, const double Percentile)
+	{
+		if (SortedSamples.Num() == 0)
+		{
+			return 0.0;
+		}
+
+		const int32 Index = FMath::Clamp(FMath::CeilToInt(Percentile * SortedSamples.Num()) - 1, 0, SortedSamples.Num() - 1);
+		return SortedSamples[Index];
+	}
+}  // namespace DistanceMatchingBenchmark
+
+UDistanceMatchingBenchmarkCommandlet::UDistanceMatchingBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = true;
+	LogToConsole = true;
+
+	HelpDescription = TEXT("Runs a headless crowd benchmark of the distance matching component and anim node.");
+	HelpUsage = TEXT("-run=DistanceMatchingBenchmark -nullrhi [-Map=] [-CharacterClass=] [-Mesh=] [-AnimClass=] [-Characters=] [-Frames=] [-WarmupFrames=] [-DeltaTime=] [-Seed=] [-BatchTick] [-SleepWhenIdle] [-Output=]");
+}
+
+int32 UDistanceMatchingBenchmarkCommandlet::Main(const FString& Params)
+{
+#if !DISTANCE_MATCHING_TIMERS
+	UE_LOG(LogDistanceMatchingBenchmark, Error, TEXT("Distance matching timers are compiled out in this configuration."));
+	return 1;
+#else
+	FString MapName;
+	FParse::Value(*Params, TEXT("Map="), MapName);
+
+	int32 NumFrames = 600;
+	int32 NumWarmupFrames = 60;
+	float DeltaTime = 1.0f / 30.0f;
+	int32 Seed = 0;
+	FParse::Value(*Params, TEXT("Frames="), NumFrames);
+	FParse::Value(*Params, TEXT("WarmupFrames="), NumWarmupFrames);
+	FParse::Value(*Params, TEXT("DeltaTime="), DeltaTime);
+	FParse::Value(*Params, TEXT("Seed="), Seed);
+
+	FString OutputPath = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("DistanceMatching"), TEXT("Benchmark.json"));
+	FParse::Value(*Params, TEXT("Output="), OutputPath);
+
+	if (NumFrames <= 0 || DeltaTime <= 0.0f)
+	{
+		UE_LOG(LogDistanceMatchingBenchmark, Error, TEXT("Frames and DeltaTime must be positive."));
+		return 1;
+	}
+
+	UWorld* World = CreateWorld(MapName);
+	if (!World)
+	{
+		return 1;
+	}
+
+	FRandomStream RandomStream(Seed);
+	TArray<FScriptedCharacter> Characters;
+	if (!SpawnCharacters(World, Params, RandomStream, Characters))
+	{
+		DestroyWorld(World);
+		return 1;
+	}
+
+	World->BeginPlay();
+
+	TArray<FTimerSamples> Timers;
+	Timers.SetNum(static_cast<int32>(EDistanceMatchingTimer::Num) + 1);
+	for (uint8 TimerIndex = 0; TimerIndex < static_cast<uint8>(EDistanceMatchingTimer::Num); TimerIndex++)
+	{
+		Timers[TimerIndex].Name = FDistanceMatchingTimers::GetName(static_cast<EDistanceMatchingTimer>(TimerIndex));
+	}
+	FTimerSamples& FrameTimer = Timers.Last();
+	FrameTimer.Name = TEXT("Frame");
+
+	UE_LOG(LogDistanceMatchingBenchmark, Display, TEXT("Running %d frames with %d characters..."), NumFrames, Characters.Num());
+
+	FDistanceMatchingTimers::SetEnabled(true);
+
+	float Time = 0.0f;
+	for (int32 FrameIndex = 0; FrameIndex < NumWarmupFrames + NumFrames; FrameIndex++)
+	{
+		DriveCharacters(Characters, Time);
+
+		FDistanceMatchingTimers::Reset();
+		FApp::SetDeltaTime(DeltaTime);
+		FApp::SetCurrentTime(FApp::GetCurrentTime() + DeltaTime);
+
+		const uint64 FrameStartCycles = FPlatformTime::Cycles64();
+		World->Tick(LEVELTICK_All, DeltaTime);
+		const uint64 FrameCycles = FPlatformTime::Cycles64() - FrameStartCycles;
+
+		GFrameCounter++;
+		Time += DeltaTime;
+
+		if (FrameIndex < NumWarmupFrames)
+		{
+			continue;
+		}
+
+		for (uint8 TimerIndex = 0; TimerIndex < static_cast<uint8>(EDistanceMatchingTimer::Num); TimerIndex++)
+		{
+			Timers[TimerIndex].Samples.Add(FDistanceMatchingTimers::GetMilliseconds(static_cast<EDistanceMatchingTimer>(TimerIndex)));
+		}
+		FrameTimer.Samples.Add(FPlatformTime::ToMilliseconds64(FrameCycles));
+	}
+
+	FDistanceMatchingTimers::SetEnabled(false);
+
+	// A crowd without the anim node measures the component only, the report would look complete anyway
+	const TArray<double>& UpdateAssetPlayerSamples = Timers[static_cast<uint8>(EDistanceMatchingTimer::UpdateAssetPlayer)].Samples;
+	if (!UpdateAssetPlayerSamples.ContainsByPredicate([](const double Sample) { return Sample > 0.0; }))
+	{
+		UE_LOG(LogDistanceMatchingBenchmark, Error, TEXT("No DistanceMatching anim node was updated, pass -AnimClass= or a -CharacterClass= with an anim blueprint using it."));
+		DestroyWorld(World);
+		return 1;
+	}
+
+	const bool bWritten = WriteReport(OutputPath, Params, Characters.Num(), Timers);
+
+	DestroyWorld(World);
+
+	return bWritten ? 0 : 1;
+#endif
+}
+
+UWorld* UDistanceMatchingBenchmarkCommandlet::CreateWorld(const FString& MapName) const
+{
+	UWorld* World = nullptr;
+
+	if (!MapName.IsEmpty())
+	{
+		UPackage* Package = LoadPackage(nullptr, *MapName, LOAD_None);
+		World = Package ? UWorld::FindWorldInPackage(Package) : nullptr;
+		if (!World)
+		{
+			UE_LOG(LogDistanceMatchingBenchmark, Error, TEXT("Can't load map %s."), *MapName);
+			return nullptr;
+		}
+
+		World->WorldType = EWorldType::Game;
+		if (!World->bIsWorldInitialized)
+		{
+			World->InitWorld();
+		}
+	}
+	else
+	{
+		World = UWorld::CreateWorld(EWorldType::Game, false);
+	}
+
+	World->AddToRoot();
+
+	FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+	WorldContext.SetCurrentWorld(World);
+
+	const FURL URL;
+	World->SetGameMode(URL);
+	World->InitializeActorsForPlay(URL);
+
+	if (MapName.IsEmpty())
+	{
+		// Floor large enough for the whole crowd
+		UStaticMesh* CubeMesh = LoadObject<UStaticMesh>(nullptr, TEXT("/Engine/BasicShapes/Cube.Cube"));
+		const FTransform FloorTransform(FQuat::Identity, FVector(0.0f, 0.0f, -50.0f), FVector(1000.0f, 1000.0f, 1.0f));
+
+		AStaticMeshActor* Floor = World->SpawnActorDeferred<AStaticMeshActor>(AStaticMeshActor::StaticClass(), FloorTransform);
+		if (!CubeMesh || !Floor)
+		{
+			UE_LOG(LogDistanceMatchingBenchmark, Error, TEXT("Can't create the floor."));
+			DestroyWorld(World);
+			return nullptr;
+		}
+
+		Floor->GetStaticMeshComponent()->SetStaticMesh(CubeMesh);
+		Floor->FinishSpawning(FloorTransform);
+	}
+
+	return World;
+}
+
+void UDistanceMatchingBenchmarkCommandlet::DestroyWorld(UWorld* World) const
+{
+	GEngine->DestroyWorldContext(World);
+	World->DestroyWorld(false);
+	World->RemoveFromRoot();
+
+	CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+}
+
+bool UDistanceMatchingBenchmarkCommandlet::SpawnCharacters(UWorld* World, const FString& Params, FRandomStream& RandomStream, TArray<FScriptedCharacter>& OutCharacters) const
+{
+	int32 NumCharacters = 64;
+	FParse::Value(*Params, TEXT("Characters="), NumCharacters);
+
+	UClass* CharacterClass = ACharacter::StaticClass();
+	FString CharacterClassName;
+	if (FParse::Value(*Params, TEXT("CharacterClass="), CharacterClassName))
+	{
+		CharacterClass = LoadClass<ACharacter>(nullptr, *CharacterClassName);
+		if (!CharacterClass)
+		{
+			UE_LOG(LogDistanceMatchingBenchmark, Error, TEXT("Can't load character class %s."), *CharacterClassName);
+			return false;
+		}
+	}
+
+	USkeletalMesh* Mesh = nullptr;
+	FString MeshName;
+	if (FParse::Value(*Params, TEXT("Mesh="), MeshName))
+	{
+		Mesh = LoadObject<USkeletalMesh>(nullptr, *MeshName);
+		if (!Mesh)
+		{
+			UE_LOG(LogDistanceMatchingBenchmark, Error, TEXT("Can't load skeletal mesh %s."), *MeshName);
+			return false;
+		}
+	}
+
+	UClass* AnimClass = nullptr;
+	FString AnimClassName;
+	if (FParse::Value(*Params, TEXT("AnimClass="), AnimClassName))
+	{
+		AnimClass = LoadClass<UAnimInstance>(nullptr, *AnimClassName);
+		if (!AnimClass)
+		{
+			UE_LOG(LogDistanceMatchingBenchmark, Error, TEXT("Can't load anim class %s."), *AnimClassName);
+			return false;
+		}
+	}
+
+	if (!AnimClass && CharacterClass == ACharacter::StaticClass())
+	{
+		UE_LOG(LogDistanceMatchingBenchmark, Warning, TEXT("Neither -AnimClass= nor -CharacterClass= is set, plain characters don't run the DistanceMatching anim node."));
+	}
+
+	const bool bUseBatchTick = FParse::Param(*Params, TEXT("BatchTick"));
+	const bool bSleepWhenIdle = FParse::Param(*Params, TEXT("SleepWhenIdle"));
+
+	FActorSpawnParameters SpawnParameters;
+	SpawnParameters.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+	const int32 GridSize = FMath::CeilToInt(FMath::Sqrt(static_cast<float>(NumCharacters)));
+	const float GridOffset = (GridSize - 1) * DistanceMatchingBenchmark::CharacterSpacing * 0.5f;
+
+	for (int32 Index = 0; Index < NumCharacters; Index++)
+	{
+		const FVector Location((Index % GridSize) * DistanceMatchingBenchmark::CharacterSpacing - GridOffset, (Index / GridSize) * DistanceMatchingBenchmark::CharacterSpacing - GridOffset, 100.0f);
+
+		ACharacter* Character = World->SpawnActor<ACharacter>(CharacterClass, Location, FRotator::ZeroRotator, SpawnParameters);
+		if (!Character)
+		{
+			UE_LOG(LogDistanceMatchingBenchmark, Error, TEXT("Can't spawn character %d."), Index);
+			return false;
+		}
+
+		USkeletalMeshComponent* MeshComponent = Character->GetMesh();
+		if (Mesh)
+		{
+			MeshComponent->SetSkeletalMesh(Mesh);
+		}
+		if (AnimClass)
+		{
+			MeshComponent->SetAnimInstanceClass(AnimClass);
+		}
+
+		// Nothing is rendered with -nullrhi, animation must update regardless
+		MeshComponent->VisibilityBasedAnimTickOption = EVisibilityBasedAnimTickOption::AlwaysTickPoseAndRefreshBones;
+
+		UDistanceMatchingComponent* DistanceMatchingComponent = Character->FindComponentByClass<UDistanceMatchingComponent>();
+		if (!DistanceMatchingComponent)
+		{
+			DistanceMatchingComponent = NewObject<UDistanceMatchingComponent>(Character);
+			DistanceMatchingComponent->RegisterComponent();
+		}
+
+		// Read in BeginPlay, the world hasn't begun play yet
+		DistanceMatchingComponent->bUseBatchTick = bUseBatchTick;
+		DistanceMatchingComponent->bSleepWhenIdle = bSleepWhenIdle;
+
+		Character->SpawnDefaultController();
+
+		FScriptedCharacter& ScriptedCharacter = OutCharacters.AddDefaulted_GetRef();
+		ScriptedCharacter.Character = Character;
+		ScriptedCharacter.ScriptOffset = RandomStream.FRandRange(0.0f, DistanceMatchingBenchmark::ScriptDuration);
+		ScriptedCharacter.Direction = FRotator(0.0f, RandomStream.FRandRange(0.0f, 360.0f), 0.0f).Vector();
+	}
+
+	return true;
+}
+
+void UDistanceMatchingBenchmarkCommandlet::DriveCharacters(const TArray<FScriptedCharacter>& Characters, const float Time) const
+{
+	for (const FScriptedCharacter& ScriptedCharacter : Characters)
+	{
+		ACharacter* Character = ScriptedCharacter.Character;
+		const float ScriptTime = FMath::Fmod(Time + ScriptedCharacter.ScriptOffset, DistanceMatchingBenchmark::ScriptDuration);
+
+		if (ScriptTime < DistanceMatchingBenchmark::StopTime || (ScriptTime >= DistanceMatchingBenchmark::RestartTime && ScriptTime < DistanceMatchingBenchmark::PivotTime))
+		{
+			Character->AddMovementInput(ScriptedCharacter.Direction);
+		}
+		else if (ScriptTime >= DistanceMatchingBenchmark::PivotTime && ScriptTime < DistanceMatchingBenchmark::IdleTime)
+		{
+			Character->AddMovementInput(-ScriptedCharacter.Direction);
+		}
+
+		if (ScriptTime >= DistanceMatchingBenchmark::JumpTime && ScriptTime < DistanceMatchingBenchmark::JumpTime + DistanceMatchingBenchmark::JumpDuration)
+		{
+			Character->Jump();
+		}
+		else
+		{
+			Character->StopJumping();
+		}
+	}
+}
+
+bool UDistanceMatchingBenchmarkCommandlet::WriteReport(const FString& OutputPath, const FString& Params, const int32 NumCharacters, TArray<FTimerSamples>& Timers) const
+{
+	for (FTimerSamples& Timer : Timers)
+	{
+		Timer.Samples.Sort();
+	}
+
+	auto GetMean = [](const TArray<double>& Samples)
+	{
+		double Sum = 0.0;
+		for (const double Sample : Samples)
+		{
+			Sum += Sample;
+		}
+		return Samples.Num() > 0 ? Sum / Samples.Num() : 0.0;
+	};
+
+	FString Report;
+
+	if (FPaths::GetExtension(OutputPath) == TEXT("csv"))
+	{
+		Report = TEXT("Scope,Mean,P50,P90,P99,Max\n");
+		for (const FTimerSamples& Timer : Timers)
+		{
+			Report += FString::Printf(TEXT("%s,%f,%f,%f,%f,%f\n"), *Timer.Name, GetMean(Timer.Samples), DistanceMatchingBenchmark::GetPercentile(Timer.Samples, 0.5), DistanceMatchingBenchmark::GetPercentile(Timer.Samples, 0.9), DistanceMatchingBenchmark::GetPercentile(Timer.Samples, 0.99), DistanceMatchingBenchmark::GetPercentile(Timer.Samples, 1.0));
+		}
+	}
+	else
+	{
+		const TSharedRef<FJsonObject> RootObject = MakeShared<FJsonObject>();
+		RootObject->SetNumberField(TEXT("Characters"), NumCharacters);
+		RootObject->SetNumberField(TEXT("Frames"), Timers.Last().Samples.Num());
+		RootObject->SetStringField(TEXT("Params"), Params);
+
+		const TSharedRef<FJsonObject> TimersObject = MakeShared<FJsonObject>();
+		for (const FTimerSamples& Timer : Timers)
+		{
+			const TSharedRef<FJsonObject> TimerObject = MakeShared<FJsonObject>();
+			TimerObject->SetNumberField(TEXT("Mean"), GetMean(Timer.Samples));
+			TimerObject->SetNumberField(TEXT("P50"), DistanceMatchingBenchmark::GetPercentile(Timer.Samples, 0.5));
+			TimerObject->SetNumberField(TEXT("P90"), DistanceMatchingBenchmark::GetPercentile(Timer.Samples, 0.9));
+			TimerObject->SetNumberField(TEXT("P99"), DistanceMatchingBenchmark::GetPercentile(Timer.Samples, 0.99));
+			TimerObject->SetNumberField(TEXT("Max"), DistanceMatchingBenchmark::GetPercentile(Timer.Samples, 1.0));
+			TimersObject->SetObjectField(Timer.Name, TimerObject);
+		}
+		RootObject->SetObjectField(TEXT("TimersMs"), TimersObject);
+
+		const TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Report);
+		FJsonSerializer::Serialize(RootObject, Writer);
+	}
+
+	if (!FFileHelper::SaveStringToFile(Report, *OutputPath))
+	{
+		UE_LOG(LogDistanceMatchingBenchmark, Error, TEXT("Can't write the report to %s."), *OutputPath);
+		return false;
+	}
+
+	UE_LOG(LogDistanceMatchingBenchmark, Display, TEXT("Report written to %s."), *OutputPath);
+	for (const FTimerSamples& Timer : Timers)
+	{
+		UE_LOG(LogDistanceMatchingBenchmark, Display, TEXT("%-20s p50 %.4f ms, p99 %.4f ms"), *Timer.Name, DistanceMatchingBenchmark::GetPercentile(Timer.Samples, 0.5), DistanceMatchingBenchmark::GetPercentile(Timer.Samples, 0.99));
+	}
+
+	return true;
+}
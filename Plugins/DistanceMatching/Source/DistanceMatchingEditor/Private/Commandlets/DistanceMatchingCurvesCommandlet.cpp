@@ -0,0 +1,339 @@
+// Copyright Roman Merkushin. All Rights Reserved.
+
+#include "Commandlets/DistanceMatchingCurvesCommandlet.h"
+#include "AnimationModifiers/AnimMod_DistanceCurve.h"
+#include "Animation/AnimSequence.h"
+#include "AnimationBlueprintLibrary.h"
+#include "AssetRegistry/AssetRegistryModule.h"
+#include "Dom/JsonObject.h"
+#include "FileHelpers.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+#include "UObject/UObjectGlobals.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogDistanceMatchingCurves, Log, All);
+
+UDistanceMatchingCurvesCommandlet::UDistanceMatchingCurvesCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = true;
+	LogToConsole = true;
+
+	HelpDescription = TEXT("Generates distance curves for all animation sequences matching the filter, skipping unchanged ones.");
+	HelpUsage = TEXT("-run=DistanceMatchingCurves [-Path=] [-Filter=] [-Type=Auto|Start|Stop|Pivot] [-CurveName=] [-RootBone=] [-BatchSize=] [-Manifest=] [-Force] [-NoSave]");
+}
+
+int32 UDistanceMatchingCurvesCommandlet::Main(const FString& Params)
+{
+	FString PackagePath = TEXT("/Game");
+	FString Filter = TEXT("*");
+	FString TypeName = TEXT("Auto");
+	FString CurveName = TEXT("Distance");
+	FString RootBoneName = TEXT("root");
+	int32 BatchSize = 64;
+	FString ManifestPath = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("DistanceMatching"), TEXT("CurveManifest.json"));
+
+	FParse::Value(*Params, TEXT("Path="), PackagePath);
+	FParse::Value(*Params, TEXT("Filter="), Filter);
+	FParse::Value(*Params, TEXT("Type="), TypeName);
+	FParse::Value(*Params, TEXT("CurveName="), CurveName);
+	FParse::Value(*Params, TEXT("RootBone="), RootBoneName);
+	FParse::Value(*Params, TEXT("BatchSize="), BatchSize);
+	FParse::Value(*Params, TEXT("Manifest="), ManifestPath);
+	const bool bForce = FParse::Param(*Params, TEXT("Force"));
+	const bool bNoSave = FParse::Param(*Params, TEXT("NoSave"));
+	BatchSize = FMath::Max(BatchSize, 1);
+
+	// None stands for the type taken from the sequence name
+	EDistanceMatchingType Type = EDistanceMatchingType::None;
+	if (TypeName != TEXT("Auto"))
+	{
+		const int64 TypeValue = StaticEnum<EDistanceMatchingType>()->GetValueByNameString(TypeName);
+		if (TypeValue == INDEX_NONE || TypeValue == static_cast<int64>(EDistanceMatchingType::None))
+		{
+			UE_LOG(LogDistanceMatchingCurves, Error, TEXT("Unknown distance matching type %s."), *TypeName);
+			return 1;
+		}
+		Type = static_cast<EDistanceMatchingType>(TypeValue);
+	}
+
+	for (const EDistanceMatchingType ModifierType : {EDistanceMatchingType::Start, EDistanceMatchingType::Stop, EDistanceMatchingType::Pivot})
+	{
+		UAnimMod_DistanceCurve* Modifier = NewObject<UAnimMod_DistanceCurve>(this);
+		Modifier->RootBoneName = FName(*RootBoneName);
+		Modifier->CurveName = FName(*CurveName);
+		Modifier->DistanceMatchingType = ModifierType;
+		Modifiers.Add(ModifierType, Modifier);
+	}
+
+	// Find the sequences
+	const double ScanStartTime = FPlatformTime::Seconds();
+
+	IAssetRegistry& AssetRegistry = FModuleManager::LoadModuleChecked<FAssetRegistryModule>(TEXT("AssetRegistry")).Get();
+	AssetRegistry.SearchAllAssets(true);
+
+	FARFilter AssetFilter;
+	AssetFilter.ClassNames.Add(UAnimSequence::StaticClass()->GetFName());
+	AssetFilter.PackagePaths.Add(FName(*PackagePath));
+	AssetFilter.bRecursivePaths = true;
+
+	TArray<FAssetData> FoundAssets;
+	AssetRegistry.GetAssets(AssetFilter, FoundAssets);
+
+	TArray<FAssetData> Assets;
+	TArray<EDistanceMatchingType> AssetTypes;
+	for (const FAssetData& Asset : FoundAssets)
+	{
+		const FString AssetName = Asset.AssetName.ToString();
+		const EDistanceMatchingType AssetType = GetSequenceType(AssetName, Type);
+		if (AssetType != EDistanceMatchingType::None && AssetName.MatchesWildcard(Filter))
+		{
+			Assets.Add(Asset);
+			AssetTypes.Add(AssetType);
+		}
+	}
+
+	const double ScanTime = FPlatformTime::Seconds() - ScanStartTime;
+	UE_LOG(LogDistanceMatchingCurves, Display, TEXT("Found %d sequences to check in %s."), Assets.Num(), *PackagePath);
+
+	TMap<FString, uint32> Hashes;
+	LoadManifest(ManifestPath, Hashes);
+
+	int32 NumUpToDate = 0;
+	int32 NumProcessed = 0;
+	int32 NumFailed = 0;
+	double LoadTime = 0.0;
+	double HashTime = 0.0;
+	double ApplyTime = 0.0;
+	double SaveTime = 0.0;
+
+	// Packages of the next batch load in the background while the current one is processed
+	auto RequestBatch = [&Assets, BatchSize](const int32 BatchStart, TArray<int32>& OutRequestIds)
+	{
+		OutRequestIds.Reset();
+		for (int32 Index = BatchStart; Index < FMath::Min(BatchStart + BatchSize, Assets.Num()); Index++)
+		{
+			OutRequestIds.Add(LoadPackageAsync(Assets[Index].PackageName.ToString()));
+		}
+	};
+
+	TArray<int32> LoadRequestIds;
+	RequestBatch(0, LoadRequestIds);
+
+	for (int32 BatchStart = 0; BatchStart < Assets.Num(); BatchStart += BatchSize)
+	{
+		const int32 BatchEnd = FMath::Min(BatchStart + BatchSize, Assets.Num());
+		const int32 BatchNum = BatchEnd - BatchStart;
+
+		// Only the loads which haven't finished while the previous batch was processed are waited for
+		double StartTime = FPlatformTime::Seconds();
+
+		for (const int32 RequestId : LoadRequestIds)
+		{
+			FlushAsyncLoading(RequestId);
+		}
+
+		TArray<UAnimSequence*> Sequences;
+		Sequences.SetNumZeroed(BatchNum);
+		for (int32 Index = 0; Index < BatchNum; Index++)
+		{
+			Sequences[Index] = Cast<UAnimSequence>(Assets[BatchStart + Index].GetAsset());
+			if (!Sequences[Index])
+			{
+				UE_LOG(LogDistanceMatchingCurves, Warning, TEXT("Can't load %s."), *Assets[BatchStart + Index].ObjectPath.ToString());
+				NumFailed++;
+			}
+		}
+
+		RequestBatch(BatchEnd, LoadRequestIds);
+
+		LoadTime += FPlatformTime::Seconds() - StartTime;
+		StartTime = FPlatformTime::Seconds();
+
+		// Pose evaluation stays on the game thread, raw root tracks are read and hashed in parallel
+		TMap<EDistanceMatchingType, TArray<int32>> IndicesByType;
+		for (int32 Index = 0; Index < BatchNum; Index++)
+		{
+			if (Sequences[Index])
+			{
+				IndicesByType.FindOrAdd(AssetTypes[BatchStart + Index]).Add(Index);
+			}
+		}
+
+		TArray<uint32> SourceHashes;
+		SourceHashes.SetNumZeroed(BatchNum);
+		for (const TPair<EDistanceMatchingType, TArray<int32>>& TypeIndices : IndicesByType)
+		{
+			TArray<UAnimSequence*> TypeSequences;
+			for (const int32 Index : TypeIndices.Value)
+			{
+				TypeSequences.Add(Sequences[Index]);
+			}
+
+			TArray<uint32> TypeHashes;
+			Modifiers[TypeIndices.Key]->GetSourceHashes(TypeSequences, TypeHashes);
+
+			for (int32 TypeIndex = 0; TypeIndex < TypeIndices.Value.Num(); TypeIndex++)
+			{
+				SourceHashes[TypeIndices.Value[TypeIndex]] = TypeHashes[TypeIndex];
+			}
+		}
+
+		// Sequences which changed since the last run, or lost the curve
+		TMap<EDistanceMatchingType, TArray<UAnimSequence*>> SequencesByType;
+		TArray<int32> ChangedIndices;
+		for (int32 Index = 0; Index < BatchNum; Index++)
+		{
+			if (!Sequences[Index])
+			{
+				continue;
+			}
+
+			const uint32* PreviousHash = Hashes.Find(Assets[BatchStart + Index].PackageName.ToString());
+			if (!bForce && PreviousHash && *PreviousHash == SourceHashes[Index] && UAnimationBlueprintLibrary::DoesCurveExist(Sequences[Index], FName(*CurveName), ERawCurveTrackTypes::RCT_Float))
+			{
+				NumUpToDate++;
+				continue;
+			}
+
+			SequencesByType.FindOrAdd(AssetTypes[BatchStart + Index]).Add(Sequences[Index]);
+			ChangedIndices.Add(Index);
+		}
+
+		HashTime += FPlatformTime::Seconds() - StartTime;
+		StartTime = FPlatformTime::Seconds();
+
+		for (const TPair<EDistanceMatchingType, TArray<UAnimSequence*>>& TypeSequences : SequencesByType)
+		{
+			Modifiers[TypeSequences.Key]->ApplyToSequences(TypeSequences.Value);
+		}
+
+		ApplyTime += FPlatformTime::Seconds() - StartTime;
+		StartTime = FPlatformTime::Seconds();
+
+		bool bSaved = true;
+		if (!bNoSave && ChangedIndices.Num() > 0)
+		{
+			TArray<UPackage*> Packages;
+			for (const int32 Index : ChangedIndices)
+			{
+				Packages.Add(Sequences[Index]->GetOutermost());
+			}
+
+			bSaved = UEditorLoadingAndSavingUtils::SavePackages(Packages, false);
+			if (!bSaved)
+			{
+				UE_LOG(LogDistanceMatchingCurves, Error, TEXT("Failed to save some of %d packages, their hashes are not recorded."), Packages.Num());
+			}
+		}
+
+		for (const int32 Index : ChangedIndices)
+		{
+			const bool bSequenceSaved = bNoSave || bSaved || !Sequences[Index]->GetOutermost()->IsDirty();
+			if (bSequenceSaved && !bNoSave)
+			{
+				Hashes.Add(Assets[BatchStart + Index].PackageName.ToString(), SourceHashes[Index]);
+			}
+
+			NumProcessed += bSequenceSaved ? 1 : 0;
+			NumFailed += bSequenceSaved ? 0 : 1;
+		}
+
+		SaveTime += FPlatformTime::Seconds() - StartTime;
+
+		UE_LOG(LogDistanceMatchingCurves, Display, TEXT("Checked %d/%d sequences, %d updated."), BatchEnd, Assets.Num(), NumProcessed);
+
+		CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+	}
+
+	if (!bNoSave)
+	{
+		SaveManifest(ManifestPath, Hashes);
+	}
+
+	const double TotalTime = ScanTime + LoadTime + HashTime + ApplyTime + SaveTime;
+
+	UE_LOG(LogDistanceMatchingCurves, Display, TEXT("Sequences: %d checked, %d updated, %d up to date, %d failed."), Assets.Num(), NumProcessed, NumUpToDate, NumFailed);
+	UE_LOG(LogDistanceMatchingCurves, Display, TEXT("Time: scan %.2f s, load %.2f s, hash %.2f s, apply %.2f s, save %.2f s, total %.2f s."), ScanTime, LoadTime, HashTime, ApplyTime, SaveTime, TotalTime);
+	UE_LOG(LogDistanceMatchingCurves, Display, TEXT("Throughput: %.1f sequences/s checked, %.1f sequences/s updated."), TotalTime > 0.0 ? Assets.Num() / TotalTime : 0.0, ApplyTime + SaveTime > 0.0 ? NumProcessed / (ApplyTime + SaveTime) : 0.0);
+
+	return NumFailed > 0 ? 1 : 0;
+}
+
+EDistanceMatchingType UDistanceMatchingCurvesCommandlet::GetSequenceType(const FString& AssetName, const EDistanceMatchingType Type) const
+{
+	if (Type != EDistanceMatchingType::None)
+	{
+		return Type;
+	}
+
+	// Pivot first, pivot sequences often contain start or stop in the name too
+	if (AssetName.Contains(TEXT("Pivot")))
+	{
+		return EDistanceMatchingType::Pivot;
+	}
+	if (AssetName.Contains(TEXT("Stop")))
+	{
+		return EDistanceMatchingType::Stop;
+	}
+	if (AssetName.Contains(TEXT("Start")))
+	{
+		return EDistanceMatchingType::Start;
+	}
+
+	return EDistanceMatchingType::None;
+}
+
+void UDistanceMatchingCurvesCommandlet::LoadManifest(const FString& ManifestPath, TMap<FString, uint32>& OutHashes) const
+{
+	FString ManifestString;
+	if (!FFileHelper::LoadFileToString(ManifestString, *ManifestPath))
+	{
+		return;
+	}
+
+	TSharedPtr<FJsonObject> RootObject;
+	const TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(ManifestString);
+	if (!FJsonSerializer::Deserialize(Reader, RootObject) || !RootObject.IsValid())
+	{
+		UE_LOG(LogDistanceMatchingCurves, Warning, TEXT("Can't parse manifest %s, all sequences will be updated."), *ManifestPath);
+		return;
+	}
+
+	const TSharedPtr<FJsonObject>* HashesObject;
+	if (RootObject->TryGetObjectField(TEXT("Hashes"), HashesObject))
+	{
+		for (const TPair<FString, TSharedPtr<FJsonValue>>& Entry : (*HashesObject)->Values)
+		{
+			OutHashes.Add(Entry.Key, static_cast<uint32>(Entry.Value->AsNumber()));
+		}
+	}
+}
+
+bool UDistanceMatchingCurvesCommandlet::SaveManifest(const FString& ManifestPath, const TMap<FString, uint32>& Hashes) const
+{
+	const TSharedRef<FJsonObject> HashesObject = MakeShared<FJsonObject>();
+	for (const TPair<FString, uint32>& Entry : Hashes)
+	{
+		HashesObject->SetNumberField(Entry.Key, Entry.Value);
+	}
+
+	const TSharedRef<FJsonObject> RootObject = MakeShared<FJsonObject>();
+	RootObject->SetObjectField(TEXT("Hashes"), HashesObject);
+
+	FString ManifestString;
+	const TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&ManifestString);
+	FJsonSerializer::Serialize(RootObject, Writer);
+
+	if (!FFileHelper::SaveStringToFile(ManifestString, *ManifestPath))
+	{
+		UE_LOG(LogDistanceMatchingCurves, Error, TEXT("Can't write manifest %s."), *ManifestPath);
+		return false;
+	}
+
+	return true;
+}
@@ -46,4 +46,10 @@ public:
 
 private:
 	void UpdateNodeTitleForSequence(const ENodeTitleType::Type TitleType, const UAnimSequenceBase* InSequence) const;
+
+	/**
+	* Reads the keys of the distance curve from the sequence source data. Curves with non-linear keys are sampled at the sampling rate
+	* of the sequence instead, so the linearly interpolated bake matches the curve the sequence evaluates. Returns false if the sequence has no such curve.
+	*/
+	bool GetDistanceCurveKeys(const UAnimSequenceBase* InSequence, TArray<float>& OutTimes, TArray<float>& OutValues) const;
 };
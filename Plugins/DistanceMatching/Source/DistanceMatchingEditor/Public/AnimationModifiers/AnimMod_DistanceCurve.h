@@ -4,6 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "AnimationModifier.h"
+#include "Misc/FrameRate.h"
 #include "GameFramework/DistanceMatchingTypes.h"
 #include "AnimMod_DistanceCurve.generated.h"
 
@@ -27,13 +28,76 @@ public:
 	virtual void OnApply_Implementation(UAnimSequence* AnimationSequence) override;
 	virtual void OnRevert_Implementation(UAnimSequence* AnimationSequence) override;
 
+	/**
+	* Write the distance curves with the settings of this modifier to all sequences. Poses are evaluated on the game thread, raw root
+	* tracks are read and the keys are computed in parallel. The modifier is not added to the modifier stacks of the sequences.
+	*/
+	UFUNCTION(BlueprintCallable, Category = "DistanceMatching")
+	void ApplyToSequences(const TArray<UAnimSequence*>& AnimationSequences) const;
+
+	/**
+	* Returns a hash of the inputs of the distance curve: the root bone motion of the sequence and the settings of this modifier.
+	* May evaluate the pose of the sequence, so it must be called from the game thread.
+	*/
+	uint32 GetSourceHash(const UAnimSequence* AnimationSequence) const;
+
+	/** Returns the source hashes of all sequences, raw root tracks are read and hashed in parallel. Must be called from the game thread. */
+	void GetSourceHashes(const TArray<UAnimSequence*>& AnimationSequences, TArray<uint32>& OutHashes) const;
+
 private:
+	/** Root bone motion of a sequence, everything the distance curve keys are computed from. */
+	struct FDistanceCurveSource
+	{
+		/** Root bone location of each frame, including the last one. */
+		TArray<FVector> RootBoneLocations;
+
+		/** Time of each frame. */
+		TArray<float> FrameTimes;
+
+		/** Sampling frame rate of the sequence. */
+		FFrameRate FrameRate;
+
+		/** Raw root bone track the locations are read from off the game thread, nullptr if they're evaluated from the pose. */
+		const TArray<FVector3f>* RawRootKeys = nullptr;
+	};
+
+	/** Keys of the distance curve computed for a sequence. */
+	struct FDistanceCurveKeys
+	{
+		TArray<float> Times;
+		TArray<float> Values;
+	};
+
 	/** Returns location for the root bone at the specified Frame from the given Animation Sequence. */
-	FVector GetRootBoneLocationAtFrame(const TObjectPtr<UAnimSequence> AnimationSequence, const int32 Frame) const;
+	FVector GetRootBoneLocationAtFrame(const UAnimSequence* AnimationSequence, const int32 Frame) const;
+
+	/** Returns the raw root bone track if its keys match the evaluated pose of every frame, nullptr otherwise. Must be called from the game thread. */
+	const TArray<FVector3f>* FindRawRootKeys(const UAnimSequence* AnimationSequence, const int32 NumFrames) const;
+
+	/** Copies the root bone locations of all frames from the raw track of the source, if it has one. Safe to run in parallel. */
+	void ReadRawRootKeys(FDistanceCurveSource& Source) const;
 
 	/** Returns the frame index with zero distance. */
-	int32 GetStartIndex(const TObjectPtr<UAnimSequence> AnimationSequence, const int32 NumFrames) const;
+	int32 GetStartIndex(const TArray<FVector>& RootBoneLocations) const;
+
+	/** Reads the frames of the sequence and evaluates the root bone poses the raw track can't replace. Must be called from the game thread. */
+	void GatherDistanceCurveSource(const UAnimSequence* AnimationSequence, FDistanceCurveSource& OutSource) const;
+
+	/** Gathers the sources of all sequences, empty for null ones. */
+	void GatherDistanceCurveSources(const TArray<UAnimSequence*>& AnimationSequences, TArray<FDistanceCurveSource>& OutSources) const;
+
+	/** Returns the hash of the root bone motion and the settings of this modifier. Safe to run in parallel. */
+	uint32 HashDistanceCurveSource(const FDistanceCurveSource& Source) const;
+
+	/** Computes the distance curve keys from the root bone motion. Doesn't touch the sequence, so it's safe to run in parallel. */
+	void ComputeDistanceCurveKeys(const FDistanceCurveSource& Source, FDistanceCurveKeys& OutKeys) const;
+
+	/** Adds distance keys of the frame range, skipping frames which already have a key. */
+	void AddDistanceCurveKeys(const FDistanceCurveSource& Source, const int32 StartIndex, const int32 EndIndex, const bool bRevert, FDistanceCurveKeys& OutKeys) const;
+
+	/** Replaces the distance curve of the sequence with the keys in one bracketed data model change. */
+	void WriteDistanceCurveKeys(UAnimSequence* AnimationSequence, const FDistanceCurveKeys& Keys) const;
 
-	/** Sets a distance values in the float curve inside of the given Animation Sequence. */
-	void SetDistanceCurveKeys(const TObjectPtr<UAnimSequence> AnimationSequence, const int32 StartIndex, const int32 EndIndex, const bool bRevert) const;
+	/** Recompresses the changed sequence, then invalidates its cached distance curves. */
+	void RecompressAndInvalidate(UAnimSequence* AnimationSequence) const;
 };
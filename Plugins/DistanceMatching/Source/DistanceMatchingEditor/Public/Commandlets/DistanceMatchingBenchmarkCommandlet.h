@@ -0,0 +1,70 @@
+// Copyright Roman Merkushin. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "DistanceMatchingBenchmarkCommandlet.generated.h"
+
+class ACharacter;
+
+/**
+ * Headless crowd benchmark. Spawns characters with the distance matching component, drives scripted start, stop, pivot and jump
+ * inputs and reports the per-frame cost of the distance matching scopes as percentiles.
+ *
+ * UnrealEditor-Cmd <Project> -run=DistanceMatchingBenchmark -nullrhi [-Map=/Game/Maps/Test] [-CharacterClass=/Game/BP_Character.BP_Character_C]
+ *     [-Mesh=/Game/SK_Mannequin] [-AnimClass=/Game/ABP_Mannequin.ABP_Mannequin_C] [-Characters=64] [-Frames=600] [-WarmupFrames=60]
+ *     [-DeltaTime=0.0333] [-Seed=0] [-BatchTick] [-SleepWhenIdle] [-Output=Saved/DistanceMatching/Benchmark.json]
+ *
+ * Without a map an empty world with a floor is created. The output is written as CSV if the file extension is .csv, JSON otherwise.
+ */
+UCLASS()
+class DISTANCEMATCHINGEDITOR_API UDistanceMatchingBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UDistanceMatchingBenchmarkCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+
+private:
+	/** Per-frame samples of a timed scope, in milliseconds. */
+	struct FTimerSamples
+	{
+		FString Name;
+		TArray<double> Samples;
+	};
+
+	/** Character driven by the input script. */
+	struct FScriptedCharacter
+	{
+		ACharacter* Character = nullptr;
+
+		/** Time offset into the script, so the characters don't move in sync. */
+		float ScriptOffset = 0.0f;
+
+		/** Direction of the scripted movement input. */
+		FVector Direction = FVector::ForwardVector;
+	};
+
+	/** Load the map or create an empty world with a floor, and prepare it for play. */
+	UWorld* CreateWorld(const FString& MapName) const;
+
+	/** Destroy the world created by CreateWorld. */
+	void DestroyWorld(UWorld* World) const;
+
+	/** Spawn the characters on a grid and set up their components before the world begins play. */
+	bool SpawnCharacters(UWorld* World, const FString& Params, FRandomStream& RandomStream, TArray<FScriptedCharacter>& OutCharacters) const;
+
+	/**
+	* Feed the scripted input to the characters.
+	*
+	* @param Characters		Characters to drive.
+	* @param Time			Time since the benchmark start.
+	*/
+	void DriveCharacters(const TArray<FScriptedCharacter>& Characters, const float Time) const;
+
+	/** Write the percentiles of the samples as JSON or CSV. */
+	bool WriteReport(const FString& OutputPath, const FString& Params, const int32 NumCharacters, TArray<FTimerSamples>& Timers) const;
+};
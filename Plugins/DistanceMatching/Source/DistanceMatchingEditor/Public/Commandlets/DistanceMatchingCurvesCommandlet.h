@@ -0,0 +1,45 @@
+// Copyright Roman Merkushin. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "GameFramework/DistanceMatchingTypes.h"
+#include "DistanceMatchingCurvesCommandlet.generated.h"
+
+class UAnimMod_DistanceCurve;
+class UAnimSequence;
+
+/**
+ * Generates distance curves with the UAnimMod_DistanceCurve logic for every sequence matching the filter.
+ * Sequences whose root motion and settings hash matches the manifest of the previous run are skipped.
+ *
+ * UnrealEditor-Cmd <Project> -run=DistanceMatchingCurves [-Path=/Game] [-Filter=*Stop*] [-Type=Auto|Start|Stop|Pivot] [-CurveName=Distance]
+ *     [-RootBone=root] [-BatchSize=64] [-Manifest=Saved/DistanceMatching/CurveManifest.json] [-Force] [-NoSave]
+ *
+ * Type Auto takes the type from the sequence name (Start, Stop or Pivot) and skips sequences without one.
+ */
+UCLASS()
+class DISTANCEMATCHINGEDITOR_API UDistanceMatchingCurvesCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UDistanceMatchingCurvesCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+
+private:
+	/** Modifiers with the command line settings, one per distance matching type. */
+	UPROPERTY(Transient)
+	TMap<EDistanceMatchingType, TObjectPtr<UAnimMod_DistanceCurve>> Modifiers;
+
+	/** Returns the distance matching type for the sequence, None to skip it. */
+	EDistanceMatchingType GetSequenceType(const FString& AssetName, const EDistanceMatchingType Type) const;
+
+	/** Loads the source hashes of the previous run by package name. */
+	void LoadManifest(const FString& ManifestPath, TMap<FString, uint32>& OutHashes) const;
+
+	/** Saves the source hashes by package name. */
+	bool SaveManifest(const FString& ManifestPath, const TMap<FString, uint32>& Hashes) const;
+};
@@ -0,0 +1,25 @@
+// Copyright Roman Merkushin. All Rights Reserved.
+
+using UnrealBuildTool;
+
+public class DistanceMatchingMass : ModuleRules
+{
+	public DistanceMatchingMass(ReadOnlyTargetRules target)
+		: base(target)
+	{
+		PCHUsage = PCHUsageMode.UseExplicitOrSharedPCHs;
+
+		PublicDependencyModuleNames.AddRange(new[] { "Core", "MassEntity", "DistanceMatching" });
+		PrivateDependencyModuleNames.AddRange(
+			new[]
+			{
+				"CoreUObject",
+				"Engine",
+				"MassCommon",
+				"MassMovement",
+				"MassSpawner",
+				"StructUtils"
+			}
+		);
+	}
+}
@@ -0,0 +1,17 @@
+// Copyright Roman Merkushin. All Rights Reserved.
+
+#include "DistanceMatchingMass.h"
+
+#define LOCTEXT_NAMESPACE "FDistanceMatchingMassModule"
+
+void FDistanceMatchingMassModule::StartupModule()
+{
+}
+
+void FDistanceMatchingMassModule::ShutdownModule()
+{
+}
+
+#undef LOCTEXT_NAMESPACE
+
+IMPLEMENT_MODULE(FDistanceMatchingMassModule, DistanceMatchingMass)
@@ -0,0 +1,109 @@
+// Copyright Roman Merkushin. All Rights Reserved.
+
+#include "DistanceMatchingMassProcessor.h"
+#include "DistanceMatchingMassFragments.h"
+#include "DistanceMatchingStats.h"
+#include "GameFramework/DistanceMatchingStateMachine.h"
+#include "MassCommonFragments.h"
+#include "MassCommonTypes.h"
+#include "MassMovementFragments.h"
+
+DECLARE_CYCLE_STAT(TEXT("Mass Processor"), STAT_DistanceMatching_MassProcessor, STATGROUP_DistanceMatching);
+
+UDistanceMatchingMassProcessor::UDistanceMatchingMassProcessor()
+{
+	ExecutionOrder.ExecuteAfter.Add(UE::Mass::ProcessorGroupNames::Movement);
+}
+
+void UDistanceMatchingMassProcessor::ConfigureQueries()
+{
+	EntityQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddRequirement<FMassVelocityFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddRequirement<FDistanceMatchingInputFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddRequirement<FDistanceMatchingFragment>(EMassFragmentAccess::ReadWrite);
+	EntityQuery.AddSharedRequirement<FDistanceMatchingParameters>(EMassFragmentAccess::ReadOnly);
+}
+
+void UDistanceMatchingMassProcessor::Execute(UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context)
+{
+	DISTANCE_MATCHING_SCOPE_CYCLE_COUNTER(MassProcessor);
+
+	EntityQuery.ForEachEntityChunk(EntitySubsystem, Context, [](FMassExecutionContext& ChunkContext)
+	{
+		const int32 NumEntities = ChunkContext.GetNumEntities();
+		const float DeltaTime = ChunkContext.GetDeltaTimeSeconds();
+		const FDistanceMatchingParameters& Parameters = ChunkContext.GetSharedFragment<FDistanceMatchingParameters>();
+
+		const TConstArrayView<FTransformFragment> Transforms = ChunkContext.GetFragmentView<FTransformFragment>();
+		const TConstArrayView<FMassVelocityFragment> Velocities = ChunkContext.GetFragmentView<FMassVelocityFragment>();
+		const TConstArrayView<FDistanceMatchingInputFragment> Inputs = ChunkContext.GetFragmentView<FDistanceMatchingInputFragment>();
+		const TArrayView<FDistanceMatchingFragment> DistanceMatchingFragments = ChunkContext.GetMutableFragmentView<FDistanceMatchingFragment>();
+
+		int32 NumPredictions = 0;
+
+		for (int32 EntityIndex = 0; EntityIndex < NumEntities; EntityIndex++)
+		{
+			const FVector Location = Transforms[EntityIndex].GetTransform().GetLocation();
+			const FVector& Velocity = Velocities[EntityIndex].Value;
+			const FDistanceMatchingInputFragment& Input = Inputs[EntityIndex];
+			FDistanceMatchingFragment& Fragment = DistanceMatchingFragments[EntityIndex];
+
+			if (!Fragment.bIsInitialized)
+			{
+				Fragment.PreviousLocation = Location;
+				Fragment.GroundZ = Location.Z;
+				Fragment.bIsInitialized = true;
+			}
+
+			const float AccelerationSize = Input.DesiredAcceleration.Size();
+			const FDistanceMatchingMovement Movement{ Location, Fragment.PreviousLocation, Velocity, Input.DesiredAcceleration, Fragment.PreviousAccelerationSize, Velocity.Size() > MOVEMENT_THRESHOLD, AccelerationSize > MOVEMENT_THRESHOLD, Input.bIsFalling };
+			const FDistanceMatchingMarkersRef Markers(Fragment.State);
+
+			bool bStartMarkerUpdated;
+			const EDistanceMatchingPrediction Prediction = DistanceMatchingStateMachine::UpdateType(Movement, Parameters.MinPivotAngle, Markers, bStartMarkerUpdated);
+			DistanceMatchingStateMachine::UpdateGroundZ(Movement, 0.0f, Fragment.GroundZ);
+
+			FPredictResult* PredictResult = nullptr;
+			FVector PredictedLocation;
+			float PredictionTime;
+
+			switch (Prediction)
+			{
+				case EDistanceMatchingPrediction::Stop:
+				case EDistanceMatchingPrediction::Pivot:
+				{
+					// Pivot accelerates with the full acceleration of the agent towards the desired direction
+					const FVector Acceleration = Prediction == EDistanceMatchingPrediction::Pivot ? Input.DesiredAcceleration.GetSafeNormal() * Parameters.MaxAcceleration : FVector::ZeroVector;
+					DistanceMatchingStateMachine::SolveStopLocation(Location, Velocity, Acceleration, Parameters.BrakingFriction, Parameters.BrakingDeceleration, Parameters.BrakeToStopVelocity, Parameters.MaxSimulationTime, PredictedLocation, PredictionTime);
+					PredictResult = Prediction == EDistanceMatchingPrediction::Stop ? &Markers.StopMarker : &Markers.PivotMarker;
+					break;
+				}
+				case EDistanceMatchingPrediction::JumpApex:
+					DistanceMatchingStateMachine::SolveJumpApex(Location, Velocity, Parameters.GravityZ, Parameters.MaxSimulationTime, PredictedLocation, PredictionTime);
+					PredictResult = &Markers.ApexMarker;
+					break;
+				case EDistanceMatchingPrediction::Landing:
+					DistanceMatchingStateMachine::SolveLandingEstimate(Location, Velocity, Parameters.GravityZ, Fragment.GroundZ, 0.0f, Parameters.MaxSimulationTime, PredictedLocation, PredictionTime);
+					PredictResult = &Markers.LandingMarker;
+					break;
+				case EDistanceMatchingPrediction::None:
+					break;
+			}
+
+			if (PredictResult)
+			{
+				PredictResult->Location = PredictedLocation;
+				PredictResult->Time = PredictionTime;
+				PredictResult->bIsPending = false;
+				NumPredictions++;
+			}
+
+			DistanceMatchingStateMachine::UpdateMarkers(Location, DeltaTime, Markers);
+
+			Fragment.PreviousLocation = Location;
+			Fragment.PreviousAccelerationSize = AccelerationSize;
+		}
+
+		DISTANCE_MATCHING_INC_COUNTER(Predictions, NumPredictions);
+	});
+}
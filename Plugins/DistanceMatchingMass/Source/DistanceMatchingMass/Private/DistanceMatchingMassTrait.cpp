@@ -0,0 +1,21 @@
+// Copyright Roman Merkushin. All Rights Reserved.
+
+#include "DistanceMatchingMassTrait.h"
+#include "MassEntitySubsystem.h"
+#include "MassEntityTemplateRegistry.h"
+#include "StructView.h"
+#include "Engine/World.h"
+
+void UDistanceMatchingMassTrait::BuildTemplate(FMassEntityTemplateBuildContext& BuildContext, UWorld& World) const
+{
+	BuildContext.AddFragment<FDistanceMatchingInputFragment>();
+	BuildContext.AddFragment<FDistanceMatchingFragment>();
+
+	// Agents with equal parameters share one fragment, so they land in the same chunks
+	UMassEntitySubsystem* EntitySubsystem = UWorld::GetSubsystem<UMassEntitySubsystem>(&World);
+	check(EntitySubsystem);
+
+	const uint32 ParametersHash = UE::StructUtils::GetStructCrc32(FConstStructView::Make(Parameters));
+	const FSharedStruct ParametersFragment = EntitySubsystem->GetOrCreateSharedFragment<FDistanceMatchingParameters>(ParametersHash, Parameters);
+	BuildContext.AddSharedFragment(ParametersFragment);
+}
@@ -0,0 +1,87 @@
+// Copyright Roman Merkushin. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MassEntityTypes.h"
+#include "GameFramework/DistanceMatchingTypes.h"
+#include "DistanceMatchingMassFragments.generated.h"
+
+/**
+ * Movement intent of a crowd agent, filled by the game movement processors before the distance matching processor runs.
+ * The velocity and location are read from the standard Mass fragments.
+ */
+USTRUCT()
+struct DISTANCEMATCHINGMASS_API FDistanceMatchingInputFragment : public FMassFragment
+{
+	GENERATED_BODY()
+
+	/** Acceleration requested by the agent, zero when it wants to stop. Braking forces should not be included. */
+	UPROPERTY(EditAnywhere, Category = "DistanceMatching")
+	FVector DesiredAcceleration = FVector::ZeroVector;
+
+	/** The agent is in the air. Mass movement has no falling mode, so it's set by the game. */
+	UPROPERTY(EditAnywhere, Category = "DistanceMatching")
+	bool bIsFalling = false;
+};
+
+/** Distance matching state of a crowd agent. The same data the component publishes, so anim nodes and vertex animation can read it alike. */
+USTRUCT()
+struct DISTANCEMATCHINGMASS_API FDistanceMatchingFragment : public FMassFragment
+{
+	GENERATED_BODY()
+
+	/** Current distance matching type and markers. */
+	UPROPERTY(VisibleAnywhere, Category = "DistanceMatching")
+	FDistanceMatchingSnapshot State;
+
+	/** Location in the previous update. */
+	FVector PreviousLocation = FVector::ZeroVector;
+
+	/** Size of the desired acceleration in the previous update. */
+	float PreviousAccelerationSize = 0.0f;
+
+	/** Height of the agent on the ground before it started falling, the landing is predicted at it. */
+	float GroundZ = 0.0f;
+
+	/** The previous location is valid. */
+	bool bIsInitialized = false;
+
+	/** Returns the distance to the marker, e.g. to look up the frame of a vertex animation. */
+	float GetDistance(const EDistanceMatchingMarker Marker) const { return State.GetMarker(Marker).Distance; }
+};
+
+/** Movement settings shared by agents of the same config, used in place of the character movement component settings. */
+USTRUCT()
+struct DISTANCEMATCHINGMASS_API FDistanceMatchingParameters : public FMassSharedFragment
+{
+	GENERATED_BODY()
+
+	/** Maximum simulation time for the stop and pivot location predictions. */
+	UPROPERTY(EditAnywhere, Category = "DistanceMatching", meta = (ClampMin = 0.1f, ClampMax = 5.0f, UIMin = 0.1f, UIMax = 5.0f))
+	float MaxSimulationTime = 2.0f;
+
+	/** Minimum angle for pivot detection. */
+	UPROPERTY(EditAnywhere, Category = "DistanceMatching", meta = (ClampMin = 0.0f, ClampMax = 180.0f, UIMin = 0.0f, UIMax = 180.0f))
+	float MinPivotAngle = 150.0f;
+
+	/** Acceleration of the agent during pivot. */
+	UPROPERTY(EditAnywhere, Category = "DistanceMatching", meta = (ClampMin = 0.0f, UIMin = 0.0f))
+	float MaxAcceleration = 2048.0f;
+
+	/** Friction applied while braking. */
+	UPROPERTY(EditAnywhere, Category = "DistanceMatching", meta = (ClampMin = 0.0f, UIMin = 0.0f))
+	float BrakingFriction = 8.0f;
+
+	/** Constant deceleration applied while braking. */
+	UPROPERTY(EditAnywhere, Category = "DistanceMatching", meta = (ClampMin = 0.0f, UIMin = 0.0f))
+	float BrakingDeceleration = 2048.0f;
+
+	/** Speed below which the braking agent stops. */
+	UPROPERTY(EditAnywhere, Category = "DistanceMatching", meta = (ClampMin = 0.0f, UIMin = 0.0f))
+	float BrakeToStopVelocity = 10.0f;
+
+	/** Gravity for the jump apex and landing predictions. */
+	UPROPERTY(EditAnywhere, Category = "DistanceMatching")
+	float GravityZ = -980.0f;
+};
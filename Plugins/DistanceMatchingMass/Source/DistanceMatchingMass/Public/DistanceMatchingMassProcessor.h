@@ -0,0 +1,29 @@
+// Copyright Roman Merkushin. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MassProcessor.h"
+#include "DistanceMatchingMassProcessor.generated.h"
+
+/**
+ * Runs the distance matching state machine and marker updates for crowd agents after the Mass movement.
+ * Markers are predicted analytically without collision queries: the landing is predicted at the ground height before the jump or the fall.
+ */
+UCLASS()
+class DISTANCEMATCHINGMASS_API UDistanceMatchingMassProcessor : public UMassProcessor
+{
+	GENERATED_BODY()
+
+public:
+	UDistanceMatchingMassProcessor();
+
+protected:
+	// UMassProcessor interface
+	virtual void ConfigureQueries() override;
+	virtual void Execute(UMassEntitySubsystem& EntitySubsystem, FMassExecutionContext& Context) override;
+	// End of UMassProcessor interface
+
+private:
+	FMassEntityQuery EntityQuery;
+};
@@ -0,0 +1,22 @@
+// Copyright Roman Merkushin. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MassEntityTraitBase.h"
+#include "DistanceMatchingMassFragments.h"
+#include "DistanceMatchingMassTrait.generated.h"
+
+/** Adds the distance matching fragments to a Mass entity config. The agents also need the Mass movement velocity. */
+UCLASS(meta = (DisplayName = "Distance Matching"))
+class DISTANCEMATCHINGMASS_API UDistanceMatchingMassTrait : public UMassEntityTraitBase
+{
+	GENERATED_BODY()
+
+protected:
+	virtual void BuildTemplate(FMassEntityTemplateBuildContext& BuildContext, UWorld& World) const override;
+
+	/** Movement settings shared by all agents with the same values. */
+	UPROPERTY(EditAnywhere, Category = "DistanceMatching")
+	FDistanceMatchingParameters Parameters;
+};